@@ -0,0 +1,207 @@
+# Compiles the board ini files into static tables linked into the daemon,
+# so that no ini needs to be parsed at startup.
+#
+# cmake -DINI_DIR=data -DOUTPUT=peripheral_board_tables.c -P peripheral_board_tables.cmake
+#
+# Keys and values are parsed the way peripheral_board.c parses an ini
+# override, devices are sorted by type and args. Two keys naming the same
+# device fail the build.
+
+CMAKE_POLICY(SET CMP0007 NEW)
+
+FILE(GLOB INI_FILES ${INI_DIR}/pio_board_*.ini)
+LIST(SORT INI_FILES)
+
+SET(DEV_TYPES gpio i2c pwm adc uart spi)
+SET(DEV_ENUMS PB_BOARD_DEV_GPIO PB_BOARD_DEV_I2C PB_BOARD_DEV_PWM PB_BOARD_DEV_ADC PB_BOARD_DEV_UART PB_BOARD_DEV_SPI)
+
+FUNCTION(BOARD_PAD value width out)
+	SET(ret "${value}")
+	STRING(LENGTH "${ret}" len)
+	WHILE(len LESS width)
+		SET(ret "0${ret}")
+		MATH(EXPR len "${len} + 1")
+	ENDWHILE()
+	SET(${out} "${ret}" PARENT_SCOPE)
+ENDFUNCTION()
+
+FUNCTION(BOARD_CHECK_NUMBER value what)
+	IF(NOT "${value}" MATCHES "^(0[xX][0-9a-fA-F]+|[0-9]+)$")
+		MESSAGE(FATAL_ERROR "${INI}: invalid ${what} '${value}'")
+	ENDIF()
+ENDFUNCTION()
+
+# Sets arg0 and arg1 from a key, the way peripheral_bus_board_ini_parse_key() does
+FUNCTION(BOARD_PARSE_KEY type key)
+	SET(arg0 0)
+	SET(arg1 0)
+	STRING(REGEX MATCHALL "[0-9]+" nums "${key}")
+	LIST(LENGTH nums num_count)
+
+	IF(type STREQUAL "i2c")
+		IF(NOT "${key}" MATCHES "-([0-9]+)")
+			MESSAGE(FATAL_ERROR "${INI}: invalid i2c key '${key}'")
+		ENDIF()
+		SET(arg0 ${CMAKE_MATCH_1})
+	ELSEIF(type STREQUAL "pwm" OR type STREQUAL "adc" OR type STREQUAL "spi")
+		IF(num_count LESS 2)
+			MESSAGE(FATAL_ERROR "${INI}: invalid ${type} key '${key}'")
+		ENDIF()
+		LIST(GET nums 0 arg0)
+		LIST(GET nums 1 arg1)
+	ELSE()
+		IF(num_count LESS 1)
+			MESSAGE(FATAL_ERROR "${INI}: invalid ${type} key '${key}'")
+		ENDIF()
+		LIST(GET nums 0 arg0)
+	ENDIF()
+
+	# Strip leading zeros so the values read as decimal in C
+	STRING(REGEX REPLACE "^0+([0-9])" "\\1" arg0 "${arg0}")
+	STRING(REGEX REPLACE "^0+([0-9])" "\\1" arg1 "${arg1}")
+
+	SET(arg0 ${arg0} PARENT_SCOPE)
+	SET(arg1 ${arg1} PARENT_SCOPE)
+ENDFUNCTION()
+
+FUNCTION(BOARD_PARSE_CONFIG type string)
+	SET(set 0)
+	SET(mode 0)
+	SET(max_speed_hz 0)
+	SET(bits_per_word 0)
+
+	IF(NOT type STREQUAL "spi")
+		MESSAGE(FATAL_ERROR "${INI}: device config is not supported for ${type}")
+	ENDIF()
+
+	STRING(REGEX REPLACE "[, \t]+" ";" tokens "${string}")
+	FOREACH(token ${tokens})
+		IF(NOT "${token}" MATCHES "^([a-z_]+)=(.*)$")
+			MESSAGE(FATAL_ERROR "${INI}: invalid spi config '${token}'")
+		ENDIF()
+		SET(name ${CMAKE_MATCH_1})
+		SET(value ${CMAKE_MATCH_2})
+		BOARD_CHECK_NUMBER("${value}" "spi ${name}")
+
+		IF(name STREQUAL "mode")
+			MATH(EXPR set "${set} | 1")
+		ELSEIF(name STREQUAL "max_speed_hz")
+			MATH(EXPR set "${set} | 2")
+		ELSEIF(name STREQUAL "bits_per_word")
+			MATH(EXPR set "${set} | 4")
+		ELSE()
+			MESSAGE(FATAL_ERROR "${INI}: unknown spi config '${name}'")
+		ENDIF()
+		SET(${name} ${value})
+	ENDFOREACH()
+
+	SET(config "{{${set}, ${mode}, ${max_speed_hz}, ${bits_per_word}}}" PARENT_SCOPE)
+ENDFUNCTION()
+
+SET(out "/* Generated by cmake/peripheral_board_tables.cmake, do not edit */\n\n")
+SET(out "${out}#include <stddef.h>\n\n#include \"peripheral_board_builtin.h\"\n")
+SET(entries "")
+
+FOREACH(INI ${INI_FILES})
+	GET_FILENAME_COMPONENT(file ${INI} NAME)
+	GET_FILENAME_COMPONENT(ident ${INI} NAME_WE)
+	STRING(REGEX REPLACE "[^A-Za-z0-9_]" "_" ident "${ident}")
+
+	# iniparser treats lines starting with ';' or '#' as comments
+	FILE(READ ${INI} content)
+	STRING(REGEX REPLACE "(^|\n)[ \t]*[;#][^\n]*" "\\1" content "${content}")
+	STRING(REPLACE "\n" ";" lines "${content}")
+
+	SET(type "")
+	SET(devs "")
+	SET(dev_keys "")
+	SET(pins "")
+	SET(num_pins_total 0)
+
+	FOREACH(line ${lines})
+		STRING(STRIP "${line}" line)
+		IF(line STREQUAL "")
+		ELSEIF("${line}" MATCHES "^\\[(.*)\\]$")
+			STRING(TOLOWER "${CMAKE_MATCH_1}" section)
+			SET(type "")
+			FOREACH(candidate ${DEV_TYPES})
+				IF("${section}" MATCHES "^${candidate}")
+					SET(type ${candidate})
+				ENDIF()
+			ENDFOREACH()
+		ELSEIF(NOT type STREQUAL "")
+			IF(NOT "${line}" MATCHES "^([^=]+)=(.*)$")
+				MESSAGE(FATAL_ERROR "${INI}: invalid line '${line}'")
+			ENDIF()
+			STRING(STRIP "${CMAKE_MATCH_1}" key)
+			STRING(STRIP "${CMAKE_MATCH_2}" value)
+
+			BOARD_PARSE_KEY(${type} "${key}")
+
+			SET(config "{{0, 0, 0, 0}}")
+			IF("${value}" MATCHES "^([^|]*)\\|(.*)$")
+				SET(value "${CMAKE_MATCH_1}")
+				BOARD_PARSE_CONFIG(${type} "${CMAKE_MATCH_2}")
+			ENDIF()
+
+			STRING(REGEX REPLACE "[, \t]+" ";" dev_pins "${value}")
+			SET(num_pins 0)
+			SET(pin_line "")
+			FOREACH(pin ${dev_pins})
+				BOARD_CHECK_NUMBER("${pin}" "pin")
+				SET(pin_line "${pin_line} ${pin},")
+				MATH(EXPR num_pins "${num_pins} + 1")
+			ENDFOREACH()
+			IF(num_pins GREATER 0)
+				SET(pins "${pins}\t/* ${key} */${pin_line}\n")
+				SET(pins_ref "&${ident}_pins[${num_pins_total}]")
+			ELSE()
+				SET(pins_ref "NULL")
+			ENDIF()
+			MATH(EXPR num_pins_total "${num_pins_total} + ${num_pins}")
+
+			LIST(FIND DEV_TYPES ${type} type_index)
+			LIST(GET DEV_ENUMS ${type_index} type_enum)
+			BOARD_PAD(${arg0} 10 sort0)
+			BOARD_PAD(${arg1} 10 sort1)
+			LIST(FIND dev_keys "${type_index}_${sort0}_${sort1}" dup)
+			IF(NOT dup EQUAL -1)
+				MESSAGE(FATAL_ERROR "${INI}: duplicated ${type} device '${key}'")
+			ENDIF()
+			LIST(APPEND dev_keys "${type_index}_${sort0}_${sort1}")
+			LIST(APPEND devs "${type_index}_${sort0}_${sort1}|\t{${type_enum}, ${pins_ref}, ${num_pins}, {${arg0}, ${arg1}}, ${config}},\n")
+		ENDIF()
+	ENDFOREACH()
+
+	LIST(SORT devs)
+	LIST(LENGTH devs num_dev)
+
+	IF(num_pins_total GREATER 0)
+		SET(out "${out}\nstatic const unsigned int ${ident}_pins[] = {\n${pins}};\n")
+	ENDIF()
+
+	IF(num_dev GREATER 0)
+		SET(out "${out}\nstatic const pb_board_dev_s ${ident}_dev[] = {\n")
+		FOREACH(dev ${devs})
+			STRING(REGEX REPLACE "^[^|]*\\|" "" dev "${dev}")
+			SET(out "${out}${dev}")
+		ENDFOREACH()
+		SET(out "${out}};\n")
+		SET(entries "${entries}\t{\"${file}\", ${ident}_dev, ${num_dev}},\n")
+	ELSE()
+		SET(entries "${entries}\t{\"${file}\", NULL, 0},\n")
+	ENDIF()
+ENDFOREACH()
+
+LIST(LENGTH INI_FILES count)
+SET(out "${out}\nconst pb_board_builtin_s peripheral_bus_board_builtin[] = {\n${entries}};\n")
+SET(out "${out}\nconst unsigned int peripheral_bus_board_builtin_count = ${count};\n")
+
+# Only touch the output when it changes, so that it is not rebuilt needlessly
+SET(old "")
+IF(EXISTS ${OUTPUT})
+	FILE(READ ${OUTPUT} old)
+ENDIF()
+IF(NOT old STREQUAL out)
+	FILE(WRITE ${OUTPUT} "${out}")
+ENDIF()
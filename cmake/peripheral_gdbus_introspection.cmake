@@ -0,0 +1,26 @@
+# Embeds the D-Bus introspection XML into the daemon as a C string, the
+# objects are registered from it without generated skeletons.
+#
+# cmake -DXML=peripheral_io.xml -DOUTPUT=peripheral_gdbus_introspection.c -P peripheral_gdbus_introspection.cmake
+
+FILE(READ ${XML} content)
+
+# Indentation only costs parse time, the string is parsed once at startup
+STRING(REGEX REPLACE "\n[ \t]+" "\n" content "${content}")
+STRING(REPLACE "\\" "\\\\" content "${content}")
+STRING(REPLACE "\"" "\\\"" content "${content}")
+STRING(REGEX REPLACE "\n$" "" content "${content}")
+STRING(REPLACE "\n" "\\n\"\n\t\"" content "${content}")
+
+SET(out "/* Generated by cmake/peripheral_gdbus_introspection.cmake, do not edit */\n\n")
+SET(out "${out}#include \"peripheral_gdbus.h\"\n\n")
+SET(out "${out}const char peripheral_gdbus_introspection_xml[] =\n\t\"${content}\\n\";\n")
+
+# Only touch the output when it changes, so that it is not rebuilt needlessly
+SET(old "")
+IF(EXISTS ${OUTPUT})
+	FILE(READ ${OUTPUT} old)
+ENDIF()
+IF(NOT old STREQUAL out)
+	FILE(WRITE ${OUTPUT} "${out}")
+ENDIF()
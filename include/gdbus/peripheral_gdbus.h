@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_GDBUS_H__
+#define __PERIPHERAL_GDBUS_H__
+
+#include <gio/gio.h>
+
+#include "peripheral_handle.h"
+#include "peripheral_handle_state.h"
+
+/*
+ * Method handlers get the in arguments as the tuple GDBus already checked
+ * against the introspection data, and must return a reply on invocation.
+ * They return the result code they replied with.
+ */
+typedef int (*peripheral_gdbus_method_cb)(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+/* peripheral_io.xml, embedded at build time */
+extern const char peripheral_gdbus_introspection_xml[];
+
+int peripheral_gdbus_register(peripheral_info_s *info);
+void peripheral_gdbus_unregister(peripheral_info_s *info);
+
+/*
+ * Serves the same objects on a private socket, so that clients can skip
+ * the round trip through dbus-daemon. The bus name stays for discovery.
+ */
+int peripheral_gdbus_peer_start(peripheral_info_s *info);
+void peripheral_gdbus_peer_stop(void);
+
+/* Calls vanished once the client that sent invocation goes away */
+void peripheral_gdbus_watch_client(peripheral_h handle, GDBusMethodInvocation *invocation, GBusNameVanishedCallback vanished);
+void peripheral_gdbus_unwatch_client(peripheral_h handle);
+
+/*
+ * Handle ids are small and predictable, so a client may only release
+ * the handles it opened. Fails with PERIPHERAL_ERROR_PERMISSION_DENIED.
+ */
+int peripheral_gdbus_check_client(peripheral_h handle, GDBusMethodInvocation *invocation);
+
+/* Recreates a handle from its state, as left by a previous instance */
+typedef void (*peripheral_gdbus_restore_cb)(const pb_handle_state_s *state, gpointer user_data);
+
+/*
+ * Hands a restored handle the id its client knows it by and watches the
+ * client again. Handles whose client is gone are released through vanished.
+ */
+void peripheral_gdbus_restore_client(peripheral_h handle, const pb_handle_state_s *state, GBusNameVanishedCallback vanished);
+
+/* Takes over the handles the previous instance left open, before serving */
+int peripheral_gdbus_restore(peripheral_info_s *info);
+
+#endif /* __PERIPHERAL_GDBUS_H__ */
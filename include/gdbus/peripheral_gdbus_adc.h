@@ -17,20 +17,20 @@
 #ifndef __PERIPHERAL_GDBUS_ADC_H__
 #define __PERIPHERAL_GDBUS_ADC_H__
 
-#include "peripheral_io_gdbus.h"
+#include <gio/gio.h>
 
-gboolean peripheral_gdbus_adc_open(
-		PeripheralIoGdbusAdc *adc,
+#include "peripheral_handle_state.h"
+
+int peripheral_gdbus_adc_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint device,
-		gint channel,
+		GVariant *parameters,
 		gpointer user_data);
 
-gboolean peripheral_gdbus_adc_close(
-		PeripheralIoGdbusAdc *adc,
+int peripheral_gdbus_adc_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data);
 
+void peripheral_gdbus_adc_restore(const pb_handle_state_s *state, gpointer user_data);
+
 #endif /* __PERIPHERAL_GDBUS_ADC_H__ */
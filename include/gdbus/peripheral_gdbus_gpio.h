@@ -17,19 +17,20 @@
 #ifndef __PERIPHERAL_GDBUS_GPIO_H__
 #define __PERIPHERAL_GDBUS_GPIO_H__
 
-#include "peripheral_io_gdbus.h"
+#include <gio/gio.h>
 
-gboolean peripheral_gdbus_gpio_open(
-		PeripheralIoGdbusGpio *gpio,
+#include "peripheral_handle_state.h"
+
+int peripheral_gdbus_gpio_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint pin,
+		GVariant *parameters,
 		gpointer user_data);
 
-gboolean peripheral_gdbus_gpio_close(
-		PeripheralIoGdbusGpio *gpio,
+int peripheral_gdbus_gpio_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data);
 
+void peripheral_gdbus_gpio_restore(const pb_handle_state_s *state, gpointer user_data);
+
 #endif /* __PERIPHERAL_GDBUS_GPIO_H__ */
@@ -17,20 +17,37 @@
 #ifndef __PERIPHERAL_GDBUS_I2C_H__
 #define __PERIPHERAL_GDBUS_I2C_H__
 
-#include "peripheral_io_gdbus.h"
+#include <gio/gio.h>
 
-gboolean peripheral_gdbus_i2c_open(
-		PeripheralIoGdbusI2c *i2c,
+#include "peripheral_handle_state.h"
+
+int peripheral_gdbus_i2c_open(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_i2c_close(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_i2c_poll_start(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_i2c_poll_stop(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint bus,
-		gint address,
+		GVariant *parameters,
 		gpointer user_data);
 
-gboolean peripheral_gdbus_i2c_close(
-		PeripheralIoGdbusI2c *i2c,
+int peripheral_gdbus_i2c_scan(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data);
 
+void peripheral_gdbus_i2c_restore(const pb_handle_state_s *state, gpointer user_data);
+
+void peripheral_gdbus_i2c_poll_restore(const pb_handle_state_s *state, gpointer user_data);
+
 #endif /* __PERIPHERAL_GDBUS_I2C_H__ */
@@ -17,20 +17,20 @@
 #ifndef __PERIPHERAL_GDBUS_PWM_H__
 #define __PERIPHERAL_GDBUS_PWM_H__
 
-#include "peripheral_io_gdbus.h"
+#include <gio/gio.h>
 
-gboolean peripheral_gdbus_pwm_open(
-		PeripheralIoGdbusPwm *pwm,
+#include "peripheral_handle_state.h"
+
+int peripheral_gdbus_pwm_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint chip,
-		gint pin,
+		GVariant *parameters,
 		gpointer user_data);
 
-gboolean peripheral_gdbus_pwm_close(
-		PeripheralIoGdbusPwm *pwm,
+int peripheral_gdbus_pwm_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data);
 
+void peripheral_gdbus_pwm_restore(const pb_handle_state_s *state, gpointer user_data);
+
 #endif /* __PERIPHERAL_GDBUS_PWM_H__ */
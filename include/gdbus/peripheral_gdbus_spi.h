@@ -17,20 +17,33 @@
 #ifndef __PERIPHERAL_GDBUS_SPI_H__
 #define __PERIPHERAL_GDBUS_SPI_H__
 
-#include "peripheral_io_gdbus.h"
+#include <gio/gio.h>
 
-gboolean peripheral_gdbus_spi_open(
-		PeripheralIoGdbusSpi *spi,
+#include "peripheral_handle_state.h"
+
+/* OpenWithConfig value asking for the board default or the current setting */
+#define SPI_CONFIG_DEFAULT	0xFFFFFFFF
+
+int peripheral_gdbus_spi_open(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_spi_open_with_config(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint bus,
-		gint cs,
+		GVariant *parameters,
 		gpointer user_data);
 
-gboolean peripheral_gdbus_spi_close(
-		PeripheralIoGdbusSpi *spi,
+int peripheral_gdbus_spi_queue_attach(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data);
 
+int peripheral_gdbus_spi_close(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+void peripheral_gdbus_spi_restore(const pb_handle_state_s *state, gpointer user_data);
+
 #endif /* __PERIPHERAL_GDBUS_SPI_H__ */
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PERIPHERAL_GDBUS_STATS_H__
+#define __PERIPHERAL_GDBUS_STATS_H__
+
+#include <gio/gio.h>
+
+#include "peripheral_board.h"
+
+int peripheral_gdbus_stats_get_counters(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_stats_get_histograms(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_stats_get_text(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_stats_get_timeline(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+int peripheral_gdbus_stats_get_records(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+/* pb_stats_active_cb counting the handles of the peripheral_info_s in user_data */
+void peripheral_gdbus_stats_active(unsigned int active[PB_BOARD_DEV_MAX], gpointer user_data);
+
+#endif /* __PERIPHERAL_GDBUS_STATS_H__ */
@@ -17,19 +17,25 @@
 #ifndef __PERIPHERAL_GDBUS_UART_H__
 #define __PERIPHERAL_GDBUS_UART_H__
 
-#include "peripheral_io_gdbus.h"
+#include <gio/gio.h>
 
-gboolean peripheral_gdbus_uart_open(
-		PeripheralIoGdbusUart *uart,
+#include "peripheral_handle_state.h"
+
+int peripheral_gdbus_uart_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint port,
+		GVariant *parameters,
 		gpointer user_data);
 
-gboolean peripheral_gdbus_uart_close(
-		PeripheralIoGdbusUart *uart,
+int peripheral_gdbus_uart_open_with_config(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data);
 
+int peripheral_gdbus_uart_close(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data);
+
+void peripheral_gdbus_uart_restore(const pb_handle_state_s *state, gpointer user_data);
+
 #endif /* __PERIPHERAL_GDBUS_UART_H__ */
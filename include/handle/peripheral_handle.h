@@ -20,7 +20,7 @@
 #include <gio/gio.h>
 
 #include "peripheral_board.h"
-#include "peripheral_io_gdbus.h"
+#include "peripheral_ring.h"
 
 typedef struct {
 	pb_board_s *board;
@@ -31,14 +31,15 @@ typedef struct {
 	GList *adc_list;
 	GList *uart_list;
 	GList *spi_list;
+	GList *i2c_poll_list;
+	/* shared i2c register pollers */
+	GList *i2c_poller_list;
+	/* cached i2c bus scan results */
+	GList *i2c_scan_list;
+	/* shared spi bus transfer queues */
+	GList *spi_queue_list;
 	/* gdbus variable */
 	GDBusConnection *connection;
-	PeripheralIoGdbusGpio *gpio_skeleton;
-	PeripheralIoGdbusI2c *i2c_skeleton;
-	PeripheralIoGdbusPwm *pwm_skeleton;
-	PeripheralIoGdbusAdc *adc_skeleton;
-	PeripheralIoGdbusUart *uart_skeleton;
-	PeripheralIoGdbusSpi *spi_skeleton;
 } peripheral_info_s;
 
 typedef struct {
@@ -50,6 +51,31 @@ typedef struct {
 	int address;
 } peripheral_handle_i2c_s;
 
+typedef struct {
+	int bus;
+	uint64_t bitmap[2];
+} peripheral_i2c_scan_s;
+
+typedef struct {
+	int bus;
+	int address;
+	int reg;
+	int length;
+	unsigned int interval;
+	int fd;
+	GThread *thread;	/* runs the transfers, I2C_RDWR blocks */
+	GMutex mutex;
+	GCond cond;
+	bool stop;
+	unsigned int refcount;
+	pb_ring_s *ring;
+	GList **list;
+} peripheral_i2c_poller_s;
+
+typedef struct {
+	peripheral_i2c_poller_s *poller;
+} peripheral_handle_i2c_poll_s;
+
 typedef struct {
 	int chip;
 	int pin;
@@ -64,17 +90,29 @@ typedef struct {
 	int port;
 } peripheral_handle_uart_s;
 
+typedef struct _peripheral_spi_queue_client_s peripheral_spi_queue_client_s;
+
 typedef struct {
 	int bus;
 	int cs;
+	peripheral_spi_queue_client_s *queue_client;
 } peripheral_handle_spi_s;
 
 typedef struct {
+	/* what clients call the handle by, kept across daemon restarts */
+	unsigned int id;
+	/* unique bus name of the client, NULL for peers */
+	char *owner;
 	uint watch_id;
+	/* clients on the peer socket are watched through their connection */
+	GDBusConnection *peer;
+	gulong peer_closed_id;
+	GBusNameVanishedCallback vanished;
 	GList **list;
 	union {
 		peripheral_handle_gpio_s gpio;
 		peripheral_handle_i2c_s i2c;
+		peripheral_handle_i2c_poll_s i2c_poll;
 		peripheral_handle_pwm_s pwm;
 		peripheral_handle_adc_s adc;
 		peripheral_handle_uart_s uart;
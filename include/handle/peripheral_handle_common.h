@@ -28,4 +28,10 @@
 peripheral_h peripheral_handle_new(GList **plist);
 int peripheral_handle_free(peripheral_h handle);
 
+/* Looks up the handle called id by a client, only among those in plist */
+peripheral_h peripheral_handle_find(GList **plist, unsigned int id);
+
+/* Gives a restored handle back the id its client knows it by */
+int peripheral_handle_set_id(peripheral_h handle, unsigned int id);
+
 #endif /* __PERIPHERAL_HANDLE_COMMON_H__ */
@@ -20,4 +20,7 @@
 int peripheral_handle_i2c_create(int bus, int address, peripheral_h *handle, gpointer user_data);
 int peripheral_handle_i2c_destroy(peripheral_h handle);
 
+void peripheral_handle_i2c_scan_cache_init(gpointer user_data);
+int peripheral_handle_i2c_scan(int bus, uint64_t *bitmap, gpointer user_data);
+
 #endif /* __PERIPHERAL_HANDLE_I2C_H__ */
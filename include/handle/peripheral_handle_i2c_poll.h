@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_HANDLE_I2C_POLL_H__
+#define __PERIPHERAL_HANDLE_I2C_POLL_H__
+
+#include <gio/gunixfdlist.h>
+
+#define I2C_POLL_LENGTH_MAX	32
+#define I2C_POLL_INTERVAL_MIN	1
+#define I2C_POLL_INTERVAL_MAX	60000
+#define I2C_POLL_RING_SLOTS	64
+
+int peripheral_handle_i2c_poll_create(int bus, int address, int reg, int length, unsigned int interval, peripheral_h *handle, gpointer user_data);
+int peripheral_handle_i2c_poll_destroy(peripheral_h handle);
+
+int peripheral_handle_i2c_poll_fd_list_create(peripheral_h handle, GUnixFDList **list_out);
+void peripheral_handle_i2c_poll_fd_list_destroy(GUnixFDList *list);
+
+#endif /* __PERIPHERAL_HANDLE_I2C_POLL_H__ */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_HANDLE_SPI_QUEUE_H__
+#define __PERIPHERAL_HANDLE_SPI_QUEUE_H__
+
+#include <stdint.h>
+#include <gio/gunixfdlist.h>
+
+#include "peripheral_interface_spi.h"
+
+#define SPI_QUEUE_SLOTS		64
+#define SPI_QUEUE_DATA_MAX	256
+#define SPI_QUEUE_CLIENTS_MAX	16
+
+/* The next transfer belongs to the same message, keep the chip selected */
+#define PB_SPI_XFER_KEEP_CS	(1 << 0)
+
+/*
+ * Payload of a submission ring slot (see peripheral_ring.h).
+ *
+ * The client fills data with the bytes to send, sets len and advances
+ * head past a whole message, then writes to the doorbell eventfd. The
+ * daemon runs the transfer in place, so data holds the received bytes
+ * once tail has moved past the slot. slot->result is 0 or a negative
+ * errno and the completion eventfd is signalled after every batch.
+ */
+typedef struct {
+	uint32_t len;
+	uint32_t speed_hz;	/* 0 for the device setting */
+	uint16_t delay_usecs;
+	uint8_t bits_per_word;	/* 0 for the device setting */
+	uint8_t flags;		/* PB_SPI_XFER_* */
+	uint8_t data[SPI_QUEUE_DATA_MAX];
+} pb_spi_xfer_s;
+
+/* The fd list order is ring, doorbell, completion */
+int peripheral_handle_spi_queue_attach(peripheral_h handle, int priority, const peripheral_interface_spi_config_s *config, gpointer user_data);
+void peripheral_handle_spi_queue_detach(peripheral_h handle);
+
+int peripheral_handle_spi_queue_fd_list_create(peripheral_h handle, GUnixFDList **list_out);
+void peripheral_handle_spi_queue_fd_list_destroy(GUnixFDList *list);
+
+#endif /* __PERIPHERAL_HANDLE_SPI_QUEUE_H__ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_HANDLE_STATE_H__
+#define __PERIPHERAL_HANDLE_STATE_H__
+
+#include "peripheral_handle.h"
+
+#define PB_HANDLE_STATE_ARGS	5
+
+typedef enum {
+	PB_HANDLE_STATE_GPIO = 0,
+	PB_HANDLE_STATE_I2C,
+	PB_HANDLE_STATE_I2C_POLL,
+	PB_HANDLE_STATE_PWM,
+	PB_HANDLE_STATE_ADC,
+	PB_HANDLE_STATE_UART,
+	PB_HANDLE_STATE_SPI,
+	PB_HANDLE_STATE_MAX,
+} pb_handle_state_type_e;
+
+/* An open handle as a previous instance of the daemon left it */
+typedef struct {
+	unsigned int id;
+	pb_handle_state_type_e type;
+	int args[PB_HANDLE_STATE_ARGS];	/* create arguments, in order */
+	const char *owner;		/* NULL for peers */
+} pb_handle_state_s;
+
+typedef void (*pb_handle_state_cb)(const pb_handle_state_s *state, void *user_data);
+
+/*
+ * Calls cb for every handle in the state file. Loading is done before
+ * init, so that restoring the handles does not rewrite the file under us.
+ */
+int peripheral_handle_state_load(pb_handle_state_cb cb, void *user_data);
+
+/* Starts keeping the state file in step with the handle lists of info */
+void peripheral_handle_state_init(peripheral_info_s *info);
+void peripheral_handle_state_deinit(void);
+
+/* Schedules a write of the state file, changes in a burst share one write */
+void peripheral_handle_state_save(void);
+
+#endif /* __PERIPHERAL_HANDLE_STATE_H__ */
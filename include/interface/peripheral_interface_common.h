@@ -24,9 +24,11 @@
 #include <peripheral_io.h>
 
 #include "peripheral_log.h"
+#include "peripheral_root.h"
 
-#define MAX_ERR_LEN 255
 #define MAX_BUF_LEN 64
+/* Paths are prefixed with the root, which may be a long temporary directory */
+#define MAX_PATH_LEN 256
 
 #define IF_ERROR_RETURN(expr, func...) \
 	do { \
@@ -35,9 +37,7 @@
 			func; \
 			if (temp == EAGAIN) \
 				return PERIPHERAL_ERROR_TRY_AGAIN; \
-			char errmsg[MAX_ERR_LEN]; \
-			strerror_r(temp, errmsg, sizeof(errmsg)); \
-			_E("Failed the %s(%d) function. errmsg: %s", __FUNCTION__, __LINE__, errmsg); \
+			_E_ERRNO(temp, "Failed the %s(%d) function", __FUNCTION__, __LINE__); \
 			return PERIPHERAL_ERROR_IO_ERROR; \
 		} \
 	} while (0)
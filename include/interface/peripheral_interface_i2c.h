@@ -17,8 +17,20 @@
 #ifndef __PERIPHERAL_INTERFACE_I2C_H__
 #define __PERIPHERAL_INTERFACE_I2C_H__
 
+#include <stdint.h>
 #include <gio/gunixfdlist.h>
 
+/* Addresses outside this range are reserved by the I2C specification */
+#define I2C_SCAN_ADDRESS_FIRST	0x03
+#define I2C_SCAN_ADDRESS_LAST	0x77
+
+/* Devices are addressed with 7 bits, I2C_SLAVE refuses anything above */
+#define I2C_ADDRESS_MAX		0x7f
+
+int peripheral_interface_i2c_bus_open(int bus, int *fd_out);
+int peripheral_interface_i2c_read_register(int fd, int address, int reg, unsigned char *data, int length);
+int peripheral_interface_i2c_scan(int bus, uint64_t *bitmap);
+
 int peripheral_interface_i2c_fd_list_create(int bus, int address, GUnixFDList **list_out);
 void peripheral_interface_i2c_fd_list_destroy(GUnixFDList *list);
 
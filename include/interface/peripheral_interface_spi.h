@@ -18,8 +18,28 @@
 #define __PERIPHERAL_INTERFACE_SPI_H__
 
 #include <gio/gunixfdlist.h>
+#include <linux/spi/spidev.h>
 
-int peripheral_interface_spi_fd_list_create(int bus, int cs, GUnixFDList **list_out);
+/* Fields present in peripheral_interface_spi_config_s */
+#define SPI_CONFIG_MODE			(1 << 0)
+#define SPI_CONFIG_MAX_SPEED_HZ		(1 << 1)
+#define SPI_CONFIG_BITS_PER_WORD	(1 << 2)
+
+typedef struct {
+	unsigned int set;
+	unsigned int mode;
+	unsigned int max_speed_hz;
+	unsigned int bits_per_word;
+} peripheral_interface_spi_config_s;
+
+int peripheral_interface_spi_configure(int fd, const peripheral_interface_spi_config_s *config);
+
+/* For transfers issued by the daemon itself */
+int peripheral_interface_spi_open(int bus, int cs, const peripheral_interface_spi_config_s *config, int *fd_out);
+int peripheral_interface_spi_transfer(int fd, struct spi_ioc_transfer *xfers, int count);
+
+/* config may be NULL to hand out the device with its current settings */
+int peripheral_interface_spi_fd_list_create(int bus, int cs, const peripheral_interface_spi_config_s *config, GUnixFDList **list_out);
 void peripheral_interface_spi_fd_list_destroy(GUnixFDList *list);
 
 #endif /* __PERIPHERAL_INTERFACE_SPI_H__ */
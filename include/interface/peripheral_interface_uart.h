@@ -17,9 +17,29 @@
 #ifndef __PERIPHERAL_INTERFACE_UART_H__
 #define __PERIPHERAL_INTERFACE_UART_H__
 
+#include <stdbool.h>
 #include <gio/gunixfdlist.h>
 
-int peripheral_interface_uart_fd_list_create(int port, GUnixFDList **list_out);
+#define UART_PARITY_NONE	0
+#define UART_PARITY_EVEN	1
+#define UART_PARITY_ODD		2
+
+typedef struct {
+	unsigned int baud_rate;	/* any rate the driver accepts, not only Bxxx */
+	int byte_size;		/* 5 to 8 */
+	int parity;		/* UART_PARITY_* */
+	int stop_bits;		/* 1 or 2 */
+	bool sw_flow_control;
+	bool hw_flow_control;
+	int vmin;
+	int vtime;		/* in deciseconds */
+	bool low_latency;
+} peripheral_interface_uart_config_s;
+
+int peripheral_interface_uart_configure(int fd, const peripheral_interface_uart_config_s *config);
+
+/* config may be NULL to hand out the tty with its current settings */
+int peripheral_interface_uart_fd_list_create(int port, const peripheral_interface_uart_config_s *config, GUnixFDList **list_out);
 void peripheral_interface_uart_fd_list_destroy(GUnixFDList *list);
 
 #endif /* __PERIPHERAL_INTERFACE_UART_H__ */
@@ -17,8 +17,9 @@
 #ifndef __PERIPHERAL_BOARD_H__
 #define __PERIPHERAL_BOARD_H__
 
+#include <stdbool.h>
+
 #define BOARD_DEVICE_TREE	"/proc/device-tree/model"
-#define BOARD_PINS_MAX	4
 #define BOARD_ARGS_MAX	2
 
 typedef enum {
@@ -49,21 +50,67 @@ typedef struct {
 	char *path;
 } pb_board_type_s;
 
+/* Fields present in pb_board_spi_config_s */
+#define PB_BOARD_SPI_MODE		(1 << 0)
+#define PB_BOARD_SPI_MAX_SPEED_HZ	(1 << 1)
+#define PB_BOARD_SPI_BITS_PER_WORD	(1 << 2)
+
+/* e.g. "spidev0.0 = 24, 23, 21, 19 | mode=0, max_speed_hz=500000, bits_per_word=8" */
+typedef struct {
+	unsigned int set;
+	unsigned int mode;
+	unsigned int max_speed_hz;
+	unsigned int bits_per_word;
+} pb_board_spi_config_s;
+
 typedef struct {
 	pb_board_dev_e dev_type;
-	unsigned int pins[BOARD_PINS_MAX];
+	const unsigned int *pins;
 	unsigned int num_pins;
 	unsigned int args[BOARD_ARGS_MAX];
+	union {
+		pb_board_spi_config_s spi;
+	} config;
 } pb_board_dev_s;
 
+/*
+ * Devices of one type, sorted by args. When the args are dense enough,
+ * index maps (args[0] - base) * span + args[1] straight to the device,
+ * otherwise lookups fall back to a binary search.
+ */
+typedef struct {
+	const pb_board_dev_s *dev;
+	unsigned int num_dev;
+	const pb_board_dev_s **index;
+	unsigned int index_size;
+	unsigned int base;
+	unsigned int span;
+} pb_board_table_s;
+
 typedef struct {
 	pb_board_type_e type;
-	pb_board_dev_s *dev;
+	bool builtin;		/* dev points into the tables compiled from data/ */
+	const pb_board_dev_s *dev;
 	unsigned int num_dev;
+	unsigned int *pins;	/* pins of an ini override, NULL for builtin boards */
+	unsigned int num_pins;
+	pb_board_table_s table[PB_BOARD_DEV_MAX];
 } pb_board_s;
 
-pb_board_dev_s *peripheral_bus_board_find_device(pb_board_dev_e dev_type, pb_board_s *board, int arg, ...);
+const pb_board_dev_s *peripheral_bus_board_find_gpio(pb_board_s *board, int pin);
+const pb_board_dev_s *peripheral_bus_board_find_i2c(pb_board_s *board, int bus);
+const pb_board_dev_s *peripheral_bus_board_find_pwm(pb_board_s *board, int chip, int pin);
+const pb_board_dev_s *peripheral_bus_board_find_adc(pb_board_s *board, int device, int channel);
+const pb_board_dev_s *peripheral_bus_board_find_uart(pb_board_s *board, int port);
+const pb_board_dev_s *peripheral_bus_board_find_spi(pb_board_s *board, int bus, int cs);
+
 pb_board_s *peripheral_bus_board_init(void);
 void peripheral_bus_board_deinit(pb_board_s *board);
 
+/* Called on the main loop with a freshly loaded board, which the callee owns */
+typedef void (*peripheral_bus_board_reload_cb)(pb_board_s *board, void *user_data);
+
+int peripheral_bus_board_watch(pb_board_s *board, peripheral_bus_board_reload_cb callback, void *user_data);
+void peripheral_bus_board_unwatch(void);
+
 #endif /* __PERIPHERAL_BOARD_H__ */
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_BOARD_BUILTIN_H__
+#define __PERIPHERAL_BOARD_BUILTIN_H__
+
+#include "peripheral_board.h"
+
+/*
+ * Board tables generated from data/pio_board_*.ini at build time by
+ * cmake/peripheral_board_tables.cmake. Devices are sorted by type and
+ * args, the way peripheral_bus_board_index() expects them.
+ */
+typedef struct {
+	const char *name;	/* ini file name, e.g. "pio_board_rp3_b.ini" */
+	const pb_board_dev_s *dev;
+	unsigned int num_dev;
+} pb_board_builtin_s;
+
+extern const pb_board_builtin_s peripheral_bus_board_builtin[];
+extern const unsigned int peripheral_bus_board_builtin_count;
+
+#endif /* __PERIPHERAL_BOARD_BUILTIN_H__ */
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_FDSTORE_H__
+#define __PERIPHERAL_FDSTORE_H__
+
+/*
+ * Named fds handed to us by systemd, the activated socket and whatever a
+ * previous instance kept in the service's fd store.
+ */
+void peripheral_bus_fdstore_init(void);
+
+/* Closes the passed fds nobody took */
+void peripheral_bus_fdstore_flush(void);
+
+/* Returns the passed fd called name and hands over its ownership, or -1 */
+int peripheral_bus_fdstore_take(const char *name);
+
+/* Keeps a copy of fd in the fd store under name, until it is removed */
+int peripheral_bus_fdstore_put(const char *name, int fd);
+void peripheral_bus_fdstore_remove(const char *name);
+
+#endif /* __PERIPHERAL_FDSTORE_H__ */
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_IDLE_H__
+#define __PERIPHERAL_IDLE_H__
+
+typedef void (*peripheral_bus_idle_cb)(void *user_data);
+
+/*
+ * Calls cb once no handle has been open and no request has come in for
+ * timeout seconds. A timeout of 0 never expires.
+ */
+void peripheral_bus_idle_init(unsigned int timeout, peripheral_bus_idle_cb cb, void *user_data);
+void peripheral_bus_idle_deinit(void);
+
+/* Every open handle holds the daemon */
+void peripheral_bus_idle_hold(void);
+void peripheral_bus_idle_release(void);
+
+/* Restarts the countdown for requests that do not open a handle */
+void peripheral_bus_idle_touch(void);
+
+#endif /* __PERIPHERAL_IDLE_H__ */
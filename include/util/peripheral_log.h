@@ -16,14 +16,85 @@
 #ifndef __PERIPHERAL_LOG_H__
 #define __PERIPHERAL_LOG_H__
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <dlog.h>
 
 #undef LOG_TAG
 #define LOG_TAG "PERIPHERAL-BUS"
 
-#define _E(fmt, arg...) LOGE(fmt, ##arg)
-#define _D(fmt, arg...) LOGD(fmt, ##arg)
-#define _W(fmt, arg...) LOGW(fmt, ##arg)
+typedef enum {
+	PB_LOG_ERROR = 0,
+	PB_LOG_WARN,
+	PB_LOG_INFO,
+	PB_LOG_DEBUG,
+} pb_log_level_e;
+
+/* Levels above are compiled out, see LOG_LEVEL in CMakeLists.txt */
+#ifndef PERIPHERAL_BUS_LOG_LEVEL
+#define PERIPHERAL_BUS_LOG_LEVEL PB_LOG_DEBUG
+#endif
+
+/* Levels above are skipped at runtime, before the message is formatted */
+extern int peripheral_bus_log_level;
+
+int peripheral_bus_log_set_level(const char *name);
+
+#define PB_LOG_ENABLED(level) \
+	((level) <= PERIPHERAL_BUS_LOG_LEVEL && \
+	 (level) <= __atomic_load_n(&peripheral_bus_log_level, __ATOMIC_RELAXED))
+
+/*
+ * A token bucket per call site, so that a failing client cannot flood dlog.
+ * Suppressed counts are also flushed from the main loop once the bucket
+ * refills, so the count of a storm that ended is not lost.
+ */
+typedef struct _pb_log_limit_s {
+	uint64_t last;
+	uint32_t tokens;
+	uint32_t suppressed;
+	uint32_t pending;		/* queued for the flush */
+	int log_level;
+	const char *file;
+	int line;
+	struct _pb_log_limit_s *next;
+} pb_log_limit_s;
+
+bool peripheral_bus_log_allow(pb_log_limit_s *limit, unsigned int *suppressed);
+
+const char *peripheral_bus_log_strerror(int err, char *buf, size_t len);
+
+#define PB_LOG(level, log, fmt, arg...) \
+	do { \
+		if (PB_LOG_ENABLED(level)) \
+			log(fmt, ##arg); \
+	} while (0)
+
+#define PB_LOG_LIMITED(level, log, fmt, arg...) \
+	do { \
+		static pb_log_limit_s __pb_limit = {.log_level = (level), .file = __FILE__, .line = __LINE__}; \
+		unsigned int __pb_suppressed; \
+		if (PB_LOG_ENABLED(level) && peripheral_bus_log_allow(&__pb_limit, &__pb_suppressed)) { \
+			if (__pb_suppressed) \
+				log("%u messages suppressed at %s:%d", __pb_suppressed, __FILE__, __LINE__); \
+			log(fmt, ##arg); \
+		} \
+	} while (0)
+
+#define _E(fmt, arg...) PB_LOG_LIMITED(PB_LOG_ERROR, LOGE, fmt, ##arg)
+#define _W(fmt, arg...) PB_LOG_LIMITED(PB_LOG_WARN, LOGW, fmt, ##arg)
+#define _I(fmt, arg...) PB_LOG(PB_LOG_INFO, LOGI, fmt, ##arg)
+#define _D(fmt, arg...) PB_LOG(PB_LOG_DEBUG, LOGD, fmt, ##arg)
+
+/* _E with the message of err appended, only looked up when the line is logged */
+#define PB_LOG_ERR_LEN 128
+#define _E_ERRNO(err, fmt, arg...) \
+	do { \
+		int __pb_err = (err); \
+		char __pb_errmsg[PB_LOG_ERR_LEN]; \
+		_E(fmt ", errmsg : %s", ##arg, peripheral_bus_log_strerror(__pb_err, __pb_errmsg, PB_LOG_ERR_LEN)); \
+	} while (0)
 
 #define RET_IF(expr) \
 	do { \
@@ -21,6 +21,13 @@
 
 void peripheral_privilege_init(void);
 void peripheral_privilege_deinit(void);
-int peripheral_privilege_check(GDBusMethodInvocation *invocation, GDBusConnection *connection);
+int peripheral_privilege_check(GDBusMethodInvocation *invocation);
+
+/*
+ * Checks that the caller runs as root or service_fw, on the bus and on
+ * the peer socket alike. The peripheralio privilege is held by every app
+ * that opens a device, so it cannot guard what other clients do.
+ */
+int peripheral_privilege_check_admin(GDBusMethodInvocation *invocation);
 
 #endif /* __PERIPHERAL_PRIVILEGE_H__ */
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PERIPHERAL_RECORDER_H__
+#define __PERIPHERAL_RECORDER_H__
+
+#include <stdint.h>
+#include <gio/gio.h>
+
+#include "peripheral_board.h"
+#include "peripheral_stats.h"
+
+/*
+ * The last requests the daemon served, with their phase timings, for
+ * looking into a slow or failed open after the fact. Records go into a
+ * fixed ring, writing one takes no lock and no allocation.
+ */
+typedef enum {
+	PB_RECORDER_OPEN = 0,
+	PB_RECORDER_CLOSE,
+	PB_RECORDER_METHOD_MAX,
+} pb_recorder_method_e;
+
+/* Starts the record of the request the calling thread handles */
+void peripheral_bus_recorder_begin(pb_board_dev_e type, pb_recorder_method_e method,
+		GDBusMethodInvocation *invocation, int arg0, int arg1);
+
+/* Adds a phase duration to the current record, fed by peripheral_bus_stats_phase() */
+void peripheral_bus_recorder_phase(pb_stats_phase_e phase, uint64_t us);
+
+/* Stores the current record with the result of the request */
+void peripheral_bus_recorder_end(int result);
+
+/*
+ * (asa(tsssiiiau)) : the phase names, then timestamp in monotonic
+ * microseconds, sender, interface, method, args, result and phase
+ * durations in microseconds of every record, oldest first
+ */
+GVariant *peripheral_bus_recorder_records(void);
+
+/* Writes the records as CSV to /run/peripheral-bus/records.csv on SIGUSR1 */
+int peripheral_bus_recorder_init(void);
+void peripheral_bus_recorder_deinit(void);
+
+#endif /* __PERIPHERAL_RECORDER_H__ */
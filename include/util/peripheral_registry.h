@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_REGISTRY_H__
+#define __PERIPHERAL_REGISTRY_H__
+
+#include <stddef.h>
+
+#include "peripheral_board.h"
+
+/*
+ * Devices found through udev, kept current by hotplug events. Board
+ * lookups fall back to the registry for devices the board does not list,
+ * such as USB adapters and overlay-loaded controllers.
+ */
+int peripheral_bus_registry_init(void);
+void peripheral_bus_registry_deinit(void);
+
+const pb_board_dev_s *peripheral_bus_registry_find(pb_board_dev_e dev_type, int arg0, int arg1);
+
+/* Copies the node to open for i2c, spi, adc and uart devices into path */
+int peripheral_bus_registry_resolve(pb_board_dev_e dev_type, int arg0, int arg1, char *path, size_t len);
+
+/*
+ * Opens the node of a device, close-on-exec. Every call opens a new file
+ * description: i2c-dev, spidev and IIO keep per-open state (client
+ * address, file offset, status flags) that must not leak between handles.
+ */
+int peripheral_bus_registry_open(pb_board_dev_e dev_type, int arg0, int arg1, int flags, int *fd_out);
+
+#endif /* __PERIPHERAL_REGISTRY_H__ */
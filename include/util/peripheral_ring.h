@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_RING_H__
+#define __PERIPHERAL_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PB_RING_MAGIC	0x47524250	/* "PBRG" */
+#define PB_RING_VERSION	1
+#define PB_RING_ALIGN	64
+
+/*
+ * Shared memory layout of a ring, as seen by clients mapping the memfd.
+ *
+ * The header is followed by slot_count slots of slot_size bytes each.
+ * Every slot starts with a pb_ring_slot_s and carries up to
+ * slot_size - sizeof(pb_ring_slot_s) bytes of payload.
+ *
+ * Publishing rings (written by the daemon) use a per-slot sequence lock:
+ * slot->seq is odd while the slot is written and becomes 2 * (pos + 1)
+ * once the entry at position pos is complete. Readers keep their own
+ * position, compare seq before and after copying the payload and retry
+ * or skip ahead when the writer lapped them.
+ *
+ * Submission rings (written by a client) use head/tail: the client fills
+ * the slot at head and advances head, the daemon advances tail after
+ * completing the slot.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_size;
+	uint32_t slot_count;
+	uint64_t head __attribute__((aligned(PB_RING_ALIGN)));
+	uint64_t tail __attribute__((aligned(PB_RING_ALIGN)));
+} __attribute__((aligned(PB_RING_ALIGN))) pb_ring_header_s;
+
+typedef struct {
+	uint64_t seq;
+	uint64_t timestamp;	/* CLOCK_MONOTONIC in nanoseconds */
+	uint32_t length;
+	int32_t result;
+} pb_ring_slot_s;
+
+/*
+ * The geometry is kept apart from the shared header: clients may write to
+ * submission rings, so the daemon never indexes slots by what is mapped.
+ */
+typedef struct {
+	int fd;
+	size_t size;
+	uint32_t slot_size;
+	uint32_t slot_count;
+	pb_ring_header_s *header;
+	uint8_t *slots;
+} pb_ring_s;
+
+int peripheral_bus_ring_create(const char *name, unsigned int payload_size, unsigned int slot_count, pb_ring_s **ring_out);
+/* Takes over fd of a ring created before, e.g. by a previous instance */
+int peripheral_bus_ring_attach(int fd, pb_ring_s **ring_out);
+void peripheral_bus_ring_destroy(pb_ring_s *ring);
+
+int peripheral_bus_ring_get_fd(pb_ring_s *ring, bool read_only, int *fd_out);
+pb_ring_slot_s *peripheral_bus_ring_get_slot(pb_ring_s *ring, uint64_t pos);
+void peripheral_bus_ring_publish(pb_ring_s *ring, const void *data, unsigned int length, int result);
+
+uint64_t peripheral_bus_ring_get_timestamp(void);
+
+#endif /* __PERIPHERAL_RING_H__ */
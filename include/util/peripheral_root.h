@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_ROOT_H__
+#define __PERIPHERAL_ROOT_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Sysfs, device nodes, the board ini and the runtime directory are all
+ * looked up below a root, "/" unless the daemon runs against another
+ * tree, e.g. one populated by the simulator.
+ */
+int peripheral_bus_root_init(const char *root);
+bool peripheral_bus_root_is_set(void);
+const char *peripheral_bus_root_get(void);
+
+/* Formats an absolute path and prefixes it with the root */
+int peripheral_bus_root_path(char *path, size_t len, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#endif /* __PERIPHERAL_ROOT_H__ */
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_SIM_H__
+#define __PERIPHERAL_SIM_H__
+
+#include <stdbool.h>
+
+#include "peripheral_board.h"
+
+/*
+ * Stands in for the kernel below a root (--root), so that the daemon can
+ * be benchmarked without hardware. Device nodes of every board device are
+ * plain files, and sysfs exports appear after latency_us, which covers
+ * the wait for udev on a real board.
+ */
+int peripheral_bus_sim_init(pb_board_s *board, unsigned int latency_us);
+
+/* A root without --simulate is only a prefix, e.g. onto the host's sysfs */
+bool peripheral_bus_sim_is_active(void);
+
+int peripheral_bus_sim_gpio_export(int pin);
+int peripheral_bus_sim_gpio_unexport(int pin);
+int peripheral_bus_sim_pwm_export(int chip, int pin);
+int peripheral_bus_sim_pwm_unexport(int chip, int pin);
+
+#endif /* __PERIPHERAL_SIM_H__ */
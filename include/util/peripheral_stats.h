@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PERIPHERAL_STATS_H__
+#define __PERIPHERAL_STATS_H__
+
+#include <stdint.h>
+#include <glib.h>
+
+#include "peripheral_board.h"
+
+/*
+ * Where open and close time goes, per interface. Recording only touches
+ * fixed arrays, so handlers can record on every request.
+ */
+typedef enum {
+	PB_STATS_PHASE_PRIVILEGE = 0,
+	PB_STATS_PHASE_HANDLE_CREATE,
+	PB_STATS_PHASE_EXPORT,		/* includes the udev wait */
+	PB_STATS_PHASE_UDEV_WAIT,
+	PB_STATS_PHASE_FD_OPEN,
+	PB_STATS_PHASE_REPLY,
+	PB_STATS_PHASE_OPEN,		/* the whole Open */
+	PB_STATS_PHASE_UNEXPORT,
+	PB_STATS_PHASE_HANDLE_DESTROY,
+	PB_STATS_PHASE_CLOSE,		/* the whole Close */
+	PB_STATS_PHASE_MAX,
+} pb_stats_phase_e;
+
+/* Names used in the exported stats, "unknown" when out of range */
+const char *peripheral_bus_stats_type_name(pb_board_dev_e type);
+const char *peripheral_bus_stats_phase_name(pb_stats_phase_e phase);
+
+/* Monotonic time in microseconds, what phases are measured from */
+uint64_t peripheral_bus_stats_now(void);
+
+/* Starts timing the request the calling thread handles, returns now */
+uint64_t peripheral_bus_stats_begin(void);
+
+/* When the calling thread began its request or last recorded a phase */
+uint64_t peripheral_bus_stats_mark(void);
+
+/* Records the time since start for the phase, returns now for the next one */
+uint64_t peripheral_bus_stats_phase(pb_board_dev_e type, pb_stats_phase_e phase, uint64_t start);
+
+/* Counts a finished Open or Close, failures by their error code */
+void peripheral_bus_stats_open(pb_board_dev_e type, int result);
+void peripheral_bus_stats_close(pb_board_dev_e type, int result);
+
+/* Counts a handle released because its client went away */
+void peripheral_bus_stats_vanished(pb_board_dev_e type);
+
+/* How late the main loop ran a heartbeat, and stalls the watchdog caught */
+void peripheral_bus_stats_loop_delay(uint64_t us);
+void peripheral_bus_stats_loop_stall(void);
+
+/* Fills the number of open handles of every interface */
+typedef void (*pb_stats_active_cb)(unsigned int active[PB_BOARD_DEV_MAX], gpointer user_data);
+
+/*
+ * (a(sttta{st}a{st}u)) : interface, opens, closes, vanished, failed opens
+ * and failed closes by error, and open handles
+ */
+GVariant *peripheral_bus_stats_counters(const unsigned int active[PB_BOARD_DEV_MAX]);
+
+/*
+ * (ata(ssttat)) : inclusive upper bounds of the buckets in microseconds,
+ * then interface, phase, count, sum and bucket counts of each histogram
+ */
+GVariant *peripheral_bus_stats_histograms(void);
+
+/* Everything in the Prometheus text format, to be freed with g_free() */
+gchar *peripheral_bus_stats_text(const unsigned int active[PB_BOARD_DEV_MAX]);
+
+/* Serves the text to every connection on a unix socket at path */
+int peripheral_bus_stats_listen(const char *path, pb_stats_active_cb cb, gpointer user_data);
+void peripheral_bus_stats_unlisten(void);
+
+#endif /* __PERIPHERAL_STATS_H__ */
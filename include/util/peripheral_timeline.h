@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PERIPHERAL_TIMELINE_H__
+#define __PERIPHERAL_TIMELINE_H__
+
+#include <stdint.h>
+
+/*
+ * Where startup time goes, from exec to READY=1. Stages are marked when
+ * they end and last since the previous mark. Only the thread that called
+ * init marks stages, and only until finish.
+ */
+typedef struct {
+	const char *name;
+	uint64_t start;		/* us since exec */
+	uint64_t duration;	/* us */
+} pb_timeline_stage_s;
+
+void peripheral_bus_timeline_init(void);
+void peripheral_bus_timeline_mark(const char *stage);
+
+/* Logs the timeline as one line, stages marked afterwards are ignored */
+void peripheral_bus_timeline_finish(void);
+
+/* Fills stages with the marked stages in order, returns their number */
+int peripheral_bus_timeline_get(const pb_timeline_stage_s **stages);
+
+#endif /* __PERIPHERAL_TIMELINE_H__ */
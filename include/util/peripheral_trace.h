@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PERIPHERAL_TRACE_H__
+#define __PERIPHERAL_TRACE_H__
+
+/*
+ * USDT probes of the peripheral_bus provider, for bpftrace and perf, e.g.
+ * usdt:/usr/bin/peripheral-bus:peripheral_bus:open_return. A probe
+ * is a nop until a tracer attaches, its arguments only have to be at hand.
+ * Builds without sys/sdt.h get no probes at all.
+ */
+#ifdef PERIPHERAL_BUS_USDT
+#include <sys/sdt.h>
+
+#define PB_TRACE(name, ...)	STAP_PROBEV(peripheral_bus, name, ##__VA_ARGS__)
+#else
+#define PB_TRACE(name, ...)	do { } while (0)
+#endif
+
+#endif /* __PERIPHERAL_TRACE_H__ */
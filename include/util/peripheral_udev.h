@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERIPHERAL_UDEV_H__
+#define __PERIPHERAL_UDEV_H__
+
+#include <libudev.h>
+
+typedef void (*peripheral_bus_udev_cb)(const char *action, struct udev_device *dev, void *user_data);
+
+int peripheral_bus_udev_init(void);
+void peripheral_bus_udev_deinit(void);
+
+int peripheral_bus_udev_add_listener(const char *subsystem, peripheral_bus_udev_cb callback, void *user_data);
+int peripheral_bus_udev_enumerate(const char *subsystem, peripheral_bus_udev_cb callback, void *user_data);
+
+#endif /* __PERIPHERAL_UDEV_H__ */
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PERIPHERAL_WATCHDOG_H__
+#define __PERIPHERAL_WATCHDOG_H__
+
+/*
+ * Watches the main loop from a thread of its own. A heartbeat on the loop
+ * stamps when it runs, a beat missing for more than threshold_ms is a
+ * stall, logged with the handler that was running. The systemd watchdog
+ * is only fed while beats come in time. A threshold of 0 picks a default.
+ */
+int peripheral_bus_watchdog_init(unsigned int threshold_ms);
+void peripheral_bus_watchdog_deinit(void);
+
+/* Names the handler the main loop runs, both strings must outlive the call */
+void peripheral_bus_watchdog_enter(const char *interface, const char *method);
+void peripheral_bus_watchdog_leave(void);
+
+#endif /* __PERIPHERAL_WATCHDOG_H__ */
@@ -10,6 +10,8 @@ Source2:    %{name}.service
 Source3:    %{name}.tmpfiles.conf
 Source4:    90-peripheral-io.rules
 Source5:    org.tizen.peripheral_io.conf
+Source6:    org.tizen.peripheral_io.service
+Source7:    %{name}.socket
 BuildRequires:  cmake
 BuildRequires:  pkgconfig(glib-2.0)
 BuildRequires:  pkgconfig(gio-2.0)
@@ -19,6 +21,7 @@ BuildRequires:  pkgconfig(capi-system-peripheral-io)
 BuildRequires:  pkgconfig(iniparser)
 BuildRequires:  pkgconfig(libudev)
 BuildRequires:  pkgconfig(cynara-creds-gdbus)
+BuildRequires:  pkgconfig(cynara-creds-socket)
 BuildRequires:  pkgconfig(cynara-client)
 BuildRequires:  pkgconfig(cynara-session)
 
@@ -41,18 +44,22 @@ MAJORVER=`echo %{version} | awk 'BEGIN {FS="."}{print $1}'`
 %install
 
 %make_install
-mkdir -p %{buildroot}%{_unitdir}/multi-user.target.wants
-install -m 0644 %SOURCE2 %{buildroot}%{_unitdir}/peripheral-bus.service
+install -D -m 0644 %SOURCE2 %{buildroot}%{_unitdir}/peripheral-bus.service
+install -D -m 0644 %SOURCE7 %{buildroot}%{_unitdir}/peripheral-bus.socket
 mkdir -p %{buildroot}%{_tmpfilesdir}
 install -m 0644 %SOURCE3 %{buildroot}%{_tmpfilesdir}/%{name}.conf
 mkdir -p %{buildroot}%{_udevrulesdir}
 install -m 0644 %SOURCE4 %{buildroot}%{_udevrulesdir}
-%install_service multi-user.target.wants peripheral-bus.service
+# Started on demand by its socket or the bus, and exits again when idle
+%install_service sockets.target.wants peripheral-bus.socket
 mkdir -p %{buildroot}%{_sysconfdir}/dbus-1/system.d
 install -m 0644 %{SOURCE5} %{buildroot}%{_sysconfdir}/dbus-1/system.d/
+install -D -m 0644 %{SOURCE6} %{buildroot}%{_datadir}/dbus-1/system-services/org.tizen.peripheral_io.service
 
-mkdir -p %{buildroot}/etc/peripheral-bus
-cp %{_builddir}/%{name}-%{version}/data/*.ini %{buildroot}/etc/%{name}
+# Board tables are compiled in, the ini files are shipped as a reference
+# for overrides dropped into %{_sysconfdir}/%{name}/
+mkdir -p %{buildroot}%{_datadir}/%{name}
+cp %{_builddir}/%{name}-%{version}/data/*.ini %{buildroot}%{_datadir}/%{name}
 
 %files
 %manifest %{name}.manifest
@@ -61,7 +68,9 @@ cp %{_builddir}/%{name}-%{version}/data/*.ini %{buildroot}/etc/%{name}
 %license LICENSE.APLv2
 %{_bindir}/%{name}
 %{_unitdir}/%{name}.service
+%{_unitdir}/%{name}.socket
 %{_tmpfilesdir}/%{name}.conf
 /usr/lib/udev/rules.d/90-peripheral-io.rules
-%{_unitdir}/multi-user.target.wants/%{name}.service
-/etc/peripheral-bus/*.ini
+%{_unitdir}/sockets.target.wants/%{name}.socket
+%{_datadir}/dbus-1/system-services/org.tizen.peripheral_io.service
+%{_datadir}/%{name}/*.ini
@@ -0,0 +1,645 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <systemd/sd-daemon.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_idle.h"
+#include "peripheral_fdstore.h"
+#include "peripheral_root.h"
+#include "peripheral_watchdog.h"
+#include "peripheral_stats.h"
+#include "peripheral_recorder.h"
+#include "peripheral_trace.h"
+#include "peripheral_handle_common.h"
+#include "peripheral_handle_state.h"
+#include "peripheral_gdbus.h"
+#include "peripheral_gdbus_gpio.h"
+#include "peripheral_gdbus_i2c.h"
+#include "peripheral_gdbus_pwm.h"
+#include "peripheral_gdbus_adc.h"
+#include "peripheral_gdbus_spi.h"
+#include "peripheral_gdbus_stats.h"
+#include "peripheral_gdbus_uart.h"
+
+#define PERIPHERAL_GDBUS_INTERFACE_PREFIX	"org.tizen.peripheral_io."
+#define PERIPHERAL_GDBUS_PEER_DIR	"/run/peripheral-bus"
+#define PERIPHERAL_GDBUS_PEER_PATH	PERIPHERAL_GDBUS_PEER_DIR "/peripheral-bus.sock"
+#define PERIPHERAL_GDBUS_PEER_PATH_MAX	108	/* sun_path */
+#define PERIPHERAL_GDBUS_PEER_FD_NAME	"peer"	/* FileDescriptorName of the socket unit */
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* Opens and closes are timed, counted, traced and recorded around the handler */
+typedef enum {
+	PB_GDBUS_METHOD_CALL = 0,
+	PB_GDBUS_METHOD_OPEN,
+	PB_GDBUS_METHOD_CLOSE,
+} pb_gdbus_method_e;
+
+typedef struct {
+	const char *name;
+	peripheral_gdbus_method_cb cb;
+	pb_gdbus_method_e method;
+	const char *args;	/* types of the leading in arguments to record, e.g. "ii" */
+} pb_gdbus_method_s;
+
+typedef struct {
+	const char *interface;
+	pb_board_dev_e type;
+	const char *path;
+	const pb_gdbus_method_s *methods;
+	int num_methods;
+} pb_gdbus_object_s;
+
+typedef struct {
+	const pb_gdbus_object_s *object;
+	peripheral_info_s *info;
+} pb_gdbus_registration_s;
+
+static const pb_gdbus_method_s __gpio_methods[] = {
+	{"Open", peripheral_gdbus_gpio_open, PB_GDBUS_METHOD_OPEN, "i"},
+	{"Close", peripheral_gdbus_gpio_close, PB_GDBUS_METHOD_CLOSE, "u"},
+};
+
+static const pb_gdbus_method_s __i2c_methods[] = {
+	{"Open", peripheral_gdbus_i2c_open, PB_GDBUS_METHOD_OPEN, "ii"},
+	{"Close", peripheral_gdbus_i2c_close, PB_GDBUS_METHOD_CLOSE, "u"},
+	{"PollStart", peripheral_gdbus_i2c_poll_start},
+	{"PollStop", peripheral_gdbus_i2c_poll_stop},
+	{"Scan", peripheral_gdbus_i2c_scan},
+};
+
+static const pb_gdbus_method_s __pwm_methods[] = {
+	{"Open", peripheral_gdbus_pwm_open, PB_GDBUS_METHOD_OPEN, "ii"},
+	{"Close", peripheral_gdbus_pwm_close, PB_GDBUS_METHOD_CLOSE, "u"},
+};
+
+static const pb_gdbus_method_s __adc_methods[] = {
+	{"Open", peripheral_gdbus_adc_open, PB_GDBUS_METHOD_OPEN, "ii"},
+	{"Close", peripheral_gdbus_adc_close, PB_GDBUS_METHOD_CLOSE, "u"},
+};
+
+static const pb_gdbus_method_s __uart_methods[] = {
+	{"Open", peripheral_gdbus_uart_open, PB_GDBUS_METHOD_OPEN, "i"},
+	{"OpenWithConfig", peripheral_gdbus_uart_open_with_config, PB_GDBUS_METHOD_OPEN, "i"},
+	{"Close", peripheral_gdbus_uart_close, PB_GDBUS_METHOD_CLOSE, "u"},
+};
+
+static const pb_gdbus_method_s __spi_methods[] = {
+	{"Open", peripheral_gdbus_spi_open, PB_GDBUS_METHOD_OPEN, "ii"},
+	{"OpenWithConfig", peripheral_gdbus_spi_open_with_config, PB_GDBUS_METHOD_OPEN, "ii"},
+	{"QueueAttach", peripheral_gdbus_spi_queue_attach, PB_GDBUS_METHOD_OPEN, "ii"},
+	{"Close", peripheral_gdbus_spi_close, PB_GDBUS_METHOD_CLOSE, "u"},
+};
+
+static const pb_gdbus_method_s __stats_methods[] = {
+	{"GetCounters", peripheral_gdbus_stats_get_counters},
+	{"GetHistograms", peripheral_gdbus_stats_get_histograms},
+	{"GetText", peripheral_gdbus_stats_get_text},
+	{"GetTimeline", peripheral_gdbus_stats_get_timeline},
+	{"GetRecords", peripheral_gdbus_stats_get_records},
+};
+
+#define PB_GDBUS_OBJECT(name, type, path, methods) \
+	{PERIPHERAL_GDBUS_INTERFACE_PREFIX name, type, path, methods, ARRAY_SIZE(methods)}
+
+static const pb_gdbus_object_s __objects[] = {
+	PB_GDBUS_OBJECT("gpio", PB_BOARD_DEV_GPIO, "/Org/Tizen/Peripheral_io/Gpio", __gpio_methods),
+	PB_GDBUS_OBJECT("i2c", PB_BOARD_DEV_I2C, "/Org/Tizen/Peripheral_io/I2c", __i2c_methods),
+	PB_GDBUS_OBJECT("pwm", PB_BOARD_DEV_PWM, "/Org/Tizen/Peripheral_io/Pwm", __pwm_methods),
+	PB_GDBUS_OBJECT("adc", PB_BOARD_DEV_ADC, "/Org/Tizen/Peripheral_io/Adc", __adc_methods),
+	PB_GDBUS_OBJECT("uart", PB_BOARD_DEV_UART, "/Org/Tizen/Peripheral_io/Uart", __uart_methods),
+	PB_GDBUS_OBJECT("spi", PB_BOARD_DEV_SPI, "/Org/Tizen/Peripheral_io/Spi", __spi_methods),
+	PB_GDBUS_OBJECT("stats", PB_BOARD_DEV_MAX, "/Org/Tizen/Peripheral_io/Stats", __stats_methods),
+};
+
+/* A connection the objects are exported on, the system bus or a peer */
+typedef struct {
+	GDBusConnection *connection;
+	guint ids[ARRAY_SIZE(__objects)];
+	gulong closed_id;
+} pb_gdbus_link_s;
+
+static GDBusNodeInfo *__introspection;
+static pb_gdbus_registration_s __registrations[ARRAY_SIZE(__objects)];
+
+static pb_gdbus_link_s __bus;
+static GSocketService *__service;
+static GDBusAuthObserver *__observer;
+static gchar *__guid;
+static bool __activated;
+static char __peer_dir[PERIPHERAL_GDBUS_PEER_PATH_MAX];
+static char __peer_path[PERIPHERAL_GDBUS_PEER_PATH_MAX];
+static GList *__peers;
+
+static void __gdbus_method_args(const pb_gdbus_method_s *method, GVariant *parameters, int args[2])
+{
+	char type[2] = {0, };
+	int i;
+
+	args[0] = -1;
+	args[1] = -1;
+
+	/* i and u are both read as 32 bits, handle ids are recorded as they are */
+	for (i = 0; i < 2 && method->args[i]; i++) {
+		type[0] = method->args[i];
+		g_variant_get_child(parameters, i, type, &args[i]);
+	}
+}
+
+static void __gdbus_method_run(const pb_gdbus_object_s *object,
+		const pb_gdbus_method_s *method,
+		GVariant *parameters,
+		GDBusMethodInvocation *invocation,
+		peripheral_info_s *info)
+{
+	uint64_t start;
+	int args[2];
+	int ret;
+
+	if (method->method == PB_GDBUS_METHOD_CALL) {
+		method->cb(invocation, parameters, info);
+		return;
+	}
+
+	__gdbus_method_args(method, parameters, args);
+
+	start = peripheral_bus_stats_begin();
+	if (method->method == PB_GDBUS_METHOD_OPEN) {
+		PB_TRACE(open_entry, peripheral_bus_stats_type_name(object->type), args[0], args[1]);
+		peripheral_bus_recorder_begin(object->type, PB_RECORDER_OPEN, invocation, args[0], args[1]);
+	} else {
+		PB_TRACE(close_entry, peripheral_bus_stats_type_name(object->type), args[0]);
+		peripheral_bus_recorder_begin(object->type, PB_RECORDER_CLOSE, invocation, args[0], args[1]);
+	}
+
+	/* The handler replies, invocation is not to be touched afterwards */
+	ret = method->cb(invocation, parameters, info);
+
+	/* From the last phase the handler marked, through the reply */
+	peripheral_bus_stats_phase(object->type, PB_STATS_PHASE_REPLY, peripheral_bus_stats_mark());
+
+	if (method->method == PB_GDBUS_METHOD_OPEN) {
+		peripheral_bus_stats_phase(object->type, PB_STATS_PHASE_OPEN, start);
+		peripheral_bus_stats_open(object->type, ret);
+		PB_TRACE(open_return, peripheral_bus_stats_type_name(object->type), args[0], args[1], ret);
+	} else {
+		peripheral_bus_stats_phase(object->type, PB_STATS_PHASE_CLOSE, start);
+		peripheral_bus_stats_close(object->type, ret);
+		PB_TRACE(close_return, peripheral_bus_stats_type_name(object->type), args[0], ret);
+	}
+
+	peripheral_bus_recorder_end(ret);
+}
+
+static void __gdbus_method_call(GDBusConnection *connection,
+		const gchar *sender,
+		const gchar *object_path,
+		const gchar *interface_name,
+		const gchar *method_name,
+		GVariant *parameters,
+		GDBusMethodInvocation *invocation,
+		gpointer user_data)
+{
+	pb_gdbus_registration_s *reg = (pb_gdbus_registration_s*)user_data;
+	const pb_gdbus_object_s *object = reg->object;
+	int i;
+
+	peripheral_bus_idle_touch();
+
+	for (i = 0; i < object->num_methods; i++) {
+		if (strcmp(object->methods[i].name, method_name) == 0) {
+			peripheral_bus_watchdog_enter(object->interface, object->methods[i].name);
+			__gdbus_method_run(object, &object->methods[i], parameters, invocation, reg->info);
+			peripheral_bus_watchdog_leave();
+			return;
+		}
+	}
+
+	/* Not reached for methods in the introspection data, GDBus rejects the rest */
+	_E("No handler for %s.%s", interface_name, method_name);
+	g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+			G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s", method_name);
+}
+
+static const GDBusInterfaceVTable __gdbus_vtable = {
+	.method_call = __gdbus_method_call,
+};
+
+static int __gdbus_init(peripheral_info_s *info)
+{
+	GError *error = NULL;
+	int i;
+
+	if (__introspection)
+		return PERIPHERAL_ERROR_NONE;
+
+	__introspection = g_dbus_node_info_new_for_xml(peripheral_gdbus_introspection_xml, &error);
+	if (__introspection == NULL) {
+		_E("Failed to parse introspection data : %s", error->message);
+		g_error_free(error);
+		return PERIPHERAL_ERROR_UNKNOWN;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(__objects); i++) {
+		__registrations[i].object = &__objects[i];
+		__registrations[i].info = info;
+	}
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static void __gdbus_link_register(pb_gdbus_link_s *link, GDBusConnection *connection)
+{
+	GDBusInterfaceInfo *interface;
+	GError *error = NULL;
+	int i;
+
+	link->connection = connection;
+
+	for (i = 0; i < ARRAY_SIZE(__objects); i++) {
+		interface = g_dbus_node_info_lookup_interface(__introspection, __objects[i].interface);
+		if (interface == NULL) {
+			_E("No introspection data for %s", __objects[i].interface);
+			continue;
+		}
+
+		link->ids[i] = g_dbus_connection_register_object(connection,
+				__objects[i].path, interface, &__gdbus_vtable,
+				&__registrations[i], NULL, &error);
+		if (link->ids[i] == 0) {
+			_E("Failed to register %s : %s", __objects[i].path, error->message);
+			g_clear_error(&error);
+		}
+	}
+}
+
+static void __gdbus_link_unregister(pb_gdbus_link_s *link)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(link->ids); i++) {
+		if (link->ids[i] == 0)
+			continue;
+
+		g_dbus_connection_unregister_object(link->connection, link->ids[i]);
+		link->ids[i] = 0;
+	}
+}
+
+int peripheral_gdbus_register(peripheral_info_s *info)
+{
+	RETVM_IF(info == NULL || info->connection == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid connection");
+
+	int ret;
+
+	ret = __gdbus_init(info);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
+
+	__gdbus_link_register(&__bus, info->connection);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_gdbus_unregister(peripheral_info_s *info)
+{
+	if (__bus.connection) {
+		__gdbus_link_unregister(&__bus);
+		__bus.connection = NULL;
+	}
+
+	if (__introspection) {
+		g_dbus_node_info_unref(__introspection);
+		__introspection = NULL;
+	}
+}
+
+static void __gdbus_peer_free(pb_gdbus_link_s *peer)
+{
+	__gdbus_link_unregister(peer);
+	g_signal_handler_disconnect(peer->connection, peer->closed_id);
+	g_object_unref(peer->connection);
+	free(peer);
+}
+
+static void __gdbus_peer_closed(GDBusConnection *connection,
+		gboolean remote_peer_vanished,
+		GError *error,
+		gpointer user_data)
+{
+	pb_gdbus_link_s *peer = (pb_gdbus_link_s*)user_data;
+
+	_D("Peer connection closed");
+
+	__peers = g_list_remove(__peers, peer);
+	__gdbus_peer_free(peer);
+}
+
+static void __gdbus_peer_ready(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	GDBusConnection *connection;
+	pb_gdbus_link_s *peer;
+	GError *error = NULL;
+
+	connection = g_dbus_connection_new_finish(result, &error);
+	if (connection == NULL) {
+		_E("Failed to set up peer connection : %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	peer = (pb_gdbus_link_s*)calloc(1, sizeof(pb_gdbus_link_s));
+	if (peer == NULL) {
+		_E("Failed to allocate peer connection");
+		g_dbus_connection_close(connection, NULL, NULL, NULL);
+		g_object_unref(connection);
+		return;
+	}
+
+	__gdbus_link_register(peer, connection);
+	peer->closed_id = g_signal_connect(connection, "closed", G_CALLBACK(__gdbus_peer_closed), peer);
+
+	__peers = g_list_prepend(__peers, peer);
+
+	/* Held back until now, so that no call reaches an object before it is exported */
+	g_dbus_connection_start_message_processing(connection);
+}
+
+static gboolean __gdbus_peer_incoming(GSocketService *service,
+		GSocketConnection *connection,
+		GObject *source,
+		gpointer user_data)
+{
+	g_dbus_connection_new(G_IO_STREAM(connection), __guid,
+			G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER | G_DBUS_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING,
+			__observer, NULL, __gdbus_peer_ready, NULL);
+
+	return TRUE;
+}
+
+/* Only the kernel vouches for a peer, cookie based mechanisms would let anyone in */
+static gboolean __gdbus_peer_allow_mechanism(GDBusAuthObserver *observer,
+		const gchar *mechanism,
+		gpointer user_data)
+{
+	return g_strcmp0(mechanism, "EXTERNAL") == 0;
+}
+
+/* Takes over the socket when systemd started us for a client on it */
+static GSocket *__gdbus_peer_activated_socket(void)
+{
+	GSocket *socket;
+	GError *error = NULL;
+	int fd;
+
+	fd = peripheral_bus_fdstore_take(PERIPHERAL_GDBUS_PEER_FD_NAME);
+	if (fd < 0)
+		return NULL;
+
+	if (sd_is_socket_unix(fd, SOCK_STREAM, 1, __peer_path, 0) <= 0) {
+		_E("Passed socket is not %s", __peer_path);
+		close(fd);
+		return NULL;
+	}
+
+	socket = g_socket_new_from_fd(fd, &error);
+	if (socket == NULL) {
+		_E("Failed to adopt the passed socket : %s", error->message);
+		g_error_free(error);
+		close(fd);
+		return NULL;
+	}
+
+	return socket;
+}
+
+static int __gdbus_peer_listen(GSocketListener *listener)
+{
+	GSocketAddress *address;
+	GSocket *socket;
+	GError *error = NULL;
+	gboolean ret;
+
+	socket = __gdbus_peer_activated_socket();
+	if (socket) {
+		__activated = true;
+		ret = g_socket_listener_add_socket(listener, socket, NULL, &error);
+		g_object_unref(socket);
+	} else {
+		/* A socket left behind by a previous instance would make the bind fail */
+		mkdir(__peer_dir, 0755);
+		unlink(__peer_path);
+
+		address = g_unix_socket_address_new(__peer_path);
+		ret = g_socket_listener_add_address(listener, address, G_SOCKET_TYPE_STREAM,
+				G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error);
+		g_object_unref(address);
+
+		/* Anyone may connect, every method checks the privilege of its caller */
+		if (ret && chmod(__peer_path, 0666) != 0)
+			_E("Failed to open up %s, errno : %d", __peer_path, errno);
+	}
+
+	if (!ret) {
+		_E("Failed to listen on %s : %s", __peer_path, error->message);
+		g_error_free(error);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_peer_start(peripheral_info_s *info)
+{
+	RETVM_IF(info == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid info");
+	RETV_IF(__service != NULL, PERIPHERAL_ERROR_NONE);
+
+	int ret;
+
+	ret = __gdbus_init(info);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
+
+	peripheral_bus_root_path(__peer_dir, PERIPHERAL_GDBUS_PEER_PATH_MAX, PERIPHERAL_GDBUS_PEER_DIR);
+	peripheral_bus_root_path(__peer_path, PERIPHERAL_GDBUS_PEER_PATH_MAX, PERIPHERAL_GDBUS_PEER_PATH);
+
+	__service = g_socket_service_new();
+
+	ret = __gdbus_peer_listen(G_SOCKET_LISTENER(__service));
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		g_object_unref(__service);
+		__service = NULL;
+		return ret;
+	}
+
+	__guid = g_dbus_generate_guid();
+	__observer = g_dbus_auth_observer_new();
+	g_signal_connect(__observer, "allow-mechanism", G_CALLBACK(__gdbus_peer_allow_mechanism), NULL);
+
+	g_signal_connect(__service, "incoming", G_CALLBACK(__gdbus_peer_incoming), NULL);
+	g_socket_service_start(__service);
+
+	_D("Listening on %s%s", __peer_path, __activated ? ", socket activated" : "");
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_gdbus_peer_stop(void)
+{
+	if (__service == NULL)
+		return;
+
+	g_socket_service_stop(__service);
+	g_socket_listener_close(G_SOCKET_LISTENER(__service));
+	g_object_unref(__service);
+	__service = NULL;
+
+	g_list_free_full(__peers, (GDestroyNotify)__gdbus_peer_free);
+	__peers = NULL;
+
+	g_object_unref(__observer);
+	__observer = NULL;
+	g_free(__guid);
+	__guid = NULL;
+
+	/* The socket unit owns an activated socket and keeps listening on it */
+	if (!__activated)
+		unlink(__peer_path);
+}
+
+static void __gdbus_client_closed(GDBusConnection *connection,
+		gboolean remote_peer_vanished,
+		GError *error,
+		gpointer user_data)
+{
+	peripheral_h handle = (peripheral_h)user_data;
+
+	handle->vanished(connection, "peer", handle);
+}
+
+static void __gdbus_watch_owner(peripheral_h handle, const char *owner, GBusNameVanishedCallback vanished)
+{
+	handle->owner = strdup(owner);
+	handle->watch_id = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
+			owner,
+			G_BUS_NAME_WATCHER_FLAGS_NONE,
+			NULL,
+			vanished,
+			handle,
+			NULL);
+}
+
+void peripheral_gdbus_watch_client(peripheral_h handle, GDBusMethodInvocation *invocation, GBusNameVanishedCallback vanished)
+{
+	const char *sender = g_dbus_method_invocation_get_sender(invocation);
+
+	if (sender != NULL) {
+		__gdbus_watch_owner(handle, sender, vanished);
+		peripheral_handle_state_save();
+		return;
+	}
+
+	/* A peer has no bus name, it is gone when its connection closes */
+	handle->peer = g_object_ref(g_dbus_method_invocation_get_connection(invocation));
+	handle->vanished = vanished;
+	handle->peer_closed_id = g_signal_connect(handle->peer, "closed", G_CALLBACK(__gdbus_client_closed), handle);
+	peripheral_handle_state_save();
+}
+
+void peripheral_gdbus_unwatch_client(peripheral_h handle)
+{
+	if (handle->peer == NULL) {
+		if (handle->watch_id)
+			g_bus_unwatch_name(handle->watch_id);
+		handle->watch_id = 0;
+		free(handle->owner);
+		handle->owner = NULL;
+		return;
+	}
+
+	g_signal_handler_disconnect(handle->peer, handle->peer_closed_id);
+	g_object_unref(handle->peer);
+	handle->peer = NULL;
+}
+
+int peripheral_gdbus_check_client(peripheral_h handle, GDBusMethodInvocation *invocation)
+{
+	const char *sender = g_dbus_method_invocation_get_sender(invocation);
+
+	if (handle->peer != NULL) {
+		if (handle->peer == g_dbus_method_invocation_get_connection(invocation))
+			return PERIPHERAL_ERROR_NONE;
+	} else if (sender != NULL && handle->owner != NULL && strcmp(sender, handle->owner) == 0) {
+		return PERIPHERAL_ERROR_NONE;
+	}
+
+	_E("Handle %u does not belong to %s", handle->id, sender ? sender : "this peer");
+	return PERIPHERAL_ERROR_PERMISSION_DENIED;
+}
+
+void peripheral_gdbus_restore_client(peripheral_h handle, const pb_handle_state_s *state, GBusNameVanishedCallback vanished)
+{
+	if (peripheral_handle_set_id(handle, state->id) != 0) {
+		vanished(NULL, "unknown", handle);
+		return;
+	}
+
+	/* Peer connections do not survive a restart, their handles go with them */
+	if (state->owner == NULL) {
+		vanished(NULL, "peer", handle);
+		return;
+	}
+
+	/* Owners that went away meanwhile are reported vanished right away */
+	__gdbus_watch_owner(handle, state->owner, vanished);
+}
+
+static const peripheral_gdbus_restore_cb __restores[PB_HANDLE_STATE_MAX] = {
+	[PB_HANDLE_STATE_GPIO] = peripheral_gdbus_gpio_restore,
+	[PB_HANDLE_STATE_I2C] = peripheral_gdbus_i2c_restore,
+	[PB_HANDLE_STATE_I2C_POLL] = peripheral_gdbus_i2c_poll_restore,
+	[PB_HANDLE_STATE_PWM] = peripheral_gdbus_pwm_restore,
+	[PB_HANDLE_STATE_ADC] = peripheral_gdbus_adc_restore,
+	[PB_HANDLE_STATE_UART] = peripheral_gdbus_uart_restore,
+	[PB_HANDLE_STATE_SPI] = peripheral_gdbus_spi_restore,
+};
+
+static void __gdbus_restore_handle(const pb_handle_state_s *state, void *user_data)
+{
+	_D("Restoring handle %u of %s", state->id, state->owner ? state->owner : "a peer");
+
+	__restores[state->type](state, user_data);
+}
+
+int peripheral_gdbus_restore(peripheral_info_s *info)
+{
+	RETVM_IF(info == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid info");
+
+	return peripheral_handle_state_load(__gdbus_restore_handle, info);
+}
@@ -19,8 +19,10 @@
 
 #include "peripheral_log.h"
 #include "peripheral_privilege.h"
-#include "peripheral_io_gdbus.h"
+#include "peripheral_stats.h"
+#include "peripheral_gdbus.h"
 #include "peripheral_handle.h"
+#include "peripheral_handle_common.h"
 #include "peripheral_handle_adc.h"
 #include "peripheral_interface_adc.h"
 #include "peripheral_gdbus_adc.h"
@@ -34,28 +36,31 @@ static void __adc_on_name_vanished(GDBusConnection *connection,
 	peripheral_h adc_handle = (peripheral_h)user_data;
 	_D("appid [%s] vanished ", name);
 
-	g_bus_unwatch_name(adc_handle->watch_id);
+	peripheral_gdbus_unwatch_client(adc_handle);
+	peripheral_bus_stats_vanished(PB_BOARD_DEV_ADC);
 
 	ret = peripheral_handle_adc_destroy(adc_handle);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy adc handle");
 }
 
-gboolean peripheral_gdbus_adc_open(
-		PeripheralIoGdbusAdc *adc,
+int peripheral_gdbus_adc_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint device,
-		gint channel,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	gint device;
+	gint channel;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
 
-	peripheral_info_s *info = (peripheral_info_s*)user_data;
 	peripheral_h adc_handle = NULL;
 	GUnixFDList *adc_fd_list = NULL;
 
-	ret = peripheral_privilege_check(invocation, info->connection);
+	g_variant_get(parameters, "(ii)", &device, &channel);
+
+	ret = peripheral_privilege_check(invocation);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_ADC, PB_STATS_PHASE_PRIVILEGE, now);
 	if (ret != 0) {
 		_E("Permission denied.");
 		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
@@ -63,49 +68,78 @@ gboolean peripheral_gdbus_adc_open(
 	}
 
 	ret = peripheral_interface_adc_fd_list_create(device, channel, &adc_fd_list);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_ADC, PB_STATS_PHASE_FD_OPEN, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create adc fd list");
 		goto out;
 	}
 
 	ret = peripheral_handle_adc_create(device, channel, &adc_handle, user_data);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_ADC, PB_STATS_PHASE_HANDLE_CREATE, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create adc handle");
 		goto out;
 	}
 
-	adc_handle->watch_id = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-			g_dbus_method_invocation_get_sender(invocation),
-			G_BUS_NAME_WATCHER_FLAGS_NONE,
-			NULL,
-			__adc_on_name_vanished,
-			adc_handle,
-			NULL);
+	peripheral_gdbus_watch_client(adc_handle, invocation, __adc_on_name_vanished);
 
 out:
-	peripheral_io_gdbus_adc_complete_open(adc, invocation, adc_fd_list, GPOINTER_TO_UINT(adc_handle), ret);
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", adc_handle ? adc_handle->id : 0, ret), adc_fd_list);
 	peripheral_interface_adc_fd_list_destroy(adc_fd_list);
 
-	return true;
+	return ret;
 }
 
-gboolean peripheral_gdbus_adc_close(
-		PeripheralIoGdbusAdc *adc,
+int peripheral_gdbus_adc_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	guint handle;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h adc_handle;
 
-	peripheral_h adc_handle = GUINT_TO_POINTER(handle);
+	g_variant_get(parameters, "(u)", &handle);
 
-	g_bus_unwatch_name(adc_handle->watch_id);
+	adc_handle = peripheral_handle_find(&info->adc_list, handle);
+	if (adc_handle == NULL) {
+		_E("Invalid handle : %u", handle);
+		ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		goto out;
+	}
+
+	ret = peripheral_gdbus_check_client(adc_handle, invocation);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		goto out;
+
+	peripheral_gdbus_unwatch_client(adc_handle);
 
 	ret = peripheral_handle_adc_destroy(adc_handle);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_ADC, PB_STATS_PHASE_HANDLE_DESTROY, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy adc handle");
 
-	peripheral_io_gdbus_adc_complete_close(adc, invocation, ret);
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", ret));
+
+	return ret;
+}
+
+void peripheral_gdbus_adc_restore(const pb_handle_state_s *state, gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h adc_handle = NULL;
+
+	ret = peripheral_handle_adc_create(state->args[0], state->args[1], &adc_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to restore adc device : %d, channel : %d", state->args[0], state->args[1]);
+		return;
+	}
 
-	return true;
+	peripheral_gdbus_restore_client(adc_handle, state, __adc_on_name_vanished);
 }
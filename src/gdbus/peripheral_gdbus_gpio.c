@@ -19,8 +19,10 @@
 
 #include "peripheral_log.h"
 #include "peripheral_privilege.h"
-#include "peripheral_io_gdbus.h"
+#include "peripheral_stats.h"
+#include "peripheral_gdbus.h"
 #include "peripheral_handle.h"
+#include "peripheral_handle_common.h"
 #include "peripheral_handle_gpio.h"
 #include "peripheral_interface_gpio.h"
 #include "peripheral_gdbus_gpio.h"
@@ -34,7 +36,8 @@ static void __gpio_on_name_vanished(GDBusConnection *connection,
 	peripheral_h gpio_handle = (peripheral_h)user_data;
 	_D("appid [%s] vanished ", name);
 
-	g_bus_unwatch_name(gpio_handle->watch_id);
+	peripheral_gdbus_unwatch_client(gpio_handle);
+	peripheral_bus_stats_vanished(PB_BOARD_DEV_GPIO);
 
 	ret = peripheral_interface_gpio_unexport(gpio_handle->type.gpio.pin);
 	if (ret != PERIPHERAL_ERROR_NONE)
@@ -45,20 +48,22 @@ static void __gpio_on_name_vanished(GDBusConnection *connection,
 		_E("Failed to destroy gpio handle");
 }
 
-gboolean peripheral_gdbus_gpio_open(
-		PeripheralIoGdbusGpio *gpio,
+int peripheral_gdbus_gpio_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint pin,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	gint pin;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
 
-	peripheral_info_s *info = (peripheral_info_s*)user_data;
 	peripheral_h gpio_handle = NULL;
 	GUnixFDList *gpio_fd_list = NULL;
 
-	ret = peripheral_privilege_check(invocation, info->connection);
+	g_variant_get(parameters, "(i)", &pin);
+
+	ret = peripheral_privilege_check(invocation);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_GPIO, PB_STATS_PHASE_PRIVILEGE, now);
 	if (ret != 0) {
 		_E("Permission denied.");
 		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
@@ -66,12 +71,14 @@ gboolean peripheral_gdbus_gpio_open(
 	}
 
 	ret = peripheral_handle_gpio_create(pin, &gpio_handle, user_data);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_GPIO, PB_STATS_PHASE_HANDLE_CREATE, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create gpio handle");
 		goto out;
 	}
 
 	ret = peripheral_interface_gpio_export(pin);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_GPIO, PB_STATS_PHASE_EXPORT, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to export gpio");
 		peripheral_handle_gpio_destroy(gpio_handle);
@@ -80,6 +87,7 @@ gboolean peripheral_gdbus_gpio_open(
 	}
 
 	ret = peripheral_interface_gpio_fd_list_create(pin, &gpio_fd_list);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_GPIO, PB_STATS_PHASE_FD_OPEN, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create gpio fd list");
 		peripheral_interface_gpio_unexport(pin);
@@ -88,42 +96,72 @@ gboolean peripheral_gdbus_gpio_open(
 		goto out;
 	}
 
-	gpio_handle->watch_id = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-			g_dbus_method_invocation_get_sender(invocation),
-			G_BUS_NAME_WATCHER_FLAGS_NONE,
-			NULL,
-			__gpio_on_name_vanished,
-			gpio_handle,
-			NULL);
+	peripheral_gdbus_watch_client(gpio_handle, invocation, __gpio_on_name_vanished);
 
 out:
-	peripheral_io_gdbus_gpio_complete_open(gpio, invocation, gpio_fd_list, GPOINTER_TO_UINT(gpio_handle), ret);
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", gpio_handle ? gpio_handle->id : 0, ret), gpio_fd_list);
 	peripheral_interface_gpio_fd_list_destroy(gpio_fd_list);
 
-	return true;
+	return ret;
 }
 
-gboolean peripheral_gdbus_gpio_close(
-		PeripheralIoGdbusGpio *gpio,
+int peripheral_gdbus_gpio_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	guint handle;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h gpio_handle;
 
-	peripheral_h gpio_handle = GUINT_TO_POINTER(handle);
+	g_variant_get(parameters, "(u)", &handle);
 
-	g_bus_unwatch_name(gpio_handle->watch_id);
+	gpio_handle = peripheral_handle_find(&info->gpio_list, handle);
+	if (gpio_handle == NULL) {
+		_E("Invalid handle : %u", handle);
+		ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		goto out;
+	}
+
+	ret = peripheral_gdbus_check_client(gpio_handle, invocation);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		goto out;
+
+	peripheral_gdbus_unwatch_client(gpio_handle);
 
 	ret = peripheral_interface_gpio_unexport(gpio_handle->type.gpio.pin);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_GPIO, PB_STATS_PHASE_UNEXPORT, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to gpio unexport");
 
 	ret = peripheral_handle_gpio_destroy(gpio_handle);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_GPIO, PB_STATS_PHASE_HANDLE_DESTROY, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy gpio handle");
 
-	peripheral_io_gdbus_gpio_complete_close(gpio, invocation, ret);
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", ret));
+
+	return ret;
+}
+
+void peripheral_gdbus_gpio_restore(const pb_handle_state_s *state, gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h gpio_handle = NULL;
+
+	/* The pin is still exported, only its bookkeeping is lost */
+	ret = peripheral_handle_gpio_create(state->args[0], &gpio_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to restore gpio %d", state->args[0]);
+		peripheral_interface_gpio_unexport(state->args[0]);
+		return;
+	}
 
-	return true;
+	peripheral_gdbus_restore_client(gpio_handle, state, __gpio_on_name_vanished);
 }
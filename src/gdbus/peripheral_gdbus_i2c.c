@@ -19,9 +19,12 @@
 
 #include "peripheral_log.h"
 #include "peripheral_privilege.h"
-#include "peripheral_io_gdbus.h"
+#include "peripheral_stats.h"
+#include "peripheral_gdbus.h"
 #include "peripheral_handle.h"
+#include "peripheral_handle_common.h"
 #include "peripheral_handle_i2c.h"
+#include "peripheral_handle_i2c_poll.h"
 #include "peripheral_interface_i2c.h"
 #include "peripheral_gdbus_i2c.h"
 
@@ -34,28 +37,31 @@ static void __i2c_on_name_vanished(GDBusConnection *connection,
 	peripheral_h i2c_handle = (peripheral_h)user_data;
 	_D("appid [%s] vanished ", name);
 
-	g_bus_unwatch_name(i2c_handle->watch_id);
+	peripheral_gdbus_unwatch_client(i2c_handle);
+	peripheral_bus_stats_vanished(PB_BOARD_DEV_I2C);
 
 	ret = peripheral_handle_i2c_destroy(i2c_handle);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy i2c handle");
 }
 
-gboolean peripheral_gdbus_i2c_open(
-		PeripheralIoGdbusI2c *i2c,
+int peripheral_gdbus_i2c_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint bus,
-		gint address,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	gint bus;
+	gint address;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
 
-	peripheral_info_s *info = (peripheral_info_s*)user_data;
 	peripheral_h i2c_handle = NULL;
 	GUnixFDList *i2c_fd_list = NULL;
 
-	ret = peripheral_privilege_check(invocation, info->connection);
+	g_variant_get(parameters, "(ii)", &bus, &address);
+
+	ret = peripheral_privilege_check(invocation);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_I2C, PB_STATS_PHASE_PRIVILEGE, now);
 	if (ret != 0) {
 		_E("Permission denied.");
 		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
@@ -63,49 +69,224 @@ gboolean peripheral_gdbus_i2c_open(
 	}
 
 	ret = peripheral_interface_i2c_fd_list_create(bus, address, &i2c_fd_list);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_I2C, PB_STATS_PHASE_FD_OPEN, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create i2c fd list");
 		goto out;
 	}
 
 	ret = peripheral_handle_i2c_create(bus, address, &i2c_handle, user_data);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_I2C, PB_STATS_PHASE_HANDLE_CREATE, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create i2c handle");
 		goto out;
 	}
 
-	i2c_handle->watch_id = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-			g_dbus_method_invocation_get_sender(invocation),
-			G_BUS_NAME_WATCHER_FLAGS_NONE,
-			NULL,
-			__i2c_on_name_vanished,
-			i2c_handle,
-			NULL);
+	peripheral_gdbus_watch_client(i2c_handle, invocation, __i2c_on_name_vanished);
 
 out:
-	peripheral_io_gdbus_i2c_complete_open(i2c, invocation, i2c_fd_list, GPOINTER_TO_UINT(i2c_handle), ret);
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", i2c_handle ? i2c_handle->id : 0, ret), i2c_fd_list);
 	peripheral_interface_i2c_fd_list_destroy(i2c_fd_list);
 
-	return true;
+	return ret;
 }
 
-gboolean peripheral_gdbus_i2c_close(
-		PeripheralIoGdbusI2c *i2c,
+int peripheral_gdbus_i2c_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	guint handle;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h i2c_handle;
+
+	g_variant_get(parameters, "(u)", &handle);
+
+	i2c_handle = peripheral_handle_find(&info->i2c_list, handle);
+	if (i2c_handle == NULL) {
+		_E("Invalid handle : %u", handle);
+		ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		goto out;
+	}
 
-	peripheral_h i2c_handle = GUINT_TO_POINTER(handle);
+	ret = peripheral_gdbus_check_client(i2c_handle, invocation);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		goto out;
 
-	g_bus_unwatch_name(i2c_handle->watch_id);
+	peripheral_gdbus_unwatch_client(i2c_handle);
 
 	ret = peripheral_handle_i2c_destroy(i2c_handle);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_I2C, PB_STATS_PHASE_HANDLE_DESTROY, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy i2c handle");
 
-	peripheral_io_gdbus_i2c_complete_close(i2c, invocation, ret);
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", ret));
+
+	return ret;
+}
+
+static void __i2c_poll_on_name_vanished(GDBusConnection *connection,
+		const gchar *name,
+		gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h poll_handle = (peripheral_h)user_data;
+	_D("appid [%s] vanished ", name);
+
+	peripheral_gdbus_unwatch_client(poll_handle);
+
+	ret = peripheral_handle_i2c_poll_destroy(poll_handle);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		_E("Failed to destroy i2c poll handle");
+}
+
+int peripheral_gdbus_i2c_poll_start(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	gint bus;
+	gint address;
+	gint reg;
+	gint length;
+	guint interval;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h poll_handle = NULL;
+	GUnixFDList *poll_fd_list = NULL;
+
+	g_variant_get(parameters, "(iiiiu)", &bus, &address, &reg, &length, &interval);
+
+	ret = peripheral_privilege_check(invocation);
+	if (ret != 0) {
+		_E("Permission denied.");
+		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
+		goto out;
+	}
+
+	ret = peripheral_handle_i2c_poll_create(bus, address, reg, length, interval, &poll_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to create i2c poll handle");
+		goto out;
+	}
+
+	ret = peripheral_handle_i2c_poll_fd_list_create(poll_handle, &poll_fd_list);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to create i2c poll fd list");
+		peripheral_handle_i2c_poll_destroy(poll_handle);
+		poll_handle = NULL;
+		goto out;
+	}
+
+	peripheral_gdbus_watch_client(poll_handle, invocation, __i2c_poll_on_name_vanished);
+
+out:
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", poll_handle ? poll_handle->id : 0, ret), poll_fd_list);
+	peripheral_handle_i2c_poll_fd_list_destroy(poll_fd_list);
+
+	return ret;
+}
+
+int peripheral_gdbus_i2c_poll_stop(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	guint handle;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h poll_handle;
+
+	g_variant_get(parameters, "(u)", &handle);
+
+	poll_handle = peripheral_handle_find(&info->i2c_poll_list, handle);
+	if (poll_handle == NULL) {
+		_E("Invalid handle : %u", handle);
+		ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		goto out;
+	}
+
+	ret = peripheral_gdbus_check_client(poll_handle, invocation);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		goto out;
+
+	peripheral_gdbus_unwatch_client(poll_handle);
+
+	ret = peripheral_handle_i2c_poll_destroy(poll_handle);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		_E("Failed to destroy i2c poll handle");
+
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", ret));
+
+	return ret;
+}
+
+int peripheral_gdbus_i2c_scan(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	gint bus;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	uint64_t bitmap[2] = {0, };
+
+	g_variant_get(parameters, "(i)", &bus);
+
+	ret = peripheral_privilege_check(invocation);
+	if (ret != 0) {
+		_E("Permission denied.");
+		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
+		goto out;
+	}
+
+	ret = peripheral_handle_i2c_scan(bus, bitmap, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		_E("Failed to scan i2c bus");
+
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(tti)", bitmap[0], bitmap[1], ret));
+
+	return ret;
+}
+
+void peripheral_gdbus_i2c_restore(const pb_handle_state_s *state, gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h i2c_handle = NULL;
 
-	return true;
-}
\ No newline at end of file
+	ret = peripheral_handle_i2c_create(state->args[0], state->args[1], &i2c_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to restore i2c bus : %d, address : 0x%x", state->args[0], state->args[1]);
+		return;
+	}
+
+	peripheral_gdbus_restore_client(i2c_handle, state, __i2c_on_name_vanished);
+}
+
+void peripheral_gdbus_i2c_poll_restore(const pb_handle_state_s *state, gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h poll_handle = NULL;
+
+	/* The poller picks its ring up from the fd store, readers keep their mapping */
+	ret = peripheral_handle_i2c_poll_create(state->args[0], state->args[1], state->args[2],
+			state->args[3], (unsigned int)state->args[4], &poll_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to restore i2c poll bus : %d, address : 0x%x", state->args[0], state->args[1]);
+		return;
+	}
+
+	peripheral_gdbus_restore_client(poll_handle, state, __i2c_poll_on_name_vanished);
+}
@@ -19,8 +19,10 @@
 
 #include "peripheral_log.h"
 #include "peripheral_privilege.h"
-#include "peripheral_io_gdbus.h"
+#include "peripheral_stats.h"
+#include "peripheral_gdbus.h"
 #include "peripheral_handle.h"
+#include "peripheral_handle_common.h"
 #include "peripheral_handle_pwm.h"
 #include "peripheral_interface_pwm.h"
 #include "peripheral_gdbus_pwm.h"
@@ -34,7 +36,8 @@ static void __pwm_on_name_vanished(GDBusConnection *connection,
 	peripheral_h pwm_handle = (peripheral_h)user_data;
 	_D("appid [%s] vanished ", name);
 
-	g_bus_unwatch_name(pwm_handle->watch_id);
+	peripheral_gdbus_unwatch_client(pwm_handle);
+	peripheral_bus_stats_vanished(PB_BOARD_DEV_PWM);
 
 	ret = peripheral_interface_pwm_unexport(pwm_handle->type.pwm.chip, pwm_handle->type.pwm.pin);
 	if (ret != PERIPHERAL_ERROR_NONE)
@@ -45,21 +48,23 @@ static void __pwm_on_name_vanished(GDBusConnection *connection,
 		_E("Failed to destroy pwm handle");
 }
 
-gboolean peripheral_gdbus_pwm_open(
-		PeripheralIoGdbusPwm *pwm,
+int peripheral_gdbus_pwm_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
-		gint chip,
-		gint pin,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	gint chip;
+	gint pin;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
 
-	peripheral_info_s *info = (peripheral_info_s*)user_data;
 	peripheral_h pwm_handle = NULL;
 	GUnixFDList *pwm_fd_list = NULL;
 
-	ret = peripheral_privilege_check(invocation, info->connection);
+	g_variant_get(parameters, "(ii)", &chip, &pin);
+
+	ret = peripheral_privilege_check(invocation);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_PWM, PB_STATS_PHASE_PRIVILEGE, now);
 	if (ret != 0) {
 		_E("Permission denied.");
 		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
@@ -67,12 +72,14 @@ gboolean peripheral_gdbus_pwm_open(
 	}
 
 	ret = peripheral_interface_pwm_export(chip, pin);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_PWM, PB_STATS_PHASE_EXPORT, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to export pwm");
 		goto out;
 	}
 
 	ret = peripheral_interface_pwm_fd_list_create(chip, pin, &pwm_fd_list);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_PWM, PB_STATS_PHASE_FD_OPEN, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create pwm fd list");
 		peripheral_interface_pwm_unexport(chip, pin);
@@ -80,48 +87,79 @@ gboolean peripheral_gdbus_pwm_open(
 	}
 
 	ret = peripheral_handle_pwm_create(chip, pin, &pwm_handle, user_data);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_PWM, PB_STATS_PHASE_HANDLE_CREATE, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create pwm handle");
 		peripheral_interface_pwm_unexport(chip, pin);
 		goto out;
 	}
 
-	pwm_handle->watch_id = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-			g_dbus_method_invocation_get_sender(invocation),
-			G_BUS_NAME_WATCHER_FLAGS_NONE,
-			NULL,
-			__pwm_on_name_vanished,
-			pwm_handle,
-			NULL);
+	peripheral_gdbus_watch_client(pwm_handle, invocation, __pwm_on_name_vanished);
 
 out:
-	peripheral_io_gdbus_pwm_complete_open(pwm, invocation, pwm_fd_list, GPOINTER_TO_UINT(pwm_handle), ret);
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", pwm_handle ? pwm_handle->id : 0, ret), pwm_fd_list);
 	peripheral_interface_pwm_fd_list_destroy(pwm_fd_list);
 
-	return true;
+	return ret;
 }
 
-gboolean peripheral_gdbus_pwm_close(
-		PeripheralIoGdbusPwm *pwm,
+int peripheral_gdbus_pwm_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	guint handle;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h pwm_handle;
 
-	peripheral_h pwm_handle = GUINT_TO_POINTER(handle);
+	g_variant_get(parameters, "(u)", &handle);
 
-	g_bus_unwatch_name(pwm_handle->watch_id);
+	pwm_handle = peripheral_handle_find(&info->pwm_list, handle);
+	if (pwm_handle == NULL) {
+		_E("Invalid handle : %u", handle);
+		ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		goto out;
+	}
+
+	ret = peripheral_gdbus_check_client(pwm_handle, invocation);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		goto out;
+
+	peripheral_gdbus_unwatch_client(pwm_handle);
 
 	ret = peripheral_interface_pwm_unexport(pwm_handle->type.pwm.chip, pwm_handle->type.pwm.pin);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_PWM, PB_STATS_PHASE_UNEXPORT, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to unexport pwm");
 
 	ret = peripheral_handle_pwm_destroy(pwm_handle);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_PWM, PB_STATS_PHASE_HANDLE_DESTROY, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy pwm handle");
 
-	peripheral_io_gdbus_pwm_complete_close(pwm, invocation, ret);
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", ret));
+
+	return ret;
+}
+
+void peripheral_gdbus_pwm_restore(const pb_handle_state_s *state, gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
 
-	return true;
-}
\ No newline at end of file
+	peripheral_h pwm_handle = NULL;
+
+	/* The channel is still exported, only its bookkeeping is lost */
+	ret = peripheral_handle_pwm_create(state->args[0], state->args[1], &pwm_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to restore pwm chip : %d, pin : %d", state->args[0], state->args[1]);
+		peripheral_interface_pwm_unexport(state->args[0], state->args[1]);
+		return;
+	}
+
+	peripheral_gdbus_restore_client(pwm_handle, state, __pwm_on_name_vanished);
+}
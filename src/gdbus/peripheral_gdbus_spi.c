@@ -19,9 +19,12 @@
 
 #include "peripheral_log.h"
 #include "peripheral_privilege.h"
-#include "peripheral_io_gdbus.h"
+#include "peripheral_stats.h"
+#include "peripheral_gdbus.h"
 #include "peripheral_handle.h"
+#include "peripheral_handle_common.h"
 #include "peripheral_handle_spi.h"
+#include "peripheral_handle_spi_queue.h"
 #include "peripheral_interface_spi.h"
 #include "peripheral_gdbus_spi.h"
 
@@ -34,78 +37,273 @@ static void __spi_on_name_vanished(GDBusConnection *connection,
 	peripheral_h spi_handle = (peripheral_h)user_data;
 	_D("appid [%s] vanished ", name);
 
-	g_bus_unwatch_name(spi_handle->watch_id);
+	peripheral_gdbus_unwatch_client(spi_handle);
+	peripheral_bus_stats_vanished(PB_BOARD_DEV_SPI);
 
 	ret = peripheral_handle_spi_destroy(spi_handle);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy spi handle");
 }
 
-gboolean peripheral_gdbus_spi_open(
-		PeripheralIoGdbusSpi *spi,
+static void __spi_config_get(
+		peripheral_info_s *info,
+		gint bus,
+		gint cs,
+		guint mode,
+		guint max_speed_hz,
+		guint bits_per_word,
+		peripheral_interface_spi_config_s *config)
+{
+	const pb_board_dev_s *spi;
+
+	memset(config, 0, sizeof(peripheral_interface_spi_config_s));
+
+	/* Board defaults first, then whatever the client asked for explicitly */
+	spi = peripheral_bus_board_find_spi(info->board, bus, cs);
+	if (spi) {
+		if (spi->config.spi.set & PB_BOARD_SPI_MODE) {
+			config->mode = spi->config.spi.mode;
+			config->set |= SPI_CONFIG_MODE;
+		}
+		if (spi->config.spi.set & PB_BOARD_SPI_MAX_SPEED_HZ) {
+			config->max_speed_hz = spi->config.spi.max_speed_hz;
+			config->set |= SPI_CONFIG_MAX_SPEED_HZ;
+		}
+		if (spi->config.spi.set & PB_BOARD_SPI_BITS_PER_WORD) {
+			config->bits_per_word = spi->config.spi.bits_per_word;
+			config->set |= SPI_CONFIG_BITS_PER_WORD;
+		}
+	}
+
+	if (mode != SPI_CONFIG_DEFAULT) {
+		config->mode = mode;
+		config->set |= SPI_CONFIG_MODE;
+	}
+
+	if (max_speed_hz != SPI_CONFIG_DEFAULT) {
+		config->max_speed_hz = max_speed_hz;
+		config->set |= SPI_CONFIG_MAX_SPEED_HZ;
+	}
+
+	if (bits_per_word != SPI_CONFIG_DEFAULT) {
+		config->bits_per_word = bits_per_word;
+		config->set |= SPI_CONFIG_BITS_PER_WORD;
+	}
+}
+
+static int __spi_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
 		gint bus,
 		gint cs,
+		guint mode,
+		guint max_speed_hz,
+		guint bits_per_word,
+		peripheral_h *handle_out,
+		GUnixFDList **list_out,
 		gpointer user_data)
 {
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
 
 	peripheral_info_s *info = (peripheral_info_s*)user_data;
 	peripheral_h spi_handle = NULL;
-	GUnixFDList *spi_fd_list = NULL;
+	peripheral_interface_spi_config_s config;
 
-	ret = peripheral_privilege_check(invocation, info->connection);
+	ret = peripheral_privilege_check(invocation);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_SPI, PB_STATS_PHASE_PRIVILEGE, now);
 	if (ret != 0) {
 		_E("Permission denied.");
-		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
-		goto out;
+		return PERIPHERAL_ERROR_PERMISSION_DENIED;
+	}
+
+	/* Claim the device first, it must not be reconfigured under its owner */
+	ret = peripheral_handle_spi_create(bus, cs, &spi_handle, user_data);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_SPI, PB_STATS_PHASE_HANDLE_CREATE, now);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to create peripheral spi handle");
+		return ret;
 	}
 
-	ret = peripheral_interface_spi_fd_list_create(bus, cs, &spi_fd_list);
+	__spi_config_get(info, bus, cs, mode, max_speed_hz, bits_per_word, &config);
+
+	ret = peripheral_interface_spi_fd_list_create(bus, cs, &config, list_out);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_SPI, PB_STATS_PHASE_FD_OPEN, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create spi fd list");
+		peripheral_handle_spi_destroy(spi_handle);
+		return ret;
+	}
+
+	peripheral_gdbus_watch_client(spi_handle, invocation, __spi_on_name_vanished);
+
+	*handle_out = spi_handle;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_spi_open(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	gint bus;
+	gint cs;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h spi_handle = NULL;
+	GUnixFDList *spi_fd_list = NULL;
+
+	g_variant_get(parameters, "(ii)", &bus, &cs);
+
+	ret = __spi_open(invocation, bus, cs, SPI_CONFIG_DEFAULT, SPI_CONFIG_DEFAULT, SPI_CONFIG_DEFAULT,
+			&spi_handle, &spi_fd_list, user_data);
+
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", spi_handle ? spi_handle->id : 0, ret), spi_fd_list);
+	peripheral_interface_spi_fd_list_destroy(spi_fd_list);
+
+	return ret;
+}
+
+int peripheral_gdbus_spi_open_with_config(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	gint bus;
+	gint cs;
+	guint mode;
+	guint max_speed_hz;
+	guint bits_per_word;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h spi_handle = NULL;
+	GUnixFDList *spi_fd_list = NULL;
+
+	g_variant_get(parameters, "(iiuuu)", &bus, &cs, &mode, &max_speed_hz, &bits_per_word);
+
+	ret = __spi_open(invocation, bus, cs, mode, max_speed_hz, bits_per_word,
+			&spi_handle, &spi_fd_list, user_data);
+
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", spi_handle ? spi_handle->id : 0, ret), spi_fd_list);
+	peripheral_interface_spi_fd_list_destroy(spi_fd_list);
+
+	return ret;
+}
+
+int peripheral_gdbus_spi_queue_attach(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	gint bus;
+	gint cs;
+	gint priority;
+	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h spi_handle = NULL;
+	GUnixFDList *spi_fd_list = NULL;
+	peripheral_interface_spi_config_s config;
+
+	g_variant_get(parameters, "(iii)", &bus, &cs, &priority);
+
+	ret = peripheral_privilege_check(invocation);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_SPI, PB_STATS_PHASE_PRIVILEGE, now);
+	if (ret != 0) {
+		_E("Permission denied.");
+		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
 		goto out;
 	}
 
 	ret = peripheral_handle_spi_create(bus, cs, &spi_handle, user_data);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_SPI, PB_STATS_PHASE_HANDLE_CREATE, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to create peripheral spi handle");
 		goto out;
 	}
 
-	spi_handle->watch_id = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-			g_dbus_method_invocation_get_sender(invocation),
-			G_BUS_NAME_WATCHER_FLAGS_NONE,
-			NULL,
-			__spi_on_name_vanished,
-			spi_handle,
-			NULL);
+	__spi_config_get(info, bus, cs, SPI_CONFIG_DEFAULT, SPI_CONFIG_DEFAULT, SPI_CONFIG_DEFAULT, &config);
+
+	ret = peripheral_handle_spi_queue_attach(spi_handle, priority, &config, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to attach spi %d.%d to the queue", bus, cs);
+		peripheral_handle_spi_destroy(spi_handle);
+		spi_handle = NULL;
+		goto out;
+	}
+
+	ret = peripheral_handle_spi_queue_fd_list_create(spi_handle, &spi_fd_list);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_SPI, PB_STATS_PHASE_FD_OPEN, now);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to create spi queue fd list");
+		peripheral_handle_spi_destroy(spi_handle);
+		spi_handle = NULL;
+		goto out;
+	}
+
+	peripheral_gdbus_watch_client(spi_handle, invocation, __spi_on_name_vanished);
 
 out:
-	peripheral_io_gdbus_spi_complete_open(spi, invocation, spi_fd_list, GPOINTER_TO_UINT(spi_handle), ret);
-	peripheral_interface_spi_fd_list_destroy(spi_fd_list);
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", spi_handle ? spi_handle->id : 0, ret), spi_fd_list);
+	peripheral_handle_spi_queue_fd_list_destroy(spi_fd_list);
 
-	return true;
+	return ret;
 }
 
-gboolean peripheral_gdbus_spi_close(
-		PeripheralIoGdbusSpi *spi,
+int peripheral_gdbus_spi_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	guint handle;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h spi_handle;
 
-	peripheral_h spi_handle = GUINT_TO_POINTER(handle);
+	g_variant_get(parameters, "(u)", &handle);
+
+	spi_handle = peripheral_handle_find(&info->spi_list, handle);
+	if (spi_handle == NULL) {
+		_E("Invalid handle : %u", handle);
+		ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		goto out;
+	}
+
+	ret = peripheral_gdbus_check_client(spi_handle, invocation);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		goto out;
 
-	g_bus_unwatch_name(spi_handle->watch_id);
+	peripheral_gdbus_unwatch_client(spi_handle);
 
 	ret = peripheral_handle_spi_destroy(spi_handle);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_SPI, PB_STATS_PHASE_HANDLE_DESTROY, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy spi handle");
 
-	peripheral_io_gdbus_spi_complete_close(spi, invocation, ret);
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", ret));
+
+	return ret;
+}
+
+void peripheral_gdbus_spi_restore(const pb_handle_state_s *state, gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
 
-	return true;
-}
\ No newline at end of file
+	peripheral_h spi_handle = NULL;
+
+	/* Transfer queues are not restored, their clients have to attach again */
+	ret = peripheral_handle_spi_create(state->args[0], state->args[1], &spi_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to restore spi bus : %d, cs : %d", state->args[0], state->args[1]);
+		return;
+	}
+
+	peripheral_gdbus_restore_client(spi_handle, state, __spi_on_name_vanished);
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_privilege.h"
+#include "peripheral_stats.h"
+#include "peripheral_recorder.h"
+#include "peripheral_timeline.h"
+#include "peripheral_handle.h"
+#include "peripheral_gdbus_stats.h"
+
+void peripheral_gdbus_stats_active(unsigned int active[PB_BOARD_DEV_MAX], gpointer user_data)
+{
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+
+	active[PB_BOARD_DEV_GPIO] = g_list_length(info->gpio_list);
+	active[PB_BOARD_DEV_I2C] = g_list_length(info->i2c_list);
+	active[PB_BOARD_DEV_PWM] = g_list_length(info->pwm_list);
+	active[PB_BOARD_DEV_ADC] = g_list_length(info->adc_list);
+	active[PB_BOARD_DEV_UART] = g_list_length(info->uart_list);
+	active[PB_BOARD_DEV_SPI] = g_list_length(info->spi_list);
+}
+
+/*
+ * The records name other clients, their devices and results. The bus
+ * policy keeps the interface to root and service_fw, peers on the private
+ * socket skip the policy, so the same users are checked here for both.
+ */
+static int __stats_privilege_check(GDBusMethodInvocation *invocation)
+{
+	if (peripheral_privilege_check_admin(invocation) != 0) {
+		_E("Permission denied.");
+		return PERIPHERAL_ERROR_PERMISSION_DENIED;
+	}
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_stats_get_counters(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	unsigned int active[PB_BOARD_DEV_MAX] = {0, };
+	int ret;
+
+	ret = __stats_privilege_check(invocation);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(a(sttta{st}a{st}u)i)", NULL, ret));
+		return ret;
+	}
+
+	peripheral_gdbus_stats_active(active, user_data);
+
+	g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(@a(sttta{st}a{st}u)i)", peripheral_bus_stats_counters(active), PERIPHERAL_ERROR_NONE));
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_stats_get_histograms(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	GVariant *histograms;
+	GVariant *bounds;
+	GVariant *list;
+	int ret;
+
+	ret = __stats_privilege_check(invocation);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(ata(ssttat)i)", NULL, NULL, ret));
+		return ret;
+	}
+
+	histograms = g_variant_ref_sink(peripheral_bus_stats_histograms());
+	g_variant_get(histograms, "(@at@a(ssttat))", &bounds, &list);
+	g_variant_unref(histograms);
+
+	g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(@at@a(ssttat)i)", bounds, list, PERIPHERAL_ERROR_NONE));
+
+	g_variant_unref(bounds);
+	g_variant_unref(list);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_stats_get_text(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	unsigned int active[PB_BOARD_DEV_MAX] = {0, };
+	gchar *text;
+	int ret;
+
+	ret = __stats_privilege_check(invocation);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(si)", "", ret));
+		return ret;
+	}
+
+	peripheral_gdbus_stats_active(active, user_data);
+	text = peripheral_bus_stats_text(active);
+
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(si)", text, PERIPHERAL_ERROR_NONE));
+
+	g_free(text);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_stats_get_timeline(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	const pb_timeline_stage_s *stages;
+	GVariantBuilder builder;
+	int num_stages;
+	int i;
+	int ret;
+
+	ret = __stats_privilege_check(invocation);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(a(stt)i)", NULL, ret));
+		return ret;
+	}
+
+	num_stages = peripheral_bus_timeline_get(&stages);
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(stt)"));
+	for (i = 0; i < num_stages; i++)
+		g_variant_builder_add(&builder, "(stt)", stages[i].name, (guint64)stages[i].start, (guint64)stages[i].duration);
+
+	g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(@a(stt)i)", g_variant_builder_end(&builder), PERIPHERAL_ERROR_NONE));
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_stats_get_records(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	GVariant *records;
+	GVariant *phases;
+	GVariant *list;
+	int ret;
+
+	ret = __stats_privilege_check(invocation);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(asa(tsssiiiau)i)", NULL, NULL, ret));
+		return ret;
+	}
+
+	records = g_variant_ref_sink(peripheral_bus_recorder_records());
+	g_variant_get(records, "(@as@a(tsssiiiau))", &phases, &list);
+	g_variant_unref(records);
+
+	g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(@as@a(tsssiiiau)i)", phases, list, PERIPHERAL_ERROR_NONE));
+
+	g_variant_unref(phases);
+	g_variant_unref(list);
+
+	return PERIPHERAL_ERROR_NONE;
+}
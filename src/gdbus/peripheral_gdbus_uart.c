@@ -19,8 +19,10 @@
 
 #include "peripheral_log.h"
 #include "peripheral_privilege.h"
-#include "peripheral_io_gdbus.h"
+#include "peripheral_stats.h"
+#include "peripheral_gdbus.h"
 #include "peripheral_handle.h"
+#include "peripheral_handle_common.h"
 #include "peripheral_handle_uart.h"
 #include "peripheral_interface_uart.h"
 #include "peripheral_gdbus_uart.h"
@@ -34,77 +36,173 @@ static void __uart_on_name_vanished(GDBusConnection *connection,
 	peripheral_h uart_handle = (peripheral_h)user_data;
 	_D("appid [%s] vanished ", name);
 
-	g_bus_unwatch_name(uart_handle->watch_id);
+	peripheral_gdbus_unwatch_client(uart_handle);
+	peripheral_bus_stats_vanished(PB_BOARD_DEV_UART);
 
 	ret = peripheral_handle_uart_destroy(uart_handle);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy uart handle");
 }
 
-gboolean peripheral_gdbus_uart_open(
-		PeripheralIoGdbusUart *uart,
+static int __uart_open(
 		GDBusMethodInvocation *invocation,
-		GUnixFDList *fd_list,
 		gint port,
+		const peripheral_interface_uart_config_s *config,
+		peripheral_h *handle_out,
+		GUnixFDList **list_out,
 		gpointer user_data)
 {
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
 
-	peripheral_info_s *info = (peripheral_info_s*)user_data;
 	peripheral_h uart_handle = NULL;
-	GUnixFDList *uart_fd_list = NULL;
 
-	ret = peripheral_privilege_check(invocation, info->connection);
+	ret = peripheral_privilege_check(invocation);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_UART, PB_STATS_PHASE_PRIVILEGE, now);
 	if (ret != 0) {
 		_E("Permission denied.");
-		ret = PERIPHERAL_ERROR_PERMISSION_DENIED;
-		goto out;
+		return PERIPHERAL_ERROR_PERMISSION_DENIED;
 	}
 
-	ret = peripheral_interface_uart_fd_list_create(port, &uart_fd_list);
+	/* Claim the port first, the tty must not be reconfigured under its owner */
+	ret = peripheral_handle_uart_create(port, &uart_handle, user_data);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_UART, PB_STATS_PHASE_HANDLE_CREATE, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
-		_E("Failed to create uart fd list");
-		goto out;
+		_E("Failed to create peripheral uart handle");
+		return ret;
 	}
 
-	ret = peripheral_handle_uart_create(port, &uart_handle, user_data);
+	ret = peripheral_interface_uart_fd_list_create(port, config, list_out);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_UART, PB_STATS_PHASE_FD_OPEN, now);
 	if (ret != PERIPHERAL_ERROR_NONE) {
-		_E("Failed to create peripheral uart handle");
-		goto out;
+		_E("Failed to create uart fd list");
+		peripheral_handle_uart_destroy(uart_handle);
+		return ret;
 	}
 
-	uart_handle->watch_id = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-			g_dbus_method_invocation_get_sender(invocation),
-			G_BUS_NAME_WATCHER_FLAGS_NONE,
-			NULL,
-			__uart_on_name_vanished,
-			uart_handle,
-			NULL);
+	peripheral_gdbus_watch_client(uart_handle, invocation, __uart_on_name_vanished);
 
-out:
-	peripheral_io_gdbus_uart_complete_open(uart, invocation, uart_fd_list, GPOINTER_TO_UINT(uart_handle), ret);
+	*handle_out = uart_handle;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_gdbus_uart_open(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	gint port;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h uart_handle = NULL;
+	GUnixFDList *uart_fd_list = NULL;
+
+	g_variant_get(parameters, "(i)", &port);
+
+	ret = __uart_open(invocation, port, NULL, &uart_handle, &uart_fd_list, user_data);
+
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", uart_handle ? uart_handle->id : 0, ret), uart_fd_list);
+	peripheral_interface_uart_fd_list_destroy(uart_fd_list);
+
+	return ret;
+}
+
+int peripheral_gdbus_uart_open_with_config(
+		GDBusMethodInvocation *invocation,
+		GVariant *parameters,
+		gpointer user_data)
+{
+	gint port;
+	guint baud_rate;
+	gint byte_size;
+	gint parity;
+	gint stop_bits;
+	gboolean sw_flow_control;
+	gboolean hw_flow_control;
+	gint vmin;
+	gint vtime;
+	gboolean low_latency;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h uart_handle = NULL;
+	GUnixFDList *uart_fd_list = NULL;
+	peripheral_interface_uart_config_s config;
+
+	g_variant_get(parameters, "(iuiiibbiib)", &port, &baud_rate, &byte_size, &parity, &stop_bits,
+			&sw_flow_control, &hw_flow_control, &vmin, &vtime, &low_latency);
+
+	config = (peripheral_interface_uart_config_s) {
+		.baud_rate = baud_rate,
+		.byte_size = byte_size,
+		.parity = parity,
+		.stop_bits = stop_bits,
+		.sw_flow_control = sw_flow_control,
+		.hw_flow_control = hw_flow_control,
+		.vmin = vmin,
+		.vtime = vtime,
+		.low_latency = low_latency,
+	};
+
+	ret = __uart_open(invocation, port, &config, &uart_handle, &uart_fd_list, user_data);
+
+	g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+			g_variant_new("(ui)", uart_handle ? uart_handle->id : 0, ret), uart_fd_list);
 	peripheral_interface_uart_fd_list_destroy(uart_fd_list);
 
-	return true;
+	return ret;
 }
 
-gboolean peripheral_gdbus_uart_close(
-		PeripheralIoGdbusUart *uart,
+int peripheral_gdbus_uart_close(
 		GDBusMethodInvocation *invocation,
-		gint handle,
+		GVariant *parameters,
 		gpointer user_data)
 {
+	guint handle;
 	int ret = PERIPHERAL_ERROR_NONE;
+	uint64_t now = peripheral_bus_stats_now();
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_h uart_handle;
+
+	g_variant_get(parameters, "(u)", &handle);
+
+	uart_handle = peripheral_handle_find(&info->uart_list, handle);
+	if (uart_handle == NULL) {
+		_E("Invalid handle : %u", handle);
+		ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		goto out;
+	}
 
-	peripheral_h uart_handle = GUINT_TO_POINTER(handle);
+	ret = peripheral_gdbus_check_client(uart_handle, invocation);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		goto out;
 
-	g_bus_unwatch_name(uart_handle->watch_id);
+	peripheral_gdbus_unwatch_client(uart_handle);
 
 	ret = peripheral_handle_uart_destroy(uart_handle);
+	now = peripheral_bus_stats_phase(PB_BOARD_DEV_UART, PB_STATS_PHASE_HANDLE_DESTROY, now);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to destroy uart handle");
 
-	peripheral_io_gdbus_uart_complete_close(uart, invocation, ret);
+out:
+	g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", ret));
+
+	return ret;
+}
+
+void peripheral_gdbus_uart_restore(const pb_handle_state_s *state, gpointer user_data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	peripheral_h uart_handle = NULL;
 
-	return true;
-}
\ No newline at end of file
+	ret = peripheral_handle_uart_create(state->args[0], &uart_handle, user_data);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to restore uart port : %d", state->args[0]);
+		return;
+	}
+
+	peripheral_gdbus_restore_client(uart_handle, state, __uart_on_name_vanished);
+}
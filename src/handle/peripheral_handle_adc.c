@@ -18,14 +18,14 @@
 
 static bool __peripheral_handle_adc_is_creatable(int device, int channel, peripheral_info_s *info)
 {
-	pb_board_dev_s *adc = NULL;
+	const pb_board_dev_s *adc = NULL;
 	peripheral_h handle;
 	GList *link;
 
 	RETV_IF(info == NULL, false);
 	RETV_IF(info->board == NULL, false);
 
-	adc = peripheral_bus_board_find_device(PB_BOARD_DEV_ADC, info->board, device, channel);
+	adc = peripheral_bus_board_find_adc(info->board, device, channel);
 	if (adc == NULL) {
 		_E("Not supported ADC device : %d, channel : %d", device, channel);
 		return false;
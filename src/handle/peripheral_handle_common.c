@@ -17,20 +17,45 @@
 #include <stdlib.h>
 
 #include "peripheral_handle_common.h"
+#include "peripheral_handle_state.h"
+#include "peripheral_idle.h"
+
+/* Open handles by id, ids are never reused while a handle holds them */
+static GHashTable *__handles;
+static unsigned int __next_id = 1;
+
+static unsigned int __peripheral_handle_next_id(void)
+{
+	unsigned int id;
+
+	do {
+		id = __next_id++;
+	} while (id == 0 || g_hash_table_contains(__handles, GUINT_TO_POINTER(id)));
+
+	return id;
+}
 
 peripheral_h peripheral_handle_new(GList **plist)
 {
 	GList *list = *plist;
 	peripheral_h handle;
 
+	if (__handles == NULL)
+		__handles = g_hash_table_new(g_direct_hash, g_direct_equal);
+
 	handle = (peripheral_h)calloc(1, sizeof(peripheral_handle_s));
 	if (handle == NULL) {
 		_E("failed to allocate peripheral_handle_s");
 		return NULL;
 	}
 
+	handle->id = __peripheral_handle_next_id();
+	g_hash_table_insert(__handles, GUINT_TO_POINTER(handle->id), handle);
+
 	*plist = g_list_append(list, handle);
 
+	peripheral_bus_idle_hold();
+
 	return handle;
 }
 
@@ -48,9 +73,53 @@ int peripheral_handle_free(peripheral_h handle)
 	}
 
 	*handle->list = g_list_remove_link(list, link);
+	g_hash_table_remove(__handles, GUINT_TO_POINTER(handle->id));
 
+	free(handle->owner);
 	free(handle);
 	g_list_free(link);
 
+	peripheral_handle_state_save();
+
+	peripheral_bus_idle_release();
+
+	return 0;
+}
+
+peripheral_h peripheral_handle_find(GList **plist, unsigned int id)
+{
+	peripheral_h handle;
+
+	if (__handles == NULL)
+		return NULL;
+
+	handle = (peripheral_h)g_hash_table_lookup(__handles, GUINT_TO_POINTER(id));
+	if (handle == NULL || handle->list != plist)
+		return NULL;
+
+	return handle;
+}
+
+int peripheral_handle_set_id(peripheral_h handle, unsigned int id)
+{
+	RETVM_IF(handle == NULL, -1, "handle is null");
+	RETVM_IF(id == 0, -1, "Invalid handle id");
+
+	if (id == handle->id)
+		return 0;
+
+	if (g_hash_table_contains(__handles, GUINT_TO_POINTER(id))) {
+		_E("handle id %u is already in use", id);
+		return -1;
+	}
+
+	g_hash_table_remove(__handles, GUINT_TO_POINTER(handle->id));
+	handle->id = id;
+	g_hash_table_insert(__handles, GUINT_TO_POINTER(id), handle);
+
+	/* New handles must not be handed an id a restored one already has */
+	if (id >= __next_id)
+		__next_id = id + 1;
+
 	return 0;
 }
\ No newline at end of file
@@ -18,14 +18,14 @@
 
 static bool __peripheral_handle_gpio_is_creatable(int pin, peripheral_info_s *info)
 {
-	pb_board_dev_s *gpio = NULL;
+	const pb_board_dev_s *gpio = NULL;
 	peripheral_h handle;
 	GList *link;
 
 	RETV_IF(info == NULL, false);
 	RETV_IF(info->board == NULL, false);
 
-	gpio = peripheral_bus_board_find_device(PB_BOARD_DEV_GPIO, info->board, pin);
+	gpio = peripheral_bus_board_find_gpio(info->board, pin);
 	if (gpio == NULL) {
 		_E("Not supported GPIO pin : %d", pin);
 		return false;
@@ -15,17 +15,20 @@
  */
 
 #include "peripheral_handle_common.h"
+#include "peripheral_handle_i2c.h"
+#include "peripheral_interface_i2c.h"
+#include "peripheral_udev.h"
 
 static bool __peripheral_handle_i2c_is_creatable(int bus, int address, peripheral_info_s *info)
 {
-	pb_board_dev_s *i2c = NULL;
+	const pb_board_dev_s *i2c = NULL;
 	peripheral_h handle;
 	GList *link;
 
 	RETV_IF(info == NULL, false);
 	RETV_IF(info->board == NULL, false);
 
-	i2c = peripheral_bus_board_find_device(PB_BOARD_DEV_I2C, info->board, bus);
+	i2c = peripheral_bus_board_find_i2c(info->board, bus);
 	if (i2c == NULL) {
 		_E("Not supported I2C bus : %d", bus);
 		return false;
@@ -88,3 +91,74 @@ int peripheral_handle_i2c_create(int bus, int address, peripheral_h *handle, gpo
 
 	return PERIPHERAL_ERROR_NONE;
 }
+
+static void __peripheral_handle_i2c_scan_invalidate(const char *action, struct udev_device *dev, void *user_data)
+{
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+
+	if (info->i2c_scan_list == NULL)
+		return;
+
+	_D("i2c device %s %s, drop scan cache", udev_device_get_sysname(dev), action);
+
+	g_list_free_full(info->i2c_scan_list, free);
+	info->i2c_scan_list = NULL;
+}
+
+void peripheral_handle_i2c_scan_cache_init(gpointer user_data)
+{
+	/* New clients, driver binding and adapter changes all change what a scan sees */
+	peripheral_bus_udev_add_listener("i2c", __peripheral_handle_i2c_scan_invalidate, user_data);
+	peripheral_bus_udev_add_listener("i2c-dev", __peripheral_handle_i2c_scan_invalidate, user_data);
+}
+
+int peripheral_handle_i2c_scan(int bus, uint64_t *bitmap, gpointer user_data)
+{
+	RETVM_IF(bus < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c bus");
+	RETVM_IF(bitmap == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c scan bitmap");
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_i2c_scan_s *scan;
+	GList *link;
+	int ret;
+
+	RETV_IF(info == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER);
+	RETV_IF(info->board == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER);
+
+	if (peripheral_bus_board_find_i2c(info->board, bus) == NULL) {
+		_E("Not supported I2C bus : %d", bus);
+		return PERIPHERAL_ERROR_NOT_SUPPORTED;
+	}
+
+	link = info->i2c_scan_list;
+	while (link) {
+		scan = (peripheral_i2c_scan_s*)link->data;
+		if (scan->bus == bus) {
+			bitmap[0] = scan->bitmap[0];
+			bitmap[1] = scan->bitmap[1];
+			return PERIPHERAL_ERROR_NONE;
+		}
+		link = g_list_next(link);
+	}
+
+	scan = (peripheral_i2c_scan_s*)calloc(1, sizeof(peripheral_i2c_scan_s));
+	if (scan == NULL) {
+		_E("failed to allocate peripheral_i2c_scan_s");
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+
+	ret = peripheral_interface_i2c_scan(bus, scan->bitmap);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to scan i2c bus : %d", bus);
+		free(scan);
+		return ret;
+	}
+
+	scan->bus = bus;
+	info->i2c_scan_list = g_list_append(info->i2c_scan_list, scan);
+
+	bitmap[0] = scan->bitmap[0];
+	bitmap[1] = scan->bitmap[1];
+
+	return PERIPHERAL_ERROR_NONE;
+}
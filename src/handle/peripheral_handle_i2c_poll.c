@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include "peripheral_handle_common.h"
+#include "peripheral_handle_i2c_poll.h"
+#include "peripheral_interface_i2c.h"
+#include "peripheral_fdstore.h"
+
+#define I2C_POLL_NAME_LEN	32
+#define I2C_POLL_FD_NAME_LEN	64
+
+static void __peripheral_handle_i2c_poll_read(peripheral_i2c_poller_s *poller)
+{
+	unsigned char data[I2C_POLL_LENGTH_MAX];
+	int ret;
+
+	ret = peripheral_interface_i2c_read_register(poller->fd, poller->address, poller->reg, data, poller->length);
+	peripheral_bus_ring_publish(poller->ring, data, (ret == PERIPHERAL_ERROR_NONE) ? poller->length : 0, ret);
+}
+
+/*
+ * Each poller reads on its own thread so that a slow or stretched bus
+ * never blocks the main loop. Deadlines advance by the interval so the
+ * rate does not drift, a poller that fell behind skips missed periods.
+ */
+static gpointer __peripheral_handle_i2c_poll_thread(gpointer data)
+{
+	peripheral_i2c_poller_s *poller = (peripheral_i2c_poller_s*)data;
+	gint64 period = (gint64)poller->interval * G_TIME_SPAN_MILLISECOND;
+	gint64 deadline, now;
+
+	deadline = g_get_monotonic_time();
+
+	g_mutex_lock(&poller->mutex);
+	while (!poller->stop) {
+		g_mutex_unlock(&poller->mutex);
+		__peripheral_handle_i2c_poll_read(poller);
+		g_mutex_lock(&poller->mutex);
+
+		now = g_get_monotonic_time();
+		deadline += period;
+		if (deadline <= now)
+			deadline = now + period;
+
+		while (!poller->stop && g_cond_wait_until(&poller->cond, &poller->mutex, deadline))
+			;
+	}
+	g_mutex_unlock(&poller->mutex);
+
+	return NULL;
+}
+
+static peripheral_i2c_poller_s *__peripheral_handle_i2c_poller_find(int bus, int address, int reg, int length, unsigned int interval, peripheral_info_s *info)
+{
+	peripheral_i2c_poller_s *poller;
+	GList *link;
+
+	link = info->i2c_poller_list;
+	while (link) {
+		poller = (peripheral_i2c_poller_s*)link->data;
+		if (poller->bus == bus && poller->address == address && poller->reg == reg &&
+			poller->length == length && poller->interval == interval)
+			return poller;
+		link = g_list_next(link);
+	}
+
+	return NULL;
+}
+
+/* Names the ring in the fd store, the poller is found again by the same arguments */
+static void __peripheral_handle_i2c_poller_fd_name(peripheral_i2c_poller_s *poller, char *name)
+{
+	snprintf(name, I2C_POLL_FD_NAME_LEN, "i2c-poll-%d-%d-%d-%d-%u",
+			poller->bus, poller->address, poller->reg, poller->length, poller->interval);
+}
+
+static int __peripheral_handle_i2c_poller_ring_restore(peripheral_i2c_poller_s *poller)
+{
+	char fd_name[I2C_POLL_FD_NAME_LEN];
+	int fd;
+	int ret;
+
+	__peripheral_handle_i2c_poller_fd_name(poller, fd_name);
+
+	fd = peripheral_bus_fdstore_take(fd_name);
+	if (fd < 0)
+		return PERIPHERAL_ERROR_NO_DEVICE;
+
+	ret = peripheral_bus_ring_attach(fd, &poller->ring);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		close(fd);
+		peripheral_bus_fdstore_remove(fd_name);
+		return ret;
+	}
+
+	if (poller->ring->slot_size < sizeof(pb_ring_slot_s) + poller->length) {
+		peripheral_bus_ring_destroy(poller->ring);
+		poller->ring = NULL;
+		peripheral_bus_fdstore_remove(fd_name);
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+	}
+
+	/* The store still holds the ring, it stays there until the poller is freed */
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static void __peripheral_handle_i2c_poller_free(peripheral_i2c_poller_s *poller)
+{
+	char fd_name[I2C_POLL_FD_NAME_LEN];
+
+	if (poller->thread) {
+		g_mutex_lock(&poller->mutex);
+		poller->stop = true;
+		g_cond_signal(&poller->cond);
+		g_mutex_unlock(&poller->mutex);
+		g_thread_join(poller->thread);
+	}
+
+	if (poller->fd >= 0)
+		close(poller->fd);
+
+	if (poller->ring) {
+		__peripheral_handle_i2c_poller_fd_name(poller, fd_name);
+		peripheral_bus_fdstore_remove(fd_name);
+	}
+
+	peripheral_bus_ring_destroy(poller->ring);
+	g_cond_clear(&poller->cond);
+	g_mutex_clear(&poller->mutex);
+	free(poller);
+}
+
+static peripheral_i2c_poller_s *__peripheral_handle_i2c_poller_new(int bus, int address, int reg, int length, unsigned int interval, peripheral_info_s *info)
+{
+	peripheral_i2c_poller_s *poller;
+	char name[I2C_POLL_NAME_LEN];
+	char fd_name[I2C_POLL_FD_NAME_LEN];
+	int ret;
+
+	if (peripheral_bus_board_find_i2c(info->board, bus) == NULL) {
+		_E("Not supported I2C bus : %d", bus);
+		return NULL;
+	}
+
+	poller = (peripheral_i2c_poller_s*)calloc(1, sizeof(peripheral_i2c_poller_s));
+	if (poller == NULL) {
+		_E("failed to allocate peripheral_i2c_poller_s");
+		return NULL;
+	}
+
+	poller->bus = bus;
+	poller->address = address;
+	poller->reg = reg;
+	poller->length = length;
+	poller->interval = interval;
+	poller->fd = -1;
+	g_mutex_init(&poller->mutex);
+	g_cond_init(&poller->cond);
+
+	ret = peripheral_interface_i2c_bus_open(bus, &poller->fd);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to open i2c bus %d for polling", bus);
+		goto err;
+	}
+
+	/*
+	 * Readers of a poller that outlived a restart still map its old ring,
+	 * so that ring is picked up again instead of creating a new one.
+	 */
+	ret = __peripheral_handle_i2c_poller_ring_restore(poller);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		snprintf(name, I2C_POLL_NAME_LEN, "pb-i2c-%d-%02x-%02x", bus, address, reg);
+		ret = peripheral_bus_ring_create(name, length, I2C_POLL_RING_SLOTS, &poller->ring);
+		if (ret != PERIPHERAL_ERROR_NONE) {
+			_E("Failed to create ring for %s", name);
+			goto err;
+		}
+
+		__peripheral_handle_i2c_poller_fd_name(poller, fd_name);
+		peripheral_bus_fdstore_put(fd_name, poller->ring->fd);
+	}
+
+	/* The thread publishes a first sample right away so new readers do not wait a full period */
+	snprintf(name, I2C_POLL_NAME_LEN, "pb-i2c-poll-%d", bus);
+	poller->thread = g_thread_try_new(name, __peripheral_handle_i2c_poll_thread, poller, NULL);
+	if (poller->thread == NULL) {
+		_E("Failed to start i2c poll thread for bus %d", bus);
+		goto err;
+	}
+
+	poller->list = &info->i2c_poller_list;
+	info->i2c_poller_list = g_list_append(info->i2c_poller_list, poller);
+
+	return poller;
+
+err:
+	__peripheral_handle_i2c_poller_free(poller);
+	return NULL;
+}
+
+int peripheral_handle_i2c_poll_destroy(peripheral_h handle)
+{
+	RETVM_IF(handle == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c poll handle");
+
+	int ret = PERIPHERAL_ERROR_NONE;
+	peripheral_i2c_poller_s *poller = handle->type.i2c_poll.poller;
+	GList **poller_list = poller->list;
+
+	ret = peripheral_handle_free(handle);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to free i2c poll handle");
+		return ret;
+	}
+
+	if (--poller->refcount > 0)
+		return PERIPHERAL_ERROR_NONE;
+
+	_D("Stop polling bus : %d, address : 0x%x, reg : 0x%x", poller->bus, poller->address, poller->reg);
+
+	*poller_list = g_list_remove(*poller_list, poller);
+	__peripheral_handle_i2c_poller_free(poller);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_handle_i2c_poll_create(int bus, int address, int reg, int length, unsigned int interval, peripheral_h *handle, gpointer user_data)
+{
+	RETVM_IF(bus < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c bus");
+	RETVM_IF(address < 0 || address > I2C_ADDRESS_MAX, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c address");
+	RETVM_IF(reg < 0 || reg > 0xff, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c register");
+	RETVM_IF(length <= 0 || length > I2C_POLL_LENGTH_MAX, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c poll length");
+	RETVM_IF(interval < I2C_POLL_INTERVAL_MIN || interval > I2C_POLL_INTERVAL_MAX, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c poll interval");
+	RETVM_IF(handle == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c poll handle");
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+
+	peripheral_h poll_handle = NULL;
+	peripheral_i2c_poller_s *poller;
+
+	RETV_IF(info == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER);
+	RETV_IF(info->board == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER);
+
+	/* Readers asking for the same register at the same rate share one poller */
+	poller = __peripheral_handle_i2c_poller_find(bus, address, reg, length, interval, info);
+	if (poller == NULL) {
+		poller = __peripheral_handle_i2c_poller_new(bus, address, reg, length, interval, info);
+		if (poller == NULL) {
+			_E("bus : %d, address : 0x%x is not available for polling", bus, address);
+			return PERIPHERAL_ERROR_IO_ERROR;
+		}
+	}
+
+	poll_handle = peripheral_handle_new(&info->i2c_poll_list);
+	if (poll_handle == NULL) {
+		_E("peripheral_handle_new error");
+		if (poller->refcount == 0) {
+			info->i2c_poller_list = g_list_remove(info->i2c_poller_list, poller);
+			__peripheral_handle_i2c_poller_free(poller);
+		}
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+
+	poller->refcount++;
+
+	poll_handle->list = &info->i2c_poll_list;
+	poll_handle->type.i2c_poll.poller = poller;
+
+	*handle = poll_handle;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_handle_i2c_poll_fd_list_create(peripheral_h handle, GUnixFDList **list_out)
+{
+	RETVM_IF(handle == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c poll handle");
+
+	int ret;
+
+	GUnixFDList *list = NULL;
+	int fd = -1;
+
+	ret = peripheral_bus_ring_get_fd(handle->type.i2c_poll.poller->ring, true, &fd);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to get i2c poll ring fd");
+		return ret;
+	}
+
+	/* The list takes the ring fd over instead of duplicating it */
+	list = g_unix_fd_list_new_from_array(&fd, 1);
+
+	*list_out = list;
+
+	return ret;
+}
+
+void peripheral_handle_i2c_poll_fd_list_destroy(GUnixFDList *list)
+{
+	if (list != NULL)
+		g_object_unref(list);
+}
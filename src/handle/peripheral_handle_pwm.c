@@ -18,14 +18,14 @@
 
 static bool __peripheral_handle_pwm_is_creatable(int chip, int pin, peripheral_info_s *info)
 {
-	pb_board_dev_s *pwm = NULL;
+	const pb_board_dev_s *pwm = NULL;
 	peripheral_h handle;
 	GList *link;
 
 	RETV_IF(info == NULL, false);
 	RETV_IF(info->board == NULL, false);
 
-	pwm = peripheral_bus_board_find_device(PB_BOARD_DEV_PWM, info->board, chip, pin);
+	pwm = peripheral_bus_board_find_pwm(info->board, chip, pin);
 	if (pwm == NULL) {
 		_E("Not supported PWM chip : %d, pin : %d", chip, pin);
 		return false;
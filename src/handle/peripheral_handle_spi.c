@@ -15,17 +15,18 @@
  */
 
 #include "peripheral_handle_common.h"
+#include "peripheral_handle_spi_queue.h"
 
 static bool __peripheral_handle_spi_is_creatable(int bus, int cs, peripheral_info_s *info)
 {
-	pb_board_dev_s *spi = NULL;
+	const pb_board_dev_s *spi = NULL;
 	peripheral_h handle;
 	GList *link;
 
 	RETV_IF(info == NULL, false);
 	RETV_IF(info->board == NULL, false);
 
-	spi = peripheral_bus_board_find_device(PB_BOARD_DEV_SPI, info->board, bus, cs);
+	spi = peripheral_bus_board_find_spi(info->board, bus, cs);
 	if (spi == NULL) {
 		_E("Not supported SPI bus : %d, cs : %d", bus, cs);
 		return false;
@@ -50,6 +51,8 @@ int peripheral_handle_spi_destroy(peripheral_h handle)
 
 	int ret = PERIPHERAL_ERROR_NONE;
 
+	peripheral_handle_spi_queue_detach(handle);
+
 	ret = peripheral_handle_free(handle);
 	if (ret != PERIPHERAL_ERROR_NONE)
 		_E("Failed to free spi handle");
@@ -0,0 +1,498 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "peripheral_handle_common.h"
+#include "peripheral_handle_spi_queue.h"
+#include "peripheral_ring.h"
+
+#define SPI_QUEUE_NAME_LEN	32
+#define SPI_QUEUE_BATCH_MAX	32
+/* spidev rejects messages larger than its bufsiz module parameter */
+#define SPI_QUEUE_BATCH_BYTES	4096
+
+/*
+ * One queue per bus, served by its own thread so that transfers never
+ * block the main loop. The mutex protects the client list and is held
+ * while one batch runs, so a client cannot go away under the thread.
+ * It is dropped between batches, attach and detach wait for one batch
+ * at most.
+ */
+typedef struct {
+	int bus;
+	GList *clients;		/* highest priority first */
+	GMutex mutex;
+	GThread *thread;
+	int control_fd;
+	bool stop;
+	GList **list;
+} peripheral_spi_queue_s;
+
+struct _peripheral_spi_queue_client_s {
+	peripheral_spi_queue_s *queue;
+	int cs;
+	int priority;
+	int fd;
+	int doorbell_fd;
+	int completion_fd;
+	uint64_t tail;
+	pb_ring_s *ring;
+};
+
+static void __spi_queue_complete(peripheral_spi_queue_client_s *client, uint64_t end, int result)
+{
+	pb_ring_slot_s *slot;
+	uint64_t pos;
+	uint64_t value = 1;
+
+	for (pos = client->tail; pos < end; pos++) {
+		slot = peripheral_bus_ring_get_slot(client->ring, pos);
+		slot->result = result;
+	}
+
+	client->tail = end;
+	__atomic_store_n(&client->ring->header->tail, end, __ATOMIC_RELEASE);
+
+	if (write(client->completion_fd, &value, sizeof(value)) < 0)
+		_E("Failed to signal spi queue completion, errno : %d", errno);
+}
+
+/* Runs one batch of whole messages, returns false when nothing could be sent */
+static bool __spi_queue_client_run(peripheral_spi_queue_client_s *client)
+{
+	struct spi_ioc_transfer xfers[SPI_QUEUE_BATCH_MAX];
+	pb_ring_slot_s *slot;
+	pb_spi_xfer_s *xfer;
+	uint64_t head, pos, end;
+	uint32_t len, bytes = 0;
+	uint8_t flags;
+	int count = 0, message_count = 0;
+	int ret;
+
+	head = __atomic_load_n(&client->ring->header->head, __ATOMIC_ACQUIRE);
+	if (head - client->tail > client->ring->slot_count) {
+		_E("spi queue client on cs %d overran its ring", client->cs);
+		head = client->tail + client->ring->slot_count;
+	}
+
+	pos = end = client->tail;
+	while (pos < head && count < SPI_QUEUE_BATCH_MAX) {
+		slot = peripheral_bus_ring_get_slot(client->ring, pos);
+		xfer = (pb_spi_xfer_s*)(slot + 1);
+
+		/* The client shares this memory, read what is validated only once */
+		len = __atomic_load_n(&xfer->len, __ATOMIC_RELAXED);
+		flags = __atomic_load_n(&xfer->flags, __ATOMIC_RELAXED);
+		if (len == 0 || len > SPI_QUEUE_DATA_MAX) {
+			if (message_count == 0) {
+				__spi_queue_complete(client, pos + 1, -EINVAL);
+				return true;
+			}
+			break;
+		}
+
+		if (bytes + len > SPI_QUEUE_BATCH_BYTES)
+			break;
+
+		memset(&xfers[count], 0, sizeof(struct spi_ioc_transfer));
+		xfers[count].tx_buf = (uintptr_t)xfer->data;
+		xfers[count].rx_buf = (uintptr_t)xfer->data;
+		xfers[count].len = len;
+		xfers[count].speed_hz = xfer->speed_hz;
+		xfers[count].delay_usecs = xfer->delay_usecs;
+		xfers[count].bits_per_word = xfer->bits_per_word;
+
+		count++;
+		bytes += len;
+		pos++;
+
+		if (!(flags & PB_SPI_XFER_KEEP_CS)) {
+			/* Toggle the chip select between messages packed together */
+			xfers[count - 1].cs_change = 1;
+			message_count = count;
+			end = pos;
+		}
+	}
+
+	if (message_count == 0) {
+		/* A message that can never fit in one batch */
+		if (count == SPI_QUEUE_BATCH_MAX || (pos < head && bytes > 0)) {
+			/* Fail the whole message, up to its last submitted transfer */
+			while (pos < head) {
+				slot = peripheral_bus_ring_get_slot(client->ring, pos++);
+				xfer = (pb_spi_xfer_s*)(slot + 1);
+				if (!(__atomic_load_n(&xfer->flags, __ATOMIC_RELAXED) & PB_SPI_XFER_KEEP_CS))
+					break;
+			}
+			__spi_queue_complete(client, pos, -EMSGSIZE);
+			return true;
+		}
+		/* The rest of the message is not submitted yet */
+		return false;
+	}
+
+	/* cs_change on the last transfer would keep the chip selected afterwards */
+	xfers[message_count - 1].cs_change = 0;
+
+	ret = peripheral_interface_spi_transfer(client->fd, xfers, message_count);
+	__spi_queue_complete(client, end, (ret == PERIPHERAL_ERROR_NONE) ? 0 : -EIO);
+
+	return true;
+}
+
+static void __spi_queue_client_insert(peripheral_spi_queue_s *queue, peripheral_spi_queue_client_s *client)
+{
+	GList *link = queue->clients;
+	peripheral_spi_queue_client_s *other;
+
+	/* Behind the clients of the same priority, so equals take turns */
+	while (link) {
+		other = (peripheral_spi_queue_client_s*)link->data;
+		if (other->priority < client->priority)
+			break;
+		link = g_list_next(link);
+	}
+
+	queue->clients = g_list_insert_before(queue->clients, link, client);
+}
+
+/* Runs one batch of the first client that has one, returns false when none had */
+static bool __spi_queue_dispatch(peripheral_spi_queue_s *queue)
+{
+	peripheral_spi_queue_client_s *client;
+	bool progress = false;
+	GList *link;
+
+	g_mutex_lock(&queue->mutex);
+	if (queue->stop) {
+		g_mutex_unlock(&queue->mutex);
+		return false;
+	}
+
+	for (link = queue->clients; link; link = g_list_next(link)) {
+		client = (peripheral_spi_queue_client_s*)link->data;
+		if (__spi_queue_client_run(client)) {
+			queue->clients = g_list_delete_link(queue->clients, link);
+			__spi_queue_client_insert(queue, client);
+			progress = true;
+			break;
+		}
+	}
+	g_mutex_unlock(&queue->mutex);
+
+	return progress;
+}
+
+static gpointer __spi_queue_thread(gpointer data)
+{
+	peripheral_spi_queue_s *queue = (peripheral_spi_queue_s*)data;
+	peripheral_spi_queue_client_s *client;
+	struct pollfd pfds[SPI_QUEUE_CLIENTS_MAX + 1];
+	uint64_t value;
+	GList *link;
+	int count;
+
+	while (true) {
+		g_mutex_lock(&queue->mutex);
+		if (queue->stop) {
+			g_mutex_unlock(&queue->mutex);
+			break;
+		}
+
+		count = 0;
+		pfds[count].fd = queue->control_fd;
+		pfds[count++].events = POLLIN;
+		for (link = queue->clients; link; link = g_list_next(link)) {
+			client = (peripheral_spi_queue_client_s*)link->data;
+			pfds[count].fd = client->doorbell_fd;
+			pfds[count++].events = POLLIN;
+		}
+		g_mutex_unlock(&queue->mutex);
+
+		if (poll(pfds, count, -1) < 0 && errno != EINTR) {
+			_E("Failed to poll spi queue of bus %d, errno : %d", queue->bus, errno);
+			break;
+		}
+
+		if (read(queue->control_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+			_E("Failed to read spi queue control, errno : %d", errno);
+
+		/* Doorbells are read under the lock, a detached client's fd may be reused */
+		g_mutex_lock(&queue->mutex);
+		for (link = queue->clients; link; link = g_list_next(link)) {
+			client = (peripheral_spi_queue_client_s*)link->data;
+			if (read(client->doorbell_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+				_E("Failed to read spi queue doorbell, errno : %d", errno);
+		}
+		g_mutex_unlock(&queue->mutex);
+
+		/* The lock is taken per batch, a busy client does not hold off the main loop */
+		while (__spi_queue_dispatch(queue))
+			;
+	}
+
+	return NULL;
+}
+
+static void __spi_queue_wakeup(peripheral_spi_queue_s *queue)
+{
+	uint64_t value = 1;
+
+	if (write(queue->control_fd, &value, sizeof(value)) < 0)
+		_E("Failed to wake up spi queue, errno : %d", errno);
+}
+
+static void __spi_queue_free(peripheral_spi_queue_s *queue)
+{
+	if (queue->thread) {
+		g_mutex_lock(&queue->mutex);
+		queue->stop = true;
+		g_mutex_unlock(&queue->mutex);
+		__spi_queue_wakeup(queue);
+		g_thread_join(queue->thread);
+	}
+
+	if (queue->control_fd >= 0)
+		close(queue->control_fd);
+
+	g_mutex_clear(&queue->mutex);
+	free(queue);
+}
+
+static peripheral_spi_queue_s *__spi_queue_get(int bus, peripheral_info_s *info)
+{
+	peripheral_spi_queue_s *queue;
+	char name[SPI_QUEUE_NAME_LEN];
+	GList *link;
+
+	link = info->spi_queue_list;
+	while (link) {
+		queue = (peripheral_spi_queue_s*)link->data;
+		if (queue->bus == bus)
+			return queue;
+		link = g_list_next(link);
+	}
+
+	queue = (peripheral_spi_queue_s*)calloc(1, sizeof(peripheral_spi_queue_s));
+	if (queue == NULL) {
+		_E("failed to allocate peripheral_spi_queue_s");
+		return NULL;
+	}
+
+	queue->bus = bus;
+	g_mutex_init(&queue->mutex);
+
+	queue->control_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (queue->control_fd < 0) {
+		_E("Failed to create spi queue control eventfd, errno : %d", errno);
+		__spi_queue_free(queue);
+		return NULL;
+	}
+
+	snprintf(name, SPI_QUEUE_NAME_LEN, "pb-spi-queue-%d", bus);
+	queue->thread = g_thread_try_new(name, __spi_queue_thread, queue, NULL);
+	if (queue->thread == NULL) {
+		_E("Failed to start spi queue thread for bus %d", bus);
+		__spi_queue_free(queue);
+		return NULL;
+	}
+
+	queue->list = &info->spi_queue_list;
+	info->spi_queue_list = g_list_append(info->spi_queue_list, queue);
+
+	return queue;
+}
+
+static void __spi_queue_client_free(peripheral_spi_queue_client_s *client)
+{
+	if (client->fd >= 0)
+		close(client->fd);
+
+	if (client->doorbell_fd >= 0)
+		close(client->doorbell_fd);
+
+	if (client->completion_fd >= 0)
+		close(client->completion_fd);
+
+	peripheral_bus_ring_destroy(client->ring);
+	free(client);
+}
+
+static peripheral_spi_queue_client_s *__spi_queue_client_new(int bus, int cs, int priority, const peripheral_interface_spi_config_s *config)
+{
+	peripheral_spi_queue_client_s *client;
+	char name[SPI_QUEUE_NAME_LEN];
+	int ret;
+
+	client = (peripheral_spi_queue_client_s*)calloc(1, sizeof(peripheral_spi_queue_client_s));
+	if (client == NULL) {
+		_E("failed to allocate peripheral_spi_queue_client_s");
+		return NULL;
+	}
+
+	client->cs = cs;
+	client->priority = priority;
+	client->fd = -1;
+	client->doorbell_fd = -1;
+	client->completion_fd = -1;
+
+	ret = peripheral_interface_spi_open(bus, cs, config, &client->fd);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to open spi %d.%d for queueing", bus, cs);
+		goto err;
+	}
+
+	client->doorbell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	client->completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (client->doorbell_fd < 0 || client->completion_fd < 0) {
+		_E("Failed to create spi queue eventfd, errno : %d", errno);
+		goto err;
+	}
+
+	snprintf(name, SPI_QUEUE_NAME_LEN, "pb-spi-%d.%d", bus, cs);
+	ret = peripheral_bus_ring_create(name, sizeof(pb_spi_xfer_s), SPI_QUEUE_SLOTS, &client->ring);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to create ring for %s", name);
+		goto err;
+	}
+
+	return client;
+
+err:
+	__spi_queue_client_free(client);
+	return NULL;
+}
+
+int peripheral_handle_spi_queue_attach(peripheral_h handle, int priority, const peripheral_interface_spi_config_s *config, gpointer user_data)
+{
+	RETVM_IF(handle == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi handle");
+
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	peripheral_spi_queue_client_s *client;
+	peripheral_spi_queue_s *queue;
+	bool empty;
+	int ret;
+
+	RETV_IF(info == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER);
+
+	queue = __spi_queue_get(handle->type.spi.bus, info);
+	if (queue == NULL)
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+
+	client = __spi_queue_client_new(handle->type.spi.bus, handle->type.spi.cs, priority, config);
+
+	/* The worker relinks the list under the lock, it may look empty otherwise */
+	g_mutex_lock(&queue->mutex);
+	if (client == NULL) {
+		ret = PERIPHERAL_ERROR_IO_ERROR;
+	} else if (g_list_length(queue->clients) >= SPI_QUEUE_CLIENTS_MAX) {
+		_E("Too many spi queue clients on bus %d", queue->bus);
+		ret = PERIPHERAL_ERROR_RESOURCE_BUSY;
+	} else {
+		client->queue = queue;
+		__spi_queue_client_insert(queue, client);
+		ret = PERIPHERAL_ERROR_NONE;
+	}
+	empty = (queue->clients == NULL);
+	g_mutex_unlock(&queue->mutex);
+
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		if (client)
+			__spi_queue_client_free(client);
+		/* Only the main loop adds clients, an empty queue stays empty */
+		if (empty) {
+			*queue->list = g_list_remove(*queue->list, queue);
+			__spi_queue_free(queue);
+		}
+		return ret;
+	}
+
+	handle->type.spi.queue_client = client;
+	__spi_queue_wakeup(queue);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_handle_spi_queue_detach(peripheral_h handle)
+{
+	peripheral_spi_queue_client_s *client;
+	peripheral_spi_queue_s *queue;
+	bool empty;
+
+	RET_IF(handle == NULL);
+
+	client = handle->type.spi.queue_client;
+	if (client == NULL)
+		return;
+
+	queue = client->queue;
+	handle->type.spi.queue_client = NULL;
+
+	g_mutex_lock(&queue->mutex);
+	queue->clients = g_list_remove(queue->clients, client);
+	__spi_queue_client_free(client);
+	empty = (queue->clients == NULL);
+	g_mutex_unlock(&queue->mutex);
+
+	if (empty) {
+		_D("No more spi queue clients on bus %d", queue->bus);
+		*queue->list = g_list_remove(*queue->list, queue);
+		__spi_queue_free(queue);
+		return;
+	}
+
+	__spi_queue_wakeup(queue);
+}
+
+int peripheral_handle_spi_queue_fd_list_create(peripheral_h handle, GUnixFDList **list_out)
+{
+	RETVM_IF(handle == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi handle");
+	RETVM_IF(handle->type.spi.queue_client == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "spi handle is not queued");
+
+	int ret;
+
+	peripheral_spi_queue_client_s *client = handle->type.spi.queue_client;
+	GUnixFDList *list = NULL;
+	int fd = -1;
+
+	ret = peripheral_bus_ring_get_fd(client->ring, false, &fd);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("Failed to get spi queue ring fd");
+		return ret;
+	}
+
+	/*
+	 * Do not change the order of the fd list. The ring fd is a fresh one
+	 * the list takes over, the eventfds stay with the daemon and are
+	 * duplicated.
+	 */
+	list = g_unix_fd_list_new_from_array(&fd, 1);
+	g_unix_fd_list_append(list, client->doorbell_fd, NULL);
+	g_unix_fd_list_append(list, client->completion_fd, NULL);
+
+	*list_out = list;
+
+	return ret;
+}
+
+void peripheral_handle_spi_queue_fd_list_destroy(GUnixFDList *list)
+{
+	if (list != NULL)
+		g_object_unref(list);
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "peripheral_handle_common.h"
+#include "peripheral_handle_state.h"
+#include "peripheral_root.h"
+
+#define HANDLE_STATE_DIR	"/run/peripheral-bus"
+#define HANDLE_STATE_PATH	HANDLE_STATE_DIR "/handles"
+#define HANDLE_STATE_TMP_PATH	HANDLE_STATE_PATH ".tmp"
+#define HANDLE_STATE_PATH_MAX	256
+#define HANDLE_STATE_OWNER_LEN	256
+#define HANDLE_STATE_TYPE_LEN	16
+#define HANDLE_STATE_SAVE_DELAY	100	/* ms */
+
+/* Lines are "<id> <type> <args...> <owner>", with "-" as the owner of peers */
+static const struct {
+	const char *name;
+	size_t list_offset;
+} __handle_state_types[PB_HANDLE_STATE_MAX] = {
+	[PB_HANDLE_STATE_GPIO] = {"gpio", offsetof(peripheral_info_s, gpio_list)},
+	[PB_HANDLE_STATE_I2C] = {"i2c", offsetof(peripheral_info_s, i2c_list)},
+	[PB_HANDLE_STATE_I2C_POLL] = {"i2c-poll", offsetof(peripheral_info_s, i2c_poll_list)},
+	[PB_HANDLE_STATE_PWM] = {"pwm", offsetof(peripheral_info_s, pwm_list)},
+	[PB_HANDLE_STATE_ADC] = {"adc", offsetof(peripheral_info_s, adc_list)},
+	[PB_HANDLE_STATE_UART] = {"uart", offsetof(peripheral_info_s, uart_list)},
+	[PB_HANDLE_STATE_SPI] = {"spi", offsetof(peripheral_info_s, spi_list)},
+};
+
+static peripheral_info_s *__info;
+static char __path[HANDLE_STATE_PATH_MAX];
+static char __tmp_path[HANDLE_STATE_PATH_MAX];
+static guint __save_id;
+
+static void __handle_state_get_args(pb_handle_state_type_e type, peripheral_h handle, int *args)
+{
+	peripheral_i2c_poller_s *poller;
+
+	memset(args, 0, sizeof(int) * PB_HANDLE_STATE_ARGS);
+
+	switch (type) {
+	case PB_HANDLE_STATE_GPIO:
+		args[0] = handle->type.gpio.pin;
+		break;
+	case PB_HANDLE_STATE_I2C:
+		args[0] = handle->type.i2c.bus;
+		args[1] = handle->type.i2c.address;
+		break;
+	case PB_HANDLE_STATE_I2C_POLL:
+		poller = handle->type.i2c_poll.poller;
+		args[0] = poller->bus;
+		args[1] = poller->address;
+		args[2] = poller->reg;
+		args[3] = poller->length;
+		args[4] = (int)poller->interval;
+		break;
+	case PB_HANDLE_STATE_PWM:
+		args[0] = handle->type.pwm.chip;
+		args[1] = handle->type.pwm.pin;
+		break;
+	case PB_HANDLE_STATE_ADC:
+		args[0] = handle->type.adc.device;
+		args[1] = handle->type.adc.channel;
+		break;
+	case PB_HANDLE_STATE_UART:
+		args[0] = handle->type.uart.port;
+		break;
+	case PB_HANDLE_STATE_SPI:
+		args[0] = handle->type.spi.bus;
+		args[1] = handle->type.spi.cs;
+		break;
+	default:
+		break;
+	}
+}
+
+static void __handle_state_write(void)
+{
+	FILE *fp;
+	GList *link;
+	peripheral_h handle;
+	int args[PB_HANDLE_STATE_ARGS];
+	int type;
+	int ret;
+
+	if (__info == NULL)
+		return;
+
+	fp = fopen(__tmp_path, "w");
+	if (fp == NULL) {
+		_E("Failed to open %s, errno : %d", __tmp_path, errno);
+		return;
+	}
+
+	for (type = 0; type < PB_HANDLE_STATE_MAX; type++) {
+		link = *(GList**)((char*)__info + __handle_state_types[type].list_offset);
+		for (; link; link = g_list_next(link)) {
+			handle = (peripheral_h)link->data;
+			/* Queues are not restored, a restored handle would hold the cs with no queue */
+			if (type == PB_HANDLE_STATE_SPI && handle->type.spi.queue_client)
+				continue;
+			__handle_state_get_args(type, handle, args);
+			fprintf(fp, "%u %s %d %d %d %d %d %s\n", handle->id, __handle_state_types[type].name,
+					args[0], args[1], args[2], args[3], args[4],
+					handle->owner ? handle->owner : "-");
+		}
+	}
+
+	ret = fclose(fp);
+	if (ret != 0) {
+		_E("Failed to write %s, errno : %d", __tmp_path, errno);
+		unlink(__tmp_path);
+		return;
+	}
+
+	/* A crash in the middle of a write must leave the previous state whole */
+	if (rename(__tmp_path, __path) != 0)
+		_E("Failed to replace %s, errno : %d", __path, errno);
+}
+
+void peripheral_handle_state_init(peripheral_info_s *info)
+{
+	RET_IF(info == NULL);
+
+	char dir[HANDLE_STATE_PATH_MAX];
+
+	peripheral_bus_root_path(dir, HANDLE_STATE_PATH_MAX, HANDLE_STATE_DIR);
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+		_E("Failed to create %s, errno : %d", dir, errno);
+
+	peripheral_bus_root_path(__path, HANDLE_STATE_PATH_MAX, HANDLE_STATE_PATH);
+	peripheral_bus_root_path(__tmp_path, HANDLE_STATE_PATH_MAX, HANDLE_STATE_TMP_PATH);
+
+	__info = info;
+
+	/* Drops whatever could not be restored */
+	__handle_state_write();
+}
+
+void peripheral_handle_state_deinit(void)
+{
+	if (__save_id) {
+		g_source_remove(__save_id);
+		__save_id = 0;
+		__handle_state_write();
+	}
+
+	__info = NULL;
+}
+
+static gboolean __handle_state_save_cb(gpointer user_data)
+{
+	__save_id = 0;
+	__handle_state_write();
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Rewriting the file costs a pass over every handle, so it is kept off
+ * the request path. Changes within the delay go out in one write, a crash
+ * inside it loses only the handles opened or closed meanwhile.
+ */
+void peripheral_handle_state_save(void)
+{
+	if (__info == NULL || __save_id)
+		return;
+
+	__save_id = g_timeout_add(HANDLE_STATE_SAVE_DELAY, __handle_state_save_cb, NULL);
+}
+
+static int __handle_state_parse(const char *line, pb_handle_state_s *state, char *owner)
+{
+	char type[HANDLE_STATE_TYPE_LEN];
+	int i;
+
+	if (sscanf(line, "%u %15s %d %d %d %d %d %255s", &state->id, type,
+				&state->args[0], &state->args[1], &state->args[2],
+				&state->args[3], &state->args[4], owner) != 8)
+		return -1;
+
+	for (i = 0; i < PB_HANDLE_STATE_MAX; i++) {
+		if (strcmp(type, __handle_state_types[i].name) == 0)
+			break;
+	}
+	if (i == PB_HANDLE_STATE_MAX)
+		return -1;
+
+	state->type = i;
+	state->owner = strcmp(owner, "-") == 0 ? NULL : owner;
+
+	return 0;
+}
+
+int peripheral_handle_state_load(pb_handle_state_cb cb, void *user_data)
+{
+	RETVM_IF(cb == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid state callback");
+
+	char path[HANDLE_STATE_PATH_MAX];
+	gchar *contents = NULL;
+	gchar **lines;
+	pb_handle_state_s state;
+	char owner[HANDLE_STATE_OWNER_LEN];
+	int count = 0;
+	int i;
+
+	peripheral_bus_root_path(path, HANDLE_STATE_PATH_MAX, HANDLE_STATE_PATH);
+	if (!g_file_get_contents(path, &contents, NULL, NULL))
+		return PERIPHERAL_ERROR_NONE;
+
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	for (i = 0; lines[i]; i++) {
+		if (lines[i][0] == '\0')
+			continue;
+
+		if (__handle_state_parse(lines[i], &state, owner) != 0) {
+			_E("Skipping malformed handle state : %s", lines[i]);
+			continue;
+		}
+
+		cb(&state, user_data);
+		count++;
+	}
+
+	g_strfreev(lines);
+
+	_D("%d handles left by the previous instance", count);
+
+	return PERIPHERAL_ERROR_NONE;
+}
@@ -18,14 +18,14 @@
 
 static bool __peripheral_handle_uart_is_creatable(int port, peripheral_info_s *info)
 {
-	pb_board_dev_s *uart = NULL;
+	const pb_board_dev_s *uart = NULL;
 	peripheral_h handle;
 	GList *link;
 
 	RETV_IF(info == NULL, false);
 	RETV_IF(info->board == NULL, false);
 
-	uart = peripheral_bus_board_find_device(PB_BOARD_DEV_UART, info->board, port);
+	uart = peripheral_bus_board_find_uart(info->board, port);
 	if (uart == NULL) {
 		_E("Not supported UART port : %d", port);
 		return false;
@@ -18,6 +18,7 @@
 
 #include "peripheral_interface_adc.h"
 #include "peripheral_interface_common.h"
+#include "peripheral_registry.h"
 
 static int __peripheral_interface_adc_fd_open(int device, int channel, int *fd_out)
 {
@@ -25,12 +26,12 @@ static int __peripheral_interface_adc_fd_open(int device, int channel, int *fd_o
 	RETVM_IF(channel < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid adc channel");
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for adc");
 
+	int ret;
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/bus/iio/devices/iio:device%d/in_voltage%d_raw", device, channel);
-	fd = open(path, O_RDWR);
-	IF_ERROR_RETURN(fd < 0);
+	ret = peripheral_bus_registry_open(PB_BOARD_DEV_ADC, device, channel, O_RDWR, &fd);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
 
 	*fd_out = fd;
 
@@ -51,23 +52,14 @@ int peripheral_interface_adc_fd_list_create(int device, int channel, GUnixFDList
 	ret = __peripheral_interface_adc_fd_open(device, channel, &fd);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to open adc fd");
+		return ret;
 	}
 
-	list = g_unix_fd_list_new();
-	if (list == NULL) {
-		_E("Failed to create adc fd list");
-		ret = PERIPHERAL_ERROR_OUT_OF_MEMORY;
-		goto out;
-	}
-
-	/* Do not change the order of the fd list */
-	g_unix_fd_list_append(list, fd, NULL);
+	/* The list takes the fd over instead of duplicating it */
+	list = g_unix_fd_list_new_from_array(&fd, 1);
 
 	*list_out = list;
 
-out:
-	close(fd);
-
 	return ret;
 }
 
@@ -19,6 +19,11 @@
 
 #include "peripheral_interface_gpio.h"
 #include "peripheral_interface_common.h"
+#include "peripheral_stats.h"
+#include "peripheral_trace.h"
+#ifdef PERIPHERAL_BUS_SIMULATOR
+#include "peripheral_sim.h"
+#endif
 
 static int __gpio_wait_for_udev(int pin)
 {
@@ -84,16 +89,24 @@ out:
 	return ret;
 }
 
-int peripheral_interface_gpio_export(int pin)
+static int __gpio_export(int pin)
 {
 	RETVM_IF(pin < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid gpio pin");
 
 	int ret;
 	int fd;
 	int length;
+	uint64_t start;
+	char path[MAX_PATH_LEN] = {0, };
 	char buf[MAX_BUF_LEN] = {0, };
 
-	fd = open("/sys/class/gpio/export", O_WRONLY);
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	if (peripheral_bus_sim_is_active())
+		return peripheral_bus_sim_gpio_export(pin);
+#endif
+
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/gpio/export");
+	fd = open(path, O_WRONLY);
 	IF_ERROR_RETURN(fd < 0);
 
 	length = snprintf(buf, MAX_BUF_LEN, "%d", pin);
@@ -103,7 +116,11 @@ int peripheral_interface_gpio_export(int pin)
 	ret = close(fd);
 	IF_ERROR_RETURN(ret != 0);
 
+	start = peripheral_bus_stats_now();
+	PB_TRACE(gpio_udev_wait_entry, pin);
 	ret = __gpio_wait_for_udev(pin);
+	PB_TRACE(gpio_udev_wait_return, pin, ret);
+	peripheral_bus_stats_phase(PB_BOARD_DEV_GPIO, PB_STATS_PHASE_UDEV_WAIT, start);
 	if (ret < 0) {
 		_E("device nodes are not writable");
 		return PERIPHERAL_ERROR_IO_ERROR;
@@ -112,6 +129,17 @@ int peripheral_interface_gpio_export(int pin)
 	return PERIPHERAL_ERROR_NONE;
 }
 
+int peripheral_interface_gpio_export(int pin)
+{
+	int ret;
+
+	PB_TRACE(gpio_export_entry, pin);
+	ret = __gpio_export(pin);
+	PB_TRACE(gpio_export_return, pin, ret);
+
+	return ret;
+}
+
 int peripheral_interface_gpio_unexport(int pin)
 {
 	RETVM_IF(pin < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid gpio pin");
@@ -119,9 +147,16 @@ int peripheral_interface_gpio_unexport(int pin)
 	int ret;
 	int fd;
 	int length;
+	char path[MAX_PATH_LEN] = {0, };
 	char buf[MAX_BUF_LEN] = {0, };
 
-	fd = open("/sys/class/gpio/unexport", O_WRONLY);
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	if (peripheral_bus_sim_is_active())
+		return peripheral_bus_sim_gpio_unexport(pin);
+#endif
+
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/gpio/unexport");
+	fd = open(path, O_WRONLY);
 	IF_ERROR_RETURN(fd < 0);
 
 	length = snprintf(buf, MAX_BUF_LEN, "%d", pin);
@@ -140,9 +175,9 @@ static int __peripheral_interface_gpio_fd_direction_open(int pin, int *fd_out)
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for gpio direction");
 
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/gpio/gpio%d/direction", pin);
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/gpio/gpio%d/direction", pin);
 	fd = open(path, O_RDWR);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -157,9 +192,9 @@ static int __peripheral_interface_gpio_fd_edge_open(int pin, int *fd_out)
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for gpio edge");
 
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/gpio/gpio%d/edge", pin);
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/gpio/gpio%d/edge", pin);
 	fd = open(path, O_RDWR);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -174,9 +209,9 @@ static int __peripheral_interface_gpio_fd_value_open(int pin, int *fd_out)
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for gpio value");
 
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/gpio/gpio%d/value", pin);
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/gpio/gpio%d/value", pin);
 	fd = open(path, O_RDWR);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -195,6 +230,7 @@ int peripheral_interface_gpio_fd_list_create(int pin, GUnixFDList **list_out)
 	int fd_direction = -1;
 	int fd_edge = -1;
 	int fd_value = -1;
+	int fds[3];
 
 	ret = __peripheral_interface_gpio_fd_direction_open(pin, &fd_direction);
 	if (ret != PERIPHERAL_ERROR_NONE) {
@@ -214,17 +250,16 @@ int peripheral_interface_gpio_fd_list_create(int pin, GUnixFDList **list_out)
 		goto out;
 	}
 
-	list = g_unix_fd_list_new();
-	if (list == NULL) {
-		_E("Failed to create gpio fd list");
-		ret = PERIPHERAL_ERROR_OUT_OF_MEMORY;
-		goto out;
-	}
-
 	/* Do not change the order of the fd list */
-	g_unix_fd_list_append(list, fd_direction, NULL);
-	g_unix_fd_list_append(list, fd_edge, NULL);
-	g_unix_fd_list_append(list, fd_value, NULL);
+	fds[0] = fd_direction;
+	fds[1] = fd_edge;
+	fds[2] = fd_value;
+
+	/* The list takes the fds over instead of duplicating them */
+	list = g_unix_fd_list_new_from_array(fds, 3);
+	fd_direction = -1;
+	fd_edge = -1;
+	fd_value = -1;
 
 	*list_out = list;
 
@@ -15,11 +15,141 @@
  */
 
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
 
 #include "peripheral_interface_i2c.h"
 #include "peripheral_interface_common.h"
+#include "peripheral_registry.h"
+#ifdef PERIPHERAL_BUS_SIMULATOR
+#include "peripheral_sim.h"
+#endif
 
-#define I2C_SLAVE	0x0703	/* Use this slave address */
+int peripheral_interface_i2c_bus_open(int bus, int *fd_out)
+{
+	RETVM_IF(bus < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c bus");
+	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for i2c bus");
+
+	int ret;
+	int fd;
+	char path[MAX_PATH_LEN] = {0, };
+
+	ret = peripheral_bus_registry_resolve(PB_BOARD_DEV_I2C, bus, 0, path, MAX_PATH_LEN);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	IF_ERROR_RETURN(fd < 0);
+
+	*fd_out = fd;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_interface_i2c_read_register(int fd, int address, int reg, unsigned char *data, int length)
+{
+	RETVM_IF(fd < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c fd");
+	RETVM_IF(data == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid data for i2c register");
+	RETVM_IF(length <= 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid length for i2c register");
+
+	int ret;
+	unsigned char reg_buf = (unsigned char)reg;
+	struct i2c_msg msgs[2];
+	struct i2c_rdwr_ioctl_data rdwr;
+
+	/* Register write and data read in one transfer, with a repeated start in between */
+	msgs[0].addr = address;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &reg_buf;
+
+	msgs[1].addr = address;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = length;
+	msgs[1].buf = data;
+
+	rdwr.msgs = msgs;
+	rdwr.nmsgs = 2;
+
+	ret = ioctl(fd, I2C_RDWR, &rdwr);
+	IF_ERROR_RETURN(ret != 2);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __peripheral_interface_i2c_smbus_probe(int fd, int address, unsigned long funcs)
+{
+	struct i2c_smbus_ioctl_data args;
+	union i2c_smbus_data data;
+	bool use_read;
+
+	/*
+	 * Same policy as i2cdetect: quick write can corrupt EEPROMs and
+	 * lock up some sensors, so read a byte in those address ranges.
+	 */
+	if ((address >= 0x30 && address <= 0x37) || (address >= 0x50 && address <= 0x5f))
+		use_read = (funcs & I2C_FUNC_SMBUS_READ_BYTE) != 0;
+	else
+		use_read = (funcs & I2C_FUNC_SMBUS_QUICK) == 0;
+
+	if (use_read) {
+		args.read_write = I2C_SMBUS_READ;
+		args.command = 0;
+		args.size = I2C_SMBUS_BYTE;
+		args.data = &data;
+	} else {
+		args.read_write = I2C_SMBUS_WRITE;
+		args.command = 0;
+		args.size = I2C_SMBUS_QUICK;
+		args.data = NULL;
+	}
+
+	return ioctl(fd, I2C_SMBUS, &args);
+}
+
+int peripheral_interface_i2c_scan(int bus, uint64_t *bitmap)
+{
+	RETVM_IF(bus < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid i2c bus");
+	RETVM_IF(bitmap == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid bitmap for i2c scan");
+
+	int ret;
+	int fd;
+	int address;
+	unsigned long funcs = 0;
+
+	ret = peripheral_interface_i2c_bus_open(bus, &fd);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
+
+	ret = ioctl(fd, I2C_FUNCS, &funcs);
+	IF_ERROR_RETURN(ret < 0, close(fd));
+
+	if (!(funcs & (I2C_FUNC_SMBUS_QUICK | I2C_FUNC_SMBUS_READ_BYTE))) {
+		_E("i2c bus %d supports neither quick write nor read byte", bus);
+		close(fd);
+		return PERIPHERAL_ERROR_NOT_SUPPORTED;
+	}
+
+	bitmap[0] = 0;
+	bitmap[1] = 0;
+
+	for (address = I2C_SCAN_ADDRESS_FIRST; address <= I2C_SCAN_ADDRESS_LAST; address++) {
+		ret = ioctl(fd, I2C_SLAVE, address);
+		if (ret < 0) {
+			/* A kernel driver owns this address, so the device is there */
+			if (errno == EBUSY)
+				bitmap[address / 64] |= 1ULL << (address % 64);
+			continue;
+		}
+
+		if (__peripheral_interface_i2c_smbus_probe(fd, address, funcs) >= 0)
+			bitmap[address / 64] |= 1ULL << (address % 64);
+	}
+
+	close(fd);
+
+	return PERIPHERAL_ERROR_NONE;
+}
 
 static int __peripheral_interface_i2c_fd_open(int bus, int address, int *fd_out)
 {
@@ -29,13 +159,17 @@ static int __peripheral_interface_i2c_fd_open(int bus, int address, int *fd_out)
 
 	int ret;
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/dev/i2c-%d", bus);
-	fd = open(path, O_RDWR);
-	IF_ERROR_RETURN(fd < 0);
+	ret = peripheral_bus_registry_open(PB_BOARD_DEV_I2C, bus, 0, O_RDWR, &fd);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
 
 	ret = ioctl(fd, I2C_SLAVE, address);
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	/* Simulated nodes are plain files */
+	if (ret != 0 && errno == ENOTTY && peripheral_bus_sim_is_active())
+		ret = 0;
+#endif
 	IF_ERROR_RETURN(ret != 0, close(fd));
 
 	*fd_out = fd;
@@ -57,23 +191,14 @@ int peripheral_interface_i2c_fd_list_create(int bus, int address, GUnixFDList **
 	ret = __peripheral_interface_i2c_fd_open(bus, address, &fd);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to open i2c fd");
+		return ret;
 	}
 
-	list = g_unix_fd_list_new();
-	if (list == NULL) {
-		_E("Failed to create i2c fd list");
-		ret = PERIPHERAL_ERROR_OUT_OF_MEMORY;
-		goto out;
-	}
-
-	/* Do not change the order of the fd list */
-	g_unix_fd_list_append(list, fd, NULL);
+	/* The list takes the fd over instead of duplicating it */
+	list = g_unix_fd_list_new_from_array(&fd, 1);
 
 	*list_out = list;
 
-out:
-	close(fd);
-
 	return ret;
 }
 
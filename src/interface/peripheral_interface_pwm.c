@@ -17,6 +17,25 @@
 #include <stdlib.h>
 #include "peripheral_interface_pwm.h"
 #include "peripheral_interface_common.h"
+#include "peripheral_trace.h"
+#ifdef PERIPHERAL_BUS_SIMULATOR
+#include "peripheral_sim.h"
+#endif
+
+/* Lets clients write an attribute of an exported pwm, chsmack runs as a child */
+static int __pwm_relabel(int chip, int pin, const char *attr)
+{
+	int ret;
+	char buf[MAX_BUF_LEN] = {0, };
+
+	snprintf(buf, MAX_BUF_LEN, "chsmack -a \"*\" /sys/class/pwm/pwmchip%d/pwm%d/%s", chip, pin, attr);
+
+	PB_TRACE(pwm_system_entry, chip, pin, attr);
+	ret = system(buf);
+	PB_TRACE(pwm_system_return, chip, pin, ret);
+
+	return ret;
+}
 
 int peripheral_interface_pwm_export(int chip, int pin)
 {
@@ -26,10 +45,15 @@ int peripheral_interface_pwm_export(int chip, int pin)
 	int ret;
 	int fd;
 	int length;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 	char buf[MAX_BUF_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/pwm/pwmchip%d/export", chip);
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	if (peripheral_bus_sim_is_active())
+		return peripheral_bus_sim_pwm_export(chip, pin);
+#endif
+
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/pwm/pwmchip%d/export", chip);
 	fd = open(path, O_WRONLY);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -40,29 +64,25 @@ int peripheral_interface_pwm_export(int chip, int pin)
 	ret = close(fd);
 	IF_ERROR_RETURN(ret != 0);
 
-	snprintf(buf, MAX_BUF_LEN, "chsmack -a \"*\" /sys/class/pwm/pwmchip%d/pwm%d/period", chip, pin);
-	ret = system(buf);
+	ret = __pwm_relabel(chip, pin, "period");
 	if (ret != 0) {
 		_E("Failed to change period security label to read/write.");
 		return PERIPHERAL_ERROR_IO_ERROR;
 	}
 
-	snprintf(buf, MAX_BUF_LEN, "chsmack -a \"*\" /sys/class/pwm/pwmchip%d/pwm%d/duty_cycle", chip, pin);
-	ret = system(buf);
+	ret = __pwm_relabel(chip, pin, "duty_cycle");
 	if (ret != 0) {
 		_E("Failed to change duty_cycle security label to read/write.");
 		return PERIPHERAL_ERROR_IO_ERROR;
 	}
 
-	snprintf(buf, MAX_BUF_LEN, "chsmack -a \"*\" /sys/class/pwm/pwmchip%d/pwm%d/polarity", chip, pin);
-	ret = system(buf);
+	ret = __pwm_relabel(chip, pin, "polarity");
 	if (ret != 0) {
 		_E("Failed to change polarity security label to read/write.");
 		return PERIPHERAL_ERROR_IO_ERROR;
 	}
 
-	snprintf(buf, MAX_BUF_LEN, "chsmack -a \"*\" /sys/class/pwm/pwmchip%d/pwm%d/enable", chip, pin);
-	ret = system(buf);
+	ret = __pwm_relabel(chip, pin, "enable");
 	if (ret != 0) {
 		_E("Failed to change enable security label to read/write.");
 		return PERIPHERAL_ERROR_IO_ERROR;
@@ -79,10 +99,15 @@ int peripheral_interface_pwm_unexport(int chip, int pin)
 	int ret;
 	int fd;
 	int length;
-	char path[MAX_BUF_LEN] = {0};
+	char path[MAX_PATH_LEN] = {0};
 	char buf[MAX_BUF_LEN] = {0};
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/pwm/pwmchip%d/unexport", chip);
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	if (peripheral_bus_sim_is_active())
+		return peripheral_bus_sim_pwm_unexport(chip, pin);
+#endif
+
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/pwm/pwmchip%d/unexport", chip);
 	fd = open(path, O_WRONLY);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -103,9 +128,9 @@ static int __peripheral_interface_pwm_fd_period_open(int chip, int pin, int *fd_
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for pwm period");
 
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/period", chip, pin);
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/period", chip, pin);
 	fd = open(path, O_RDWR);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -121,9 +146,9 @@ static int __peripheral_interface_pwm_fd_duty_cycle_open(int chip, int pin, int
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for pwm duty cycle");
 
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/duty_cycle", chip, pin);
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/duty_cycle", chip, pin);
 	fd = open(path, O_RDWR);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -139,9 +164,9 @@ static int __peripheral_interface_pwm_fd_polarity_open(int chip, int pin, int *f
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for pwm polarity");
 
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/polarity", chip, pin);
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/polarity", chip, pin);
 	fd = open(path, O_RDWR);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -157,9 +182,9 @@ static int __peripheral_interface_pwm_fd_enable_open(int chip, int pin, int *fd_
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for pwm enable");
 
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/enable", chip, pin);
+	peripheral_bus_root_path(path, MAX_PATH_LEN, "/sys/class/pwm/pwmchip%d/pwm%d/enable", chip, pin);
 	fd = open(path, O_RDWR);
 	IF_ERROR_RETURN(fd < 0);
 
@@ -180,6 +205,7 @@ int peripheral_interface_pwm_fd_list_create(int chip, int pin, GUnixFDList **lis
 	int fd_duty_cycle = -1;
 	int fd_polarity = -1;
 	int fd_enable = -1;
+	int fds[4];
 
 	ret = __peripheral_interface_pwm_fd_period_open(chip, pin, &fd_period);
 	if (ret != PERIPHERAL_ERROR_NONE) {
@@ -205,18 +231,18 @@ int peripheral_interface_pwm_fd_list_create(int chip, int pin, GUnixFDList **lis
 		goto out;
 	}
 
-	list = g_unix_fd_list_new();
-	if (list == NULL) {
-		_E("Failed to create pwm fd list");
-		ret = PERIPHERAL_ERROR_OUT_OF_MEMORY;
-		goto out;
-	}
-
 	/* Do not change the order of the fd list */
-	g_unix_fd_list_append(list, fd_period, NULL);
-	g_unix_fd_list_append(list, fd_duty_cycle, NULL);
-	g_unix_fd_list_append(list, fd_polarity, NULL);
-	g_unix_fd_list_append(list, fd_enable, NULL);
+	fds[0] = fd_period;
+	fds[1] = fd_duty_cycle;
+	fds[2] = fd_polarity;
+	fds[3] = fd_enable;
+
+	/* The list takes the fds over instead of duplicating them */
+	list = g_unix_fd_list_new_from_array(fds, 4);
+	fd_period = -1;
+	fd_duty_cycle = -1;
+	fd_polarity = -1;
+	fd_enable = -1;
 
 	*list_out = list;
 
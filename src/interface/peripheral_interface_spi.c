@@ -14,8 +14,12 @@
  * limitations under the License.
  */
 
+#include <stdint.h>
+#include <sys/ioctl.h>
+
 #include "peripheral_interface_spi.h"
 #include "peripheral_interface_common.h"
+#include "peripheral_registry.h"
 
 static int __peripheral_interface_spi_fd_open(int bus, int cs, int *fd_out)
 {
@@ -23,20 +27,113 @@ static int __peripheral_interface_spi_fd_open(int bus, int cs, int *fd_out)
 	RETVM_IF(cs < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi cs");
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for spi");
 
+	int ret;
 	int fd = 0;
-	char path[MAX_BUF_LEN] = {0, };
 
-	snprintf(path, MAX_BUF_LEN, "/dev/spidev%d.%d", bus, cs);
+	ret = peripheral_bus_registry_open(PB_BOARD_DEV_SPI, bus, cs, O_RDWR, &fd);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
+
+	*fd_out = fd;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_interface_spi_configure(int fd, const peripheral_interface_spi_config_s *config)
+{
+	RETVM_IF(fd < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi fd");
+	RETVM_IF(config == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi config");
+
+	int ret;
+	uint32_t mode;
+	uint32_t max_speed_hz;
+	uint8_t bits_per_word;
+
+	/*
+	 * spidev keeps these per device, not per open file, so they survive
+	 * from the previous owner. Reading them back is cheap, writing them
+	 * may reprogram the controller, so only write what differs.
+	 */
+	if (config->set & SPI_CONFIG_MODE) {
+		ret = ioctl(fd, SPI_IOC_RD_MODE32, &mode);
+		IF_ERROR_RETURN(ret < 0);
+
+		if (mode != config->mode) {
+			mode = config->mode;
+			ret = ioctl(fd, SPI_IOC_WR_MODE32, &mode);
+			IF_ERROR_RETURN(ret < 0);
+		}
+	}
+
+	if (config->set & SPI_CONFIG_MAX_SPEED_HZ) {
+		ret = ioctl(fd, SPI_IOC_RD_MAX_SPEED_HZ, &max_speed_hz);
+		IF_ERROR_RETURN(ret < 0);
+
+		if (max_speed_hz != config->max_speed_hz) {
+			max_speed_hz = config->max_speed_hz;
+			ret = ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &max_speed_hz);
+			IF_ERROR_RETURN(ret < 0);
+		}
+	}
+
+	if (config->set & SPI_CONFIG_BITS_PER_WORD) {
+		RETVM_IF(config->bits_per_word == 0 || config->bits_per_word > 32,
+			PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi bits per word");
 
-	fd = open(path, O_RDWR);
-	IF_ERROR_RETURN(fd < 0);
+		ret = ioctl(fd, SPI_IOC_RD_BITS_PER_WORD, &bits_per_word);
+		IF_ERROR_RETURN(ret < 0);
+
+		if (bits_per_word != config->bits_per_word) {
+			bits_per_word = config->bits_per_word;
+			ret = ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits_per_word);
+			IF_ERROR_RETURN(ret < 0);
+		}
+	}
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_interface_spi_open(int bus, int cs, const peripheral_interface_spi_config_s *config, int *fd_out)
+{
+	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for spi");
+
+	int ret;
+	int fd = -1;
+
+	/* Opened close-on-exec, so it never leaks into a child */
+	ret = __peripheral_interface_spi_fd_open(bus, cs, &fd);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
+
+	if (config != NULL) {
+		ret = peripheral_interface_spi_configure(fd, config);
+		if (ret != PERIPHERAL_ERROR_NONE) {
+			_E("Failed to configure spi");
+			close(fd);
+			return ret;
+		}
+	}
 
 	*fd_out = fd;
 
 	return PERIPHERAL_ERROR_NONE;
 }
 
-int peripheral_interface_spi_fd_list_create(int bus, int cs, GUnixFDList **list_out)
+int peripheral_interface_spi_transfer(int fd, struct spi_ioc_transfer *xfers, int count)
+{
+	RETVM_IF(fd < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi fd");
+	RETVM_IF(xfers == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi transfers");
+	RETVM_IF(count <= 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi transfer count");
+
+	int ret;
+
+	ret = ioctl(fd, SPI_IOC_MESSAGE(count), xfers);
+	IF_ERROR_RETURN(ret < 0);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_interface_spi_fd_list_create(int bus, int cs, const peripheral_interface_spi_config_s *config, GUnixFDList **list_out)
 {
 	RETVM_IF(bus < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi bus");
 	RETVM_IF(cs < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid spi chip select");
@@ -46,27 +143,18 @@ int peripheral_interface_spi_fd_list_create(int bus, int cs, GUnixFDList **list_
 	GUnixFDList *list = NULL;
 	int fd = -1;
 
-
-	ret = __peripheral_interface_spi_fd_open(bus, cs, &fd);
+	/* Same open and configure sequence as the daemon's own fds */
+	ret = peripheral_interface_spi_open(bus, cs, config, &fd);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to open spi fd");
+		return ret;
 	}
 
-	list = g_unix_fd_list_new();
-	if (list == NULL) {
-		_E("Failed to create spi fd list");
-		ret = PERIPHERAL_ERROR_OUT_OF_MEMORY;
-		goto out;
-	}
-
-	/* Do not change the order of the fd list */
-	g_unix_fd_list_append(list, fd, NULL);
+	/* The list takes the fd over instead of duplicating it */
+	list = g_unix_fd_list_new_from_array(&fd, 1);
 
 	*list_out = list;
 
-out:
-	close(fd);
-
 	return ret;
 }
 
@@ -14,38 +14,26 @@
  * limitations under the License.
  */
 
-#include <termios.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
 
 #include "peripheral_interface_uart.h"
 #include "peripheral_interface_common.h"
-
-#ifndef ARRAY_SIZE
-#define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
-#endif
+#include "peripheral_registry.h"
 
 static int __peripheral_interface_uart_fd_open(int port, int *fd_out)
 {
 	RETVM_IF(port < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart port");
 	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for uart");
 
-	static char *sysfs_uart_path[] = {
-#if defined(SDTA7D)
-		"/dev/ttymxc",
-#endif
-		"/dev/ttyS",
-		"/dev/ttyAMA",
-		"/dev/ttySAC",
-	};
-
-	int index;
+	int ret;
 	int fd;
-	char path[MAX_BUF_LEN] = {0, };
+	char path[MAX_PATH_LEN] = {0, };
 
-	for (index = 0; index < ARRAY_SIZE(sysfs_uart_path); index++) {
-		snprintf(path, MAX_BUF_LEN, "%s%d", sysfs_uart_path[index], port);
-		if (access(path, F_OK) == 0)
-			break;
-	}
+	ret = peripheral_bus_registry_resolve(PB_BOARD_DEV_UART, port, 0, path, MAX_PATH_LEN);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
 
 	fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
 	IF_ERROR_RETURN(fd < 0);
@@ -55,7 +43,96 @@ static int __peripheral_interface_uart_fd_open(int port, int *fd_out)
 	return PERIPHERAL_ERROR_NONE;
 }
 
-int peripheral_interface_uart_fd_list_create(int port, GUnixFDList **list_out)
+static int __peripheral_interface_uart_set_low_latency(int fd)
+{
+	int ret;
+	struct serial_struct serial;
+
+	ret = ioctl(fd, TIOCGSERIAL, &serial);
+	if (ret < 0) {
+		/* Not every tty driver implements it (e.g. USB CDC ACM), this is only a hint */
+		_W("Low latency mode is not supported by this tty, errno : %d", errno);
+		return PERIPHERAL_ERROR_NONE;
+	}
+
+	if (serial.flags & ASYNC_LOW_LATENCY)
+		return PERIPHERAL_ERROR_NONE;
+
+	serial.flags |= ASYNC_LOW_LATENCY;
+	ret = ioctl(fd, TIOCSSERIAL, &serial);
+	IF_ERROR_RETURN(ret < 0);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_interface_uart_configure(int fd, const peripheral_interface_uart_config_s *config)
+{
+	RETVM_IF(fd < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart fd");
+	RETVM_IF(config == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart config");
+	RETVM_IF(config->baud_rate == 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart baud rate");
+	RETVM_IF(config->byte_size < 5 || config->byte_size > 8, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart byte size");
+	RETVM_IF(config->parity < UART_PARITY_NONE || config->parity > UART_PARITY_ODD, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart parity");
+	RETVM_IF(config->stop_bits < 1 || config->stop_bits > 2, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart stop bits");
+	RETVM_IF(config->vmin < 0 || config->vmin > 255, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart vmin");
+	RETVM_IF(config->vtime < 0 || config->vtime > 255, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart vtime");
+
+	static const tcflag_t byte_size_flags[] = { CS5, CS6, CS7, CS8 };
+
+	int ret;
+	struct termios2 tio;
+
+	ret = ioctl(fd, TCGETS2, &tio);
+	IF_ERROR_RETURN(ret < 0);
+
+	/* raw mode, the same as cfmakeraw() */
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY | INPCK);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= CLOCAL | CREAD;
+
+	tio.c_cflag |= byte_size_flags[config->byte_size - 5];
+
+	if (config->parity != UART_PARITY_NONE) {
+		tio.c_cflag |= PARENB;
+		tio.c_iflag |= INPCK;
+		if (config->parity == UART_PARITY_ODD)
+			tio.c_cflag |= PARODD;
+	}
+
+	if (config->stop_bits == 2)
+		tio.c_cflag |= CSTOPB;
+
+	if (config->sw_flow_control)
+		tio.c_iflag |= IXON | IXOFF;
+
+	if (config->hw_flow_control)
+		tio.c_cflag |= CRTSCTS;
+
+	/* BOTHER takes the rate from c_ispeed/c_ospeed instead of the Bxxx table */
+	tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = config->baud_rate;
+	tio.c_ospeed = config->baud_rate;
+
+	tio.c_cc[VMIN] = config->vmin;
+	tio.c_cc[VTIME] = config->vtime;
+
+	ret = ioctl(fd, TCSETS2, &tio);
+	IF_ERROR_RETURN(ret < 0);
+
+	if (config->low_latency) {
+		ret = __peripheral_interface_uart_set_low_latency(fd);
+		if (ret != PERIPHERAL_ERROR_NONE)
+			return ret;
+	}
+
+	ret = ioctl(fd, TCFLSH, TCIOFLUSH);
+	IF_ERROR_RETURN(ret < 0);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_interface_uart_fd_list_create(int port, const peripheral_interface_uart_config_s *config, GUnixFDList **list_out)
 {
 	RETVM_IF(port < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid uart port");
 
@@ -68,23 +145,23 @@ int peripheral_interface_uart_fd_list_create(int port, GUnixFDList **list_out)
 	ret = __peripheral_interface_uart_fd_open(port, &fd);
 	if (ret != PERIPHERAL_ERROR_NONE) {
 		_E("Failed to open uart fd");
+		return ret;
 	}
 
-	list = g_unix_fd_list_new();
-	if (list == NULL) {
-		_E("Failed to create uart fd list");
-		ret = PERIPHERAL_ERROR_OUT_OF_MEMORY;
-		goto out;
+	if (config != NULL) {
+		ret = peripheral_interface_uart_configure(fd, config);
+		if (ret != PERIPHERAL_ERROR_NONE) {
+			_E("Failed to configure uart");
+			close(fd);
+			return ret;
+		}
 	}
 
-	/* Do not change the order of the fd list */
-	g_unix_fd_list_append(list, fd, NULL);
+	/* The list takes the fd over instead of duplicating it */
+	list = g_unix_fd_list_new_from_array(&fd, 1);
 
 	*list_out = list;
 
-out:
-	close(fd);
-
 	return ret;
 }
 
@@ -25,232 +25,24 @@
 #include "peripheral_log.h"
 #include "peripheral_privilege.h"
 #include "peripheral_handle.h"
-#include "peripheral_io_gdbus.h"
-#include "peripheral_gdbus_gpio.h"
-#include "peripheral_gdbus_i2c.h"
-#include "peripheral_gdbus_pwm.h"
-#include "peripheral_gdbus_adc.h"
-#include "peripheral_gdbus_spi.h"
-#include "peripheral_gdbus_uart.h"
-
-#define PERIPHERAL_GDBUS_GPIO_PATH	"/Org/Tizen/Peripheral_io/Gpio"
-#define PERIPHERAL_GDBUS_I2C_PATH	"/Org/Tizen/Peripheral_io/I2c"
-#define PERIPHERAL_GDBUS_PWM_PATH	"/Org/Tizen/Peripheral_io/Pwm"
-#define PERIPHERAL_GDBUS_ADC_PATH	"/Org/Tizen/Peripheral_io/Adc"
-#define PERIPHERAL_GDBUS_UART_PATH	"/Org/Tizen/Peripheral_io/Uart"
-#define PERIPHERAL_GDBUS_SPI_PATH	"/Org/Tizen/Peripheral_io/Spi"
-#define PERIPHERAL_GDBUS_NAME		"org.tizen.peripheral_io"
-
-static gboolean __gpio_init(peripheral_info_s *info)
-{
-	GDBusObjectManagerServer *manager;
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
-	/* Add interface to default object path */
-	info->gpio_skeleton = peripheral_io_gdbus_gpio_skeleton_new();
-	/* Register for method callbacks as signal callbacks */
-	g_signal_connect(info->gpio_skeleton,
-			"handle-open",
-			G_CALLBACK(peripheral_gdbus_gpio_open),
-			info);
-	g_signal_connect(info->gpio_skeleton,
-			"handle-close",
-			G_CALLBACK(peripheral_gdbus_gpio_close),
-			info);
-
-	manager = g_dbus_object_manager_server_new(PERIPHERAL_GDBUS_GPIO_PATH);
-
-	/* Set connection to 'manager' */
-	g_dbus_object_manager_server_set_connection(manager, info->connection);
-
-	/* Export 'manager' interface on peripheral-io DBUS */
-	ret = g_dbus_interface_skeleton_export(
-		G_DBUS_INTERFACE_SKELETON(info->gpio_skeleton),
-		info->connection, PERIPHERAL_GDBUS_GPIO_PATH, &error);
-
-	if (ret == FALSE) {
-		_E("Can not skeleton_export %s", error->message);
-		g_error_free(error);
-	}
-
-	return true;
-}
-
-static gboolean __i2c_init(peripheral_info_s *info)
-{
-	GDBusObjectManagerServer *manager;
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
-	/* Add interface to default object path */
-	info->i2c_skeleton = peripheral_io_gdbus_i2c_skeleton_new();
-	g_signal_connect(info->i2c_skeleton,
-			"handle-open",
-			G_CALLBACK(peripheral_gdbus_i2c_open),
-			info);
-	g_signal_connect(info->i2c_skeleton,
-			"handle-close",
-			G_CALLBACK(peripheral_gdbus_i2c_close),
-			info);
-
-	manager = g_dbus_object_manager_server_new(PERIPHERAL_GDBUS_I2C_PATH);
-
-	/* Set connection to 'manager' */
-	g_dbus_object_manager_server_set_connection(manager, info->connection);
-
-	/* Export 'manager' interface on peripheral-io DBUS */
-	ret = g_dbus_interface_skeleton_export(
-		G_DBUS_INTERFACE_SKELETON(info->i2c_skeleton),
-		info->connection, PERIPHERAL_GDBUS_I2C_PATH, &error);
-
-	if (ret == FALSE) {
-		_E("Can not skeleton_export %s", error->message);
-		g_error_free(error);
-	}
-
-	return true;
-}
-
-static gboolean __pwm_init(peripheral_info_s *info)
-{
-	GDBusObjectManagerServer *manager;
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
-	/* Add interface to default object path */
-	info->pwm_skeleton = peripheral_io_gdbus_pwm_skeleton_new();
-	g_signal_connect(info->pwm_skeleton,
-			"handle-open",
-			G_CALLBACK(peripheral_gdbus_pwm_open),
-			info);
-	g_signal_connect(info->pwm_skeleton,
-			"handle-close",
-			G_CALLBACK(peripheral_gdbus_pwm_close),
-			info);
-
-	manager = g_dbus_object_manager_server_new(PERIPHERAL_GDBUS_PWM_PATH);
-
-	/* Set connection to 'manager' */
-	g_dbus_object_manager_server_set_connection(manager, info->connection);
-
-	/* Export 'manager' interface on peripheral-io DBUS */
-	ret = g_dbus_interface_skeleton_export(
-		G_DBUS_INTERFACE_SKELETON(info->pwm_skeleton),
-		info->connection, PERIPHERAL_GDBUS_PWM_PATH, &error);
-
-	if (ret == FALSE) {
-		_E("Can not skeleton_export %s", error->message);
-		g_error_free(error);
-	}
-
-	return true;
-}
-
-static gboolean __adc_init(peripheral_info_s *info)
-{
-	GDBusObjectManagerServer *manager;
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
-	/* Add interface to default object path */
-	info->adc_skeleton = peripheral_io_gdbus_adc_skeleton_new();
-	g_signal_connect(info->adc_skeleton,
-			"handle-open",
-			G_CALLBACK(peripheral_gdbus_adc_open),
-			info);
-	g_signal_connect(info->adc_skeleton,
-			"handle-close",
-			G_CALLBACK(peripheral_gdbus_adc_close),
-			info);
-
-	manager = g_dbus_object_manager_server_new(PERIPHERAL_GDBUS_ADC_PATH);
-
-	/* Set connection to 'manager' */
-	g_dbus_object_manager_server_set_connection(manager, info->connection);
-
-	/* Export 'manager' interface on peripheral-io DBUS */
-	ret = g_dbus_interface_skeleton_export(
-		G_DBUS_INTERFACE_SKELETON(info->adc_skeleton),
-		info->connection, PERIPHERAL_GDBUS_ADC_PATH, &error);
-
-	if (ret == FALSE) {
-		_E("Can not skeleton_export %s", error->message);
-		g_error_free(error);
-	}
-
-	return true;
-}
-
-static gboolean __uart_init(peripheral_info_s *info)
-{
-	GDBusObjectManagerServer *manager;
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
-	/* Add interface to default object path */
-	info->uart_skeleton = peripheral_io_gdbus_uart_skeleton_new();
-	g_signal_connect(info->uart_skeleton,
-			"handle-open",
-			G_CALLBACK(peripheral_gdbus_uart_open),
-			info);
-	g_signal_connect(info->uart_skeleton,
-			"handle-close",
-			G_CALLBACK(peripheral_gdbus_uart_close),
-			info);
-
-	manager = g_dbus_object_manager_server_new(PERIPHERAL_GDBUS_UART_PATH);
-
-	/* Set connection to 'manager' */
-	g_dbus_object_manager_server_set_connection(manager, info->connection);
-
-	/* Export 'manager' interface on peripheral-io DBUS */
-	ret = g_dbus_interface_skeleton_export(
-		G_DBUS_INTERFACE_SKELETON(info->uart_skeleton),
-		info->connection, PERIPHERAL_GDBUS_UART_PATH, &error);
-
-	if (ret == FALSE) {
-		_E("Can not skeleton_export %s", error->message);
-		g_error_free(error);
-	}
-
-	return true;
-}
-
-static gboolean __spi_init(peripheral_info_s *info)
-{
-	GDBusObjectManagerServer *manager;
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
-	/* Add interface to default object path */
-	info->spi_skeleton = peripheral_io_gdbus_spi_skeleton_new();
-	g_signal_connect(info->spi_skeleton,
-			"handle-open",
-			G_CALLBACK(peripheral_gdbus_spi_open),
-			info);
-	g_signal_connect(info->spi_skeleton,
-			"handle-close",
-			G_CALLBACK(peripheral_gdbus_spi_close),
-			info);
-
-	manager = g_dbus_object_manager_server_new(PERIPHERAL_GDBUS_SPI_PATH);
-
-	/* Set connection to 'manager' */
-	g_dbus_object_manager_server_set_connection(manager, info->connection);
-
-	/* Export 'manager' interface on peripheral-io DBUS */
-	ret = g_dbus_interface_skeleton_export(
-		G_DBUS_INTERFACE_SKELETON(info->spi_skeleton),
-		info->connection, PERIPHERAL_GDBUS_SPI_PATH, &error);
-
-	if (ret == FALSE) {
-		_E("Can not skeleton_export %s", error->message);
-		g_error_free(error);
-	}
+#include "peripheral_handle_i2c.h"
+#include "peripheral_udev.h"
+#include "peripheral_registry.h"
+#include "peripheral_idle.h"
+#include "peripheral_root.h"
+#include "peripheral_stats.h"
+#include "peripheral_recorder.h"
+#include "peripheral_watchdog.h"
+#include "peripheral_timeline.h"
+#ifdef PERIPHERAL_BUS_SIMULATOR
+#include "peripheral_sim.h"
+#endif
+#include "peripheral_fdstore.h"
+#include "peripheral_handle_state.h"
+#include "peripheral_gdbus.h"
+#include "peripheral_gdbus_stats.h"
 
-	return true;
-}
+#define PERIPHERAL_GDBUS_NAME		"org.tizen.peripheral_io"
 
 static void on_bus_acquired(GDBusConnection *connection,
 							const gchar *name,
@@ -260,28 +52,27 @@ static void on_bus_acquired(GDBusConnection *connection,
 
 	info->connection = connection;
 
-	if (__gpio_init(info) == FALSE)
-		_E("Can not signal connect");
-
-	if (__i2c_init(info) == FALSE)
-		_E("Can not signal connect");
+	if (peripheral_gdbus_register(info) != PERIPHERAL_ERROR_NONE)
+		_E("Can not register peripheral-io objects");
 
-	if (__pwm_init(info) == FALSE)
-		_E("Can not signal connect");
-
-	if (__adc_init(info) == FALSE)
-		_E("Can not signal connect");
-
-	if (__uart_init(info) == FALSE)
-		_E("Can not signal connect");
+	peripheral_bus_timeline_mark("bus_acquired");
+}
 
-	if (__spi_init(info) == FALSE)
-		_E("Can not signal connect");
+static void peripheral_bus_notify(void)
+{
+	_D("sd_notify(READY=1)");
+	sd_notify(0, "READY=1");
 }
 
 static void on_name_acquired(GDBusConnection *conn,
 				const gchar *name, gpointer user_data)
 {
+	peripheral_bus_timeline_mark("name_acquired");
+
+	/* Clients wait for the name, ready means it can be called */
+	peripheral_bus_notify();
+	peripheral_bus_timeline_mark("ready");
+	peripheral_bus_timeline_finish();
 }
 
 static void on_name_lost(GDBusConnection *conn,
@@ -290,12 +81,25 @@ static void on_name_lost(GDBusConnection *conn,
 	_E("Dbus name is lost!");
 }
 
-static gboolean peripheral_bus_notify(gpointer data)
+static void peripheral_bus_board_reloaded(pb_board_s *board, void *user_data)
 {
-	_D("sd_notify(READY=1)");
-	sd_notify(0, "READY=1");
+	peripheral_info_s *info = (peripheral_info_s*)user_data;
+	pb_board_s *old_board = info->board;
+
+	/*
+	 * Handles only consult the board when they are opened, so the ones
+	 * already open keep their resources even if the new board dropped them.
+	 */
+	info->board = board;
+	peripheral_bus_board_deinit(old_board);
+}
+
+static void peripheral_bus_idle_expired(void *user_data)
+{
+	GMainLoop *loop = (GMainLoop*)user_data;
 
-	return G_SOURCE_REMOVE;
+	sd_notify(0, "STOPPING=1");
+	g_main_loop_quit(loop);
 }
 
 int main(int argc, char *argv[])
@@ -303,6 +107,62 @@ int main(int argc, char *argv[])
 	GMainLoop *loop;
 	guint owner_id = 0;
 	peripheral_info_s *info;
+	GOptionContext *context;
+	GError *error = NULL;
+	gint idle_timeout = 0;
+	gint stall_threshold = 0;
+	gchar *root = NULL;
+	gchar *metrics_socket = NULL;
+	gchar *log_level = NULL;
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	gboolean simulate = FALSE;
+	gint sim_latency = 0;
+#endif
+	GOptionEntry entries[] = {
+		{"idle-timeout", 't', 0, G_OPTION_ARG_INT, &idle_timeout,
+			"Exit after SECONDS without open handles, 0 to stay up", "SECONDS"},
+		{"root", 'r', 0, G_OPTION_ARG_FILENAME, &root,
+			"Look up sysfs, device nodes and the board ini below DIR", "DIR"},
+		{"stall-threshold", 'w', 0, G_OPTION_ARG_INT, &stall_threshold,
+			"Report the main loop as stalled after MSEC without a heartbeat", "MSEC"},
+		{"metrics-socket", 'm', 0, G_OPTION_ARG_FILENAME, &metrics_socket,
+			"Serve the stats in the Prometheus text format on the unix socket PATH", "PATH"},
+		{"log-level", 'L', 0, G_OPTION_ARG_STRING, &log_level,
+			"Log messages up to LEVEL: error, warn, info or debug", "LEVEL"},
+#ifdef PERIPHERAL_BUS_SIMULATOR
+		{"simulate", 's', 0, G_OPTION_ARG_NONE, &simulate,
+			"Simulate the board devices below the root", NULL},
+		{"sim-latency", 'l', 0, G_OPTION_ARG_INT, &sim_latency,
+			"Delay simulated sysfs exports by USEC", "USEC"},
+#endif
+		{NULL}
+	};
+
+	peripheral_bus_timeline_init();
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		_E("failed to parse options : %s", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return -1;
+	}
+	g_option_context_free(context);
+
+	if (log_level && peripheral_bus_log_set_level(log_level) != PERIPHERAL_ERROR_NONE) {
+		g_free(log_level);
+		g_free(root);
+		return -1;
+	}
+	g_free(log_level);
+
+	if (peripheral_bus_root_init(root) != PERIPHERAL_ERROR_NONE) {
+		g_free(root);
+		return -1;
+	}
+	g_free(root);
+	peripheral_bus_timeline_mark("options");
 
 	info = (peripheral_info_s*)calloc(1, sizeof(peripheral_info_s));
 	if (info == NULL) {
@@ -310,12 +170,48 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	/* Before anything takes a passed fd, the peer socket and stored rings */
+	peripheral_bus_fdstore_init();
+	peripheral_bus_timeline_mark("fdstore_init");
+
 	info->board = peripheral_bus_board_init();
 	if (info->board == NULL) {
 		_E("failed to init board");
 		return -1;
 	}
 
+	if (peripheral_bus_board_watch(info->board, peripheral_bus_board_reloaded, info) != PERIPHERAL_ERROR_NONE)
+		_E("failed to watch board configuration, changes need a restart");
+	peripheral_bus_timeline_mark("board_watch");
+
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	if (simulate && !peripheral_bus_root_is_set()) {
+		_E("--simulate needs --root");
+		return -1;
+	}
+
+	if (simulate &&
+		peripheral_bus_sim_init(info->board, sim_latency > 0 ? sim_latency : 0) != PERIPHERAL_ERROR_NONE) {
+		_E("failed to simulate the board");
+		return -1;
+	}
+	peripheral_bus_timeline_mark("sim_init");
+#endif
+
+	if (peripheral_bus_root_is_set()) {
+		/* udev reports the devices of this machine, not the ones below the root */
+		_D("Not watching udev, devices are looked up below %s", peripheral_bus_root_get());
+	} else if (peripheral_bus_udev_init() == PERIPHERAL_ERROR_NONE) {
+		peripheral_bus_timeline_mark("udev_init");
+		peripheral_handle_i2c_scan_cache_init(info);
+		peripheral_bus_timeline_mark("i2c_scan_cache_init");
+		if (peripheral_bus_registry_init() != PERIPHERAL_ERROR_NONE)
+			_E("failed to init device registry, only board devices can be opened");
+		peripheral_bus_timeline_mark("registry_init");
+	} else {
+		_E("failed to init udev monitor, i2c scan results will not be cached");
+	}
+
 	owner_id = g_bus_own_name(G_BUS_TYPE_SYSTEM,
 							  PERIPHERAL_GDBUS_NAME,
 							  (GBusNameOwnerFlags) (G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT
@@ -330,18 +226,73 @@ int main(int argc, char *argv[])
 		free(info);
 		return -1;
 	}
+	peripheral_bus_timeline_mark("own_name");
 
 	loop = g_main_loop_new(NULL, FALSE);
 
-	g_idle_add(peripheral_bus_notify, NULL);
-
 	peripheral_privilege_init();
+	peripheral_bus_timeline_mark("privilege_init");
+
+	if (peripheral_gdbus_peer_start(info) != PERIPHERAL_ERROR_NONE)
+		_E("failed to listen for peer connections, only the bus is served");
+	peripheral_bus_timeline_mark("peer_start");
+
+	if (metrics_socket &&
+		peripheral_bus_stats_listen(metrics_socket, peripheral_gdbus_stats_active, info) != PERIPHERAL_ERROR_NONE)
+		_E("failed to serve stats on %s, they are still on the bus", metrics_socket);
+	g_free(metrics_socket);
+	peripheral_bus_timeline_mark("stats_listen");
+
+	if (peripheral_bus_recorder_init() != PERIPHERAL_ERROR_NONE)
+		_E("failed to watch SIGUSR1, the flight recorder is only on the bus");
+	peripheral_bus_timeline_mark("recorder_init");
+
+	/* Bus and socket activation bring the daemon back on the next request */
+	peripheral_bus_idle_init(idle_timeout > 0 ? idle_timeout : 0, peripheral_bus_idle_expired, loop);
+	peripheral_bus_timeline_mark("idle_init");
+
+	/* Nothing is dispatched before the loop runs, clients find their handles in place */
+	if (peripheral_gdbus_restore(info) != PERIPHERAL_ERROR_NONE)
+		_E("failed to restore handles, their clients have to open them again");
+	peripheral_bus_timeline_mark("restore");
+	peripheral_handle_state_init(info);
+	peripheral_bus_fdstore_flush();
+	peripheral_bus_timeline_mark("handle_state_init");
+
+	/* Startup may take a while, beats are only expected once the loop runs */
+	if (peripheral_bus_watchdog_init(stall_threshold > 0 ? stall_threshold : 0) != PERIPHERAL_ERROR_NONE)
+		_E("failed to watch the main loop, stalls go unnoticed");
+	peripheral_bus_timeline_mark("watchdog_init");
 
 	_D("Enter main loop!");
 	g_main_loop_run(loop);
 
+	/* No pings while shutting down, a hang on the way out trips the systemd watchdog */
+	peripheral_bus_watchdog_deinit();
+
+	/* Let the bus queue new callers for the next instance right away */
+	g_bus_unown_name(owner_id);
+
+	peripheral_bus_idle_deinit();
+
+	peripheral_handle_state_deinit();
+
+	peripheral_gdbus_peer_stop();
+
+	peripheral_bus_stats_unlisten();
+
+	peripheral_bus_recorder_deinit();
+
+	peripheral_gdbus_unregister(info);
+
 	peripheral_privilege_deinit();
 
+	peripheral_bus_registry_deinit();
+
+	peripheral_bus_udev_deinit();
+
+	peripheral_bus_board_unwatch();
+
 	if (info) {
 		peripheral_bus_board_deinit(info->board);
 		free(info);
@@ -16,17 +16,33 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <iniparser.h>
+#include <gio/gio.h>
 
 #include <peripheral_io.h>
 
 #include "peripheral_board.h"
+#include "peripheral_board_builtin.h"
+#include "peripheral_timeline.h"
+#include "peripheral_registry.h"
+#include "peripheral_root.h"
 #include "peripheral_log.h"
 
 #define STR_BUF_MAX 255
+#define BOARD_PATH_MAX 256
+
+#define BOARD_PINS_INIT	64
+/* A direct index may hold this many empty entries per device before falling back to bsearch */
+#define BOARD_INDEX_SPARSENESS	4
+#define BOARD_INDEX_SLACK	64
+
+/* Editors write in several steps, wait for the ini to settle before reloading */
+#define BOARD_RELOAD_DELAY_MS	500
 
 #define BOARD_INI_BASE SYSCONFDIR "/peripheral-bus/"
 
@@ -40,6 +56,18 @@
 #define BOARD_INI_UNKNOWN_PATH  BOARD_INI_BASE "pio_board_unknown.ini"
 
 
+typedef struct {
+	GFileMonitor *monitor;
+	GCancellable *cancellable;
+	guint timer_id;
+	bool loading;
+	bool pending;
+	peripheral_bus_board_reload_cb callback;
+	void *user_data;
+} pb_board_watch_s;
+
+static pb_board_watch_s *__board_watch;
+
 static const pb_board_type_s pb_board_type[] = {
 	{PB_BOARD_ARTIK710, "artik710 raptor", BOARD_INI_ARTIK710_PATH},
 	{PB_BOARD_ARTIK530, "artik530 raptor", BOARD_INI_ARTIK710_PATH},
@@ -96,25 +124,88 @@ static void peripheral_bus_board_ini_parse_key(pb_board_dev_e type, char *string
 	}
 }
 
-static int peripheral_bus_board_ini_parse_pins(char *string, unsigned int *pins)
+static int peripheral_bus_board_ini_parse_pins(pb_board_s *board, unsigned int *pins_max, char *string)
 {
 	const char delimiter[] = ", ";
 	int cnt_pins = 0;
 	char *token, *ptr = NULL;
+	unsigned int *pins;
 
 	if (string == NULL) return 0;
 
 	token = strtok_r(string, delimiter, &ptr);
 	while (token) {
-		if (cnt_pins >= BOARD_PINS_MAX) break;
+		if (board->num_pins == *pins_max) {
+			*pins_max = (*pins_max) ? (*pins_max * 2) : BOARD_PINS_INIT;
+			pins = realloc(board->pins, *pins_max * sizeof(unsigned int));
+			if (pins == NULL) {
+				_E("Failed to grow board pin list");
+				return -ENOMEM;
+			}
+			board->pins = pins;
+		}
 
-		pins[cnt_pins++] = atoi(token);
+		board->pins[board->num_pins++] = atoi(token);
+		cnt_pins++;
 		token = strtok_r(NULL, delimiter, &ptr);
 	}
 
 	return cnt_pins;
 }
 
+static void peripheral_bus_board_ini_parse_spi_config(char *string, pb_board_spi_config_s *config)
+{
+	const char delimiter[] = ", ";
+	char *token, *value, *ptr = NULL;
+
+	token = strtok_r(string, delimiter, &ptr);
+	while (token) {
+		value = strchr(token, '=');
+		if (value == NULL) {
+			_E("Invalid spi config : %s", token);
+			token = strtok_r(NULL, delimiter, &ptr);
+			continue;
+		}
+		*value++ = '\0';
+
+		if (strcmp(token, "mode") == 0) {
+			config->mode = strtoul(value, NULL, 0);
+			config->set |= PB_BOARD_SPI_MODE;
+		} else if (strcmp(token, "max_speed_hz") == 0) {
+			config->max_speed_hz = strtoul(value, NULL, 0);
+			config->set |= PB_BOARD_SPI_MAX_SPEED_HZ;
+		} else if (strcmp(token, "bits_per_word") == 0) {
+			config->bits_per_word = strtoul(value, NULL, 0);
+			config->set |= PB_BOARD_SPI_BITS_PER_WORD;
+		} else {
+			_E("Unknown spi config : %s", token);
+		}
+
+		token = strtok_r(NULL, delimiter, &ptr);
+	}
+}
+
+static void peripheral_bus_board_ini_parse_config(pb_board_dev_s *dev, char *string)
+{
+	char *config;
+
+	if (string == NULL) return;
+
+	/* Device defaults follow the pin list after a '|' */
+	config = strchr(string, '|');
+	if (config == NULL) return;
+	*config++ = '\0';
+
+	switch (dev->dev_type) {
+	case PB_BOARD_DEV_SPI:
+		peripheral_bus_board_ini_parse_spi_config(config, &dev->config.spi);
+		break;
+	default:
+		_E("Device config is not supported for type %d", dev->dev_type);
+		break;
+	}
+}
+
 static int peripheral_bus_board_ini_get_nkeys(dictionary *dict)
 {
 	int i, sec_num, key_num, ret = 0;
@@ -135,18 +226,19 @@ static int peripheral_bus_board_get_type(void)
 {
 	int fd, i, ret = 0;
 	char str_buf[STR_BUF_MAX] = {0};
+	char path[BOARD_PATH_MAX];
 	int type = PB_BOARD_UNKNOWN;
 
-	fd = open(BOARD_DEVICE_TREE, O_RDONLY);
+	peripheral_bus_root_path(path, BOARD_PATH_MAX, BOARD_DEVICE_TREE);
+	fd = open(path, O_RDONLY);
 	if (fd < 0) {
-		strerror_r(errno, str_buf, STR_BUF_MAX);
-		_E("Cannot open %s, errmsg : %s", BOARD_DEVICE_TREE, str_buf);
+		_E_ERRNO(errno, "Cannot open %s", path);
 		return -ENXIO;
 	}
 
 	ret = read(fd, str_buf, STR_BUF_MAX);
 	if (ret < 0) {
-		_E("Failed to read model information, path: %s, ret: %d", BOARD_DEVICE_TREE, ret);
+		_E("Failed to read model information, path: %s, ret: %d", path, ret);
 		close(fd);
 		return -EIO;
 	}
@@ -165,45 +257,166 @@ static int peripheral_bus_board_get_type(void)
 	return type;
 }
 
-static pb_board_s *peripheral_bus_board_get_info()
+static int peripheral_bus_board_dev_compare(const void *a, const void *b)
 {
-	dictionary *dict = NULL;
-	int i, j, ret;
-	int sec_num, key_num, cnt_key = 0;
-	pb_board_dev_s *dev;
-	pb_board_dev_e enum_dev;
-	pb_board_s *board;
+	const pb_board_dev_s *dev_a = (const pb_board_dev_s*)a;
+	const pb_board_dev_s *dev_b = (const pb_board_dev_s*)b;
+	int i;
 
-	board = (pb_board_s*)calloc(1, sizeof(pb_board_s));
-	if (board == NULL) {
-		_E("Failed to allocate pb_board_s");
-		return NULL;
+	if (dev_a->dev_type != dev_b->dev_type)
+		return (dev_a->dev_type < dev_b->dev_type) ? -1 : 1;
+
+	for (i = 0; i < BOARD_ARGS_MAX; i++) {
+		if (dev_a->args[i] != dev_b->args[i])
+			return (dev_a->args[i] < dev_b->args[i]) ? -1 : 1;
 	}
 
-	ret = peripheral_bus_board_get_type();
-	if (ret < 0) {
-		_E("Failed to get board type");
-		goto err_get_type;
+	return 0;
+}
+
+static gint peripheral_bus_board_dev_compare_data(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	return peripheral_bus_board_dev_compare(a, b);
+}
+
+static void peripheral_bus_board_table_build(pb_board_table_s *table, const pb_board_dev_s *dev, unsigned int num_dev)
+{
+	unsigned int i, key, max_arg1 = 0;
+	uint64_t size;
+
+	table->dev = dev;
+	table->num_dev = num_dev;
+	if (num_dev == 0)
+		return;
+
+	for (i = 0; i < num_dev; i++) {
+		if (dev[i].args[1] > max_arg1)
+			max_arg1 = dev[i].args[1];
 	}
 
-	board->type = (pb_board_type_e)ret;
-	dict = iniparser_load(pb_board_type[board->type].path);
+	/* Sorted by args[0] first, so the first and last devices give its range */
+	table->base = dev[0].args[0];
+	table->span = max_arg1 + 1;
+	size = (uint64_t)(dev[num_dev - 1].args[0] - table->base + 1) * table->span;
+	if (size > (uint64_t)num_dev * BOARD_INDEX_SPARSENESS + BOARD_INDEX_SLACK) {
+		_D("Board devices of type %d are sparse, using binary search", dev[0].dev_type);
+		return;
+	}
+
+	table->index = calloc(size, sizeof(pb_board_dev_s*));
+	if (table->index == NULL) {
+		_E("Failed to allocate board index, using binary search");
+		return;
+	}
+	table->index_size = size;
+
+	/* Duplicates are dropped on ini load and fail the builtin tables, keys are unique */
+	for (i = 0; i < num_dev; i++) {
+		key = (dev[i].args[0] - table->base) * table->span + dev[i].args[1];
+		table->index[key] = &dev[i];
+	}
+}
+
+static void peripheral_bus_board_index(pb_board_s *board)
+{
+	unsigned int i = 0, first;
+	pb_board_dev_e type;
+
+	/* board->dev is sorted by type, each table gets its slice */
+	for (type = PB_BOARD_DEV_GPIO; type < PB_BOARD_DEV_MAX; type++) {
+		first = i;
+		while (i < board->num_dev && board->dev[i].dev_type == type)
+			i++;
+		peripheral_bus_board_table_build(&board->table[type], &board->dev[first], i - first);
+	}
+}
+
+static const pb_board_dev_s *peripheral_bus_board_table_lookup(pb_board_table_s *table, pb_board_dev_e dev_type, int arg0, int arg1)
+{
+	pb_board_dev_s key;
+	unsigned int offset;
+
+	if (table->num_dev == 0)
+		return NULL;
+
+	if (table->index) {
+		if ((unsigned int)arg0 < table->base || (unsigned int)arg1 >= table->span)
+			return NULL;
+
+		offset = (unsigned int)arg0 - table->base;
+		if (offset >= table->index_size / table->span)
+			return NULL;
+
+		return table->index[offset * table->span + arg1];
+	}
+
+	key.dev_type = dev_type;
+	key.args[0] = arg0;
+	key.args[1] = arg1;
+
+	return bsearch(&key, table->dev, table->num_dev, sizeof(pb_board_dev_s), peripheral_bus_board_dev_compare);
+}
+
+static const pb_board_dev_s *peripheral_bus_board_lookup(pb_board_s *board, pb_board_dev_e dev_type, int arg0, int arg1)
+{
+	const pb_board_dev_s *dev;
+
+	RETV_IF(board == NULL, NULL);
+
+	if (arg0 < 0 || arg1 < 0)
+		return NULL;
+
+	/* The board lists pins, so it wins over what udev found */
+	dev = peripheral_bus_board_table_lookup(&board->table[dev_type], dev_type, arg0, arg1);
+	if (dev == NULL)
+		dev = peripheral_bus_registry_find(dev_type, arg0, arg1);
+
+	return dev;
+}
+
+static void peripheral_bus_board_free(pb_board_s *board)
+{
+	int type;
+
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++)
+		free(board->table[type].index);
+
+	if (!board->builtin)
+		free((void*)board->dev);
+
+	free(board->pins);
+	free(board);
+}
+
+static int peripheral_bus_board_ini_load(pb_board_s *board, const char *path)
+{
+	dictionary *dict = NULL;
+	int i, j, ret;
+	int sec_num, key_num, cnt_key = 0;
+	unsigned int offset = 0, pins_max = 0;
+	pb_board_dev_s *devs, *dev;
+	pb_board_dev_e enum_dev;
+
+	dict = iniparser_load(path);
 	if (dict == NULL) {
-		_E("Failed to load %s", pb_board_type[board->type].path);
-		goto err_get_type;
+		_E("Failed to load %s", path);
+		return -EIO;
 	}
 
 	board->num_dev = peripheral_bus_board_ini_get_nkeys(dict);
 	if (board->num_dev == 0) {
-		_E("There is no device to open");
-		goto err_get_nkeys;
+		_W("%s lists no device, only devices found by udev can be opened", path);
+		ret = 0;
+		goto out;
 	}
 
-	board->dev = calloc(board->num_dev, sizeof(pb_board_dev_s));
-	if (board->dev == NULL) {
+	devs = calloc(board->num_dev, sizeof(pb_board_dev_s));
+	if (devs == NULL) {
 		_E("Failed to allocate pb_board_dev_s");
-		goto err_get_nkeys;
+		ret = -ENOMEM;
+		goto out;
 	}
+	board->dev = devs;
 
 	sec_num = iniparser_getnsec(dict);
 	for (i = 0; i < sec_num; i++) {
@@ -222,49 +435,145 @@ static pb_board_s *peripheral_bus_board_get_info()
 			continue;
 
 		for (j = 0; j < key_num; j++) {
-			dev = &board->dev[cnt_key];
+			dev = &devs[cnt_key];
 			dev->dev_type = enum_dev;
 			key_str = iniparser_getstring(dict, key_list[j], NULL);
 			peripheral_bus_board_ini_parse_key(dev->dev_type, key_list[j], dev->args);
-			dev->num_pins = peripheral_bus_board_ini_parse_pins(key_str, dev->pins);
+			peripheral_bus_board_ini_parse_config(dev, key_str);
+			ret = peripheral_bus_board_ini_parse_pins(board, &pins_max, key_str);
+			if (ret < 0)
+				goto out;
+			dev->num_pins = ret;
 			cnt_key++;
 		}
 	}
 
-	iniparser_freedict(dict);
+	/* Sections of unknown types were skipped */
+	board->num_dev = cnt_key;
 
-	return board;
+	/* Pins were appended in device order, hand them out before sorting */
+	for (i = 0; i < cnt_key; i++) {
+		devs[i].pins = (devs[i].num_pins > 0) ? &board->pins[offset] : NULL;
+		offset += devs[i].num_pins;
+	}
+
+	/* g_qsort_with_data() is stable, of duplicated devices the first listed is kept */
+	g_qsort_with_data(devs, cnt_key, sizeof(pb_board_dev_s), peripheral_bus_board_dev_compare_data, NULL);
 
-err_get_nkeys:
+	for (i = 0, j = 0; i < cnt_key; i++) {
+		if (j > 0 && peripheral_bus_board_dev_compare(&devs[j - 1], &devs[i]) == 0) {
+			_W("Duplicated board device in %s, type : %d, args : %u, %u, ignored",
+					path, devs[i].dev_type, devs[i].args[0], devs[i].args[1]);
+			continue;
+		}
+		devs[j++] = devs[i];
+	}
+	board->num_dev = j;
+
+	ret = 0;
+
+out:
 	iniparser_freedict(dict);
+	return ret;
+}
 
-err_get_type:
-	free(board);
-	return NULL;
+static int peripheral_bus_board_builtin_load(pb_board_s *board, const char *path)
+{
+	const char *name;
+	unsigned int i;
+
+	name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+
+	for (i = 0; i < peripheral_bus_board_builtin_count; i++) {
+		if (strcmp(peripheral_bus_board_builtin[i].name, name) != 0)
+			continue;
+
+		board->builtin = true;
+		board->dev = peripheral_bus_board_builtin[i].dev;
+		board->num_dev = peripheral_bus_board_builtin[i].num_dev;
+		if (board->num_dev == 0)
+			_W("%s lists no device, only devices found by udev can be opened", name);
+
+		return 0;
+	}
+
+	_E("No builtin board table for %s", name);
+	return -ENOENT;
 }
 
-pb_board_dev_s *peripheral_bus_board_find_device(pb_board_dev_e dev_type, pb_board_s *board, int arg, ...)
+static pb_board_s *peripheral_bus_board_get_info()
 {
-	int i, args[2] = {0, };
-	va_list ap;
+	const char *path;
+	char override[BOARD_PATH_MAX];
+	pb_board_s *board;
+	int ret;
 
-	RETV_IF(board == NULL, false);
+	board = (pb_board_s*)calloc(1, sizeof(pb_board_s));
+	if (board == NULL) {
+		_E("Failed to allocate pb_board_s");
+		return NULL;
+	}
 
-	args[0] = arg;
-	if (dev_type == PB_BOARD_DEV_PWM || dev_type == PB_BOARD_DEV_SPI) {
-		va_start(ap, arg);
-		args[1] = va_arg(ap, int);
-		va_end(ap);
+	ret = peripheral_bus_board_get_type();
+	if (ret < 0) {
+		/* e.g. no device tree, the udev registry still provides devices */
+		_W("Failed to get board type, assuming an unknown board");
+		ret = PB_BOARD_UNKNOWN;
 	}
 
-	for (i = 0; i < board->num_dev; i++) {
-		if (board->dev[i].dev_type != dev_type) continue;
+	board->type = (pb_board_type_e)ret;
+	path = pb_board_type[board->type].path;
+	peripheral_bus_timeline_mark("board_type");
+
+	/* The tables compiled from data/ are used unless an ini overrides them */
+	peripheral_bus_root_path(override, BOARD_PATH_MAX, "%s", path);
+	if (access(override, F_OK) == 0) {
+		_D("Loading board override %s", override);
+		ret = peripheral_bus_board_ini_load(board, override);
+	} else {
+		ret = peripheral_bus_board_builtin_load(board, path);
+	}
 
-		if (board->dev[i].args[0] == args[0] && board->dev[i].args[1] == args[1])
-			return &board->dev[i];
+	if (ret < 0) {
+		peripheral_bus_board_free(board);
+		return NULL;
 	}
 
-	return NULL;
+	peripheral_bus_board_index(board);
+	peripheral_bus_timeline_mark("board_ini");
+
+	return board;
+}
+
+const pb_board_dev_s *peripheral_bus_board_find_gpio(pb_board_s *board, int pin)
+{
+	return peripheral_bus_board_lookup(board, PB_BOARD_DEV_GPIO, pin, 0);
+}
+
+const pb_board_dev_s *peripheral_bus_board_find_i2c(pb_board_s *board, int bus)
+{
+	return peripheral_bus_board_lookup(board, PB_BOARD_DEV_I2C, bus, 0);
+}
+
+const pb_board_dev_s *peripheral_bus_board_find_pwm(pb_board_s *board, int chip, int pin)
+{
+	return peripheral_bus_board_lookup(board, PB_BOARD_DEV_PWM, chip, pin);
+}
+
+const pb_board_dev_s *peripheral_bus_board_find_adc(pb_board_s *board, int device, int channel)
+{
+	return peripheral_bus_board_lookup(board, PB_BOARD_DEV_ADC, device, channel);
+}
+
+const pb_board_dev_s *peripheral_bus_board_find_uart(pb_board_s *board, int port)
+{
+	return peripheral_bus_board_lookup(board, PB_BOARD_DEV_UART, port, 0);
+}
+
+const pb_board_dev_s *peripheral_bus_board_find_spi(pb_board_s *board, int bus, int cs)
+{
+	return peripheral_bus_board_lookup(board, PB_BOARD_DEV_SPI, bus, cs);
 }
 
 pb_board_s *peripheral_bus_board_init(void)
@@ -278,10 +587,170 @@ pb_board_s *peripheral_bus_board_init(void)
 
 void peripheral_bus_board_deinit(pb_board_s *board)
 {
-	if (board) {
-		if (board->dev)
-			free(board->dev);
+	if (board)
+		peripheral_bus_board_free(board);
+}
 
-		free(board);
+static void peripheral_bus_board_watch_free(pb_board_watch_s *watch)
+{
+	if (watch->timer_id)
+		g_source_remove(watch->timer_id);
+
+	if (watch->monitor) {
+		g_signal_handlers_disconnect_by_data(watch->monitor, watch);
+		g_object_unref(watch->monitor);
 	}
+
+	g_object_unref(watch->cancellable);
+	free(watch);
+}
+
+static void peripheral_bus_board_load_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+	pb_board_s *board;
+
+	board = peripheral_bus_board_get_info();
+	if (board == NULL) {
+		g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to load board");
+		return;
+	}
+
+	g_task_return_pointer(task, board, (GDestroyNotify)peripheral_bus_board_deinit);
+}
+
+static void peripheral_bus_board_load(pb_board_watch_s *watch);
+
+static void peripheral_bus_board_load_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	pb_board_watch_s *watch = (pb_board_watch_s*)user_data;
+	GError *error = NULL;
+	pb_board_s *board;
+
+	watch->loading = false;
+
+	board = g_task_propagate_pointer(G_TASK(result), &error);
+	if (g_cancellable_is_cancelled(watch->cancellable)) {
+		/* Unwatched while loading, the watch was left for us to free */
+		peripheral_bus_board_deinit(board);
+		g_clear_error(&error);
+		peripheral_bus_board_watch_free(watch);
+		return;
+	}
+
+	if (board == NULL) {
+		_E("Keeping the current board, %s", error ? error->message : "unknown error");
+		g_clear_error(&error);
+	} else {
+		_D("Board configuration reloaded, %u devices", board->num_dev);
+		watch->callback(board, watch->user_data);
+	}
+
+	if (watch->pending) {
+		watch->pending = false;
+		peripheral_bus_board_load(watch);
+	}
+}
+
+static void peripheral_bus_board_load(pb_board_watch_s *watch)
+{
+	GTask *task;
+
+	/* One load at a time, changes made meanwhile trigger another one */
+	if (watch->loading) {
+		watch->pending = true;
+		return;
+	}
+
+	watch->loading = true;
+
+	task = g_task_new(NULL, watch->cancellable, peripheral_bus_board_load_done, watch);
+	g_task_run_in_thread(task, peripheral_bus_board_load_thread);
+	g_object_unref(task);
+}
+
+static gboolean peripheral_bus_board_reload_timeout(gpointer user_data)
+{
+	pb_board_watch_s *watch = (pb_board_watch_s*)user_data;
+
+	watch->timer_id = 0;
+	peripheral_bus_board_load(watch);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void peripheral_bus_board_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+		GFileMonitorEvent event_type, gpointer user_data)
+{
+	pb_board_watch_s *watch = (pb_board_watch_s*)user_data;
+
+	if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+		return;
+
+	if (watch->timer_id)
+		g_source_remove(watch->timer_id);
+
+	watch->timer_id = g_timeout_add(BOARD_RELOAD_DELAY_MS, peripheral_bus_board_reload_timeout, watch);
+}
+
+int peripheral_bus_board_watch(pb_board_s *board, peripheral_bus_board_reload_cb callback, void *user_data)
+{
+	RETVM_IF(board == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid board");
+	RETVM_IF(callback == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid board reload callback");
+	RETVM_IF(__board_watch != NULL, PERIPHERAL_ERROR_RESOURCE_BUSY, "Board is already watched");
+
+	pb_board_watch_s *watch;
+	GError *error = NULL;
+	GFile *file;
+	char path[BOARD_PATH_MAX];
+
+	watch = (pb_board_watch_s*)calloc(1, sizeof(pb_board_watch_s));
+	if (watch == NULL) {
+		_E("Failed to allocate pb_board_watch_s");
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+
+	watch->cancellable = g_cancellable_new();
+	watch->callback = callback;
+	watch->user_data = user_data;
+
+	/* The override may not exist yet, the monitor reports it being created */
+	peripheral_bus_root_path(path, BOARD_PATH_MAX, "%s", pb_board_type[board->type].path);
+	file = g_file_new_for_path(path);
+	watch->monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+	g_object_unref(file);
+
+	if (watch->monitor == NULL) {
+		_E("Failed to watch %s, %s", path, error->message);
+		g_error_free(error);
+		peripheral_bus_board_watch_free(watch);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	g_signal_connect(watch->monitor, "changed", G_CALLBACK(peripheral_bus_board_changed), watch);
+
+	__board_watch = watch;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_bus_board_unwatch(void)
+{
+	pb_board_watch_s *watch = __board_watch;
+
+	if (watch == NULL)
+		return;
+
+	__board_watch = NULL;
+
+	if (watch->timer_id) {
+		g_source_remove(watch->timer_id);
+		watch->timer_id = 0;
+	}
+
+	if (watch->loading) {
+		g_cancellable_cancel(watch->cancellable);
+		return;
+	}
+
+	peripheral_bus_board_watch_free(watch);
 }
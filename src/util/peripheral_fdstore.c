@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <systemd/sd-daemon.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_fdstore.h"
+
+#define FDSTORE_STATE_LEN	320
+
+static char **__names;
+static int __count;
+
+void peripheral_bus_fdstore_init(void)
+{
+	int n;
+
+	/* Unset the environment, the fds must not leak into anything we spawn */
+	n = sd_listen_fds_with_names(1, &__names);
+	if (n <= 0) {
+		__names = NULL;
+		__count = 0;
+		return;
+	}
+
+	__count = n;
+	_D("%d fds passed in", n);
+}
+
+void peripheral_bus_fdstore_flush(void)
+{
+	int i;
+
+	for (i = 0; i < __count; i++) {
+		if (__names[i] == NULL)
+			continue;
+
+		_D("Dropping stale fd %s", __names[i]);
+		close(SD_LISTEN_FDS_START + i);
+		peripheral_bus_fdstore_remove(__names[i]);
+		free(__names[i]);
+		__names[i] = NULL;
+	}
+
+	free(__names);
+	__names = NULL;
+	__count = 0;
+}
+
+int peripheral_bus_fdstore_take(const char *name)
+{
+	RETVM_IF(name == NULL, -1, "Invalid fd name");
+
+	int i;
+
+	for (i = 0; i < __count; i++) {
+		if (__names[i] == NULL || strcmp(__names[i], name) != 0)
+			continue;
+
+		free(__names[i]);
+		__names[i] = NULL;
+
+		return SD_LISTEN_FDS_START + i;
+	}
+
+	return -1;
+}
+
+int peripheral_bus_fdstore_put(const char *name, int fd)
+{
+	RETVM_IF(name == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd name");
+	RETVM_IF(fd < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd");
+
+	char state[FDSTORE_STATE_LEN];
+	int ret;
+
+	snprintf(state, FDSTORE_STATE_LEN, "FDSTORE=1\nFDNAME=%s", name);
+
+	ret = sd_pid_notify_with_fds(0, 0, state, &fd, 1);
+	if (ret <= 0) {
+		/* Not running under systemd or no store configured, only restarts lose */
+		_D("Failed to store fd %s : %d", name, ret);
+		return PERIPHERAL_ERROR_NOT_SUPPORTED;
+	}
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_bus_fdstore_remove(const char *name)
+{
+	RET_IF(name == NULL);
+
+	sd_notifyf(0, "FDSTOREREMOVE=1\nFDNAME=%s", name);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "peripheral_log.h"
+#include "peripheral_idle.h"
+
+static unsigned int __timeout;
+static unsigned int __holds;
+static guint __timer_id;
+static gint64 __start_time;
+static bool __served;
+static peripheral_bus_idle_cb __cb;
+static void *__cb_data;
+
+static gboolean __idle_expired(gpointer user_data)
+{
+	__timer_id = 0;
+
+	_D("No handle open for %u seconds, exiting", __timeout);
+	__cb(__cb_data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void __idle_arm(void)
+{
+	if (__timer_id)
+		g_source_remove(__timer_id);
+	__timer_id = 0;
+
+	if (__timeout == 0 || __holds > 0)
+		return;
+
+	__timer_id = g_timeout_add_seconds(__timeout, __idle_expired, NULL);
+}
+
+/* Time from start to the first request is what an activated client waits for */
+static void __idle_first_request(void)
+{
+	if (__served)
+		return;
+
+	__served = true;
+	_D("First request %lld ms after start",
+			(long long)((g_get_monotonic_time() - __start_time) / 1000));
+}
+
+void peripheral_bus_idle_init(unsigned int timeout, peripheral_bus_idle_cb cb, void *user_data)
+{
+	__start_time = g_get_monotonic_time();
+	__timeout = timeout;
+	__cb = cb;
+	__cb_data = user_data;
+
+	__idle_arm();
+}
+
+void peripheral_bus_idle_deinit(void)
+{
+	if (__timer_id)
+		g_source_remove(__timer_id);
+	__timer_id = 0;
+	__timeout = 0;
+}
+
+void peripheral_bus_idle_hold(void)
+{
+	__idle_first_request();
+
+	if (__holds++ == 0)
+		__idle_arm();
+}
+
+void peripheral_bus_idle_release(void)
+{
+	RETM_IF(__holds == 0, "Unbalanced idle release");
+
+	if (--__holds == 0)
+		__idle_arm();
+}
+
+void peripheral_bus_idle_touch(void)
+{
+	__idle_first_request();
+
+	if (__holds == 0)
+		__idle_arm();
+}
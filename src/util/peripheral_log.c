@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <glib.h>
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+
+/* A call site may log a burst of this many lines, then one a second */
+#define LOG_LIMIT_BURST 10
+#define LOG_LIMIT_PERIOD_MS 1000
+
+int peripheral_bus_log_level = PB_LOG_INFO;
+
+/* Call sites with suppressed messages not reported yet */
+static pb_log_limit_s *__pending;
+static bool __flush_armed;
+
+static const char *__level_names[] = {
+	[PB_LOG_ERROR] = "error",
+	[PB_LOG_WARN] = "warn",
+	[PB_LOG_INFO] = "info",
+	[PB_LOG_DEBUG] = "debug",
+};
+
+int peripheral_bus_log_set_level(const char *name)
+{
+	int level;
+
+	for (level = PB_LOG_ERROR; level <= PB_LOG_DEBUG; level++) {
+		if (strcasecmp(name, __level_names[level]) == 0) {
+			if (level > PERIPHERAL_BUS_LOG_LEVEL)
+				LOGW("Log level %s is not built in, messages stop at %s",
+						name, __level_names[PERIPHERAL_BUS_LOG_LEVEL]);
+			__atomic_store_n(&peripheral_bus_log_level, level, __ATOMIC_RELAXED);
+			return PERIPHERAL_ERROR_NONE;
+		}
+	}
+
+	LOGE("Unknown log level %s", name);
+	return PERIPHERAL_ERROR_INVALID_PARAMETER;
+}
+
+static uint64_t __now_ms(void)
+{
+	struct timespec ts;
+
+	/* Tick resolution is plenty here, and it does not leave the vDSO */
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void __log_refill(pb_log_limit_s *limit)
+{
+	uint64_t now = __now_ms();
+	uint64_t last = __atomic_load_n(&limit->last, __ATOMIC_RELAXED);
+	uint64_t refill;
+	uint32_t tokens;
+
+	if (last && now - last < LOG_LIMIT_PERIOD_MS)
+		return;
+
+	refill = last ? (now - last) / LOG_LIMIT_PERIOD_MS : LOG_LIMIT_BURST;
+	if (refill > LOG_LIMIT_BURST)
+		refill = LOG_LIMIT_BURST;
+
+	/* Only the thread that moves last on adds the tokens */
+	if (!__atomic_compare_exchange_n(&limit->last, &last, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return;
+
+	tokens = __atomic_load_n(&limit->tokens, __ATOMIC_RELAXED);
+	do {
+		if (tokens >= LOG_LIMIT_BURST)
+			return;
+	} while (!__atomic_compare_exchange_n(&limit->tokens, &tokens,
+			tokens + refill > LOG_LIMIT_BURST ? LOG_LIMIT_BURST : tokens + (uint32_t)refill,
+			false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static gboolean __log_flush(gpointer user_data)
+{
+	pb_log_limit_s *limit, *next;
+	unsigned int suppressed;
+
+	/* Disarmed first, a call site queued after the list is taken arms again */
+	__atomic_store_n(&__flush_armed, false, __ATOMIC_RELEASE);
+	limit = __atomic_exchange_n(&__pending, NULL, __ATOMIC_ACQUIRE);
+
+	for (; limit; limit = next) {
+		next = limit->next;
+		__atomic_store_n(&limit->pending, 0, __ATOMIC_RELEASE);
+
+		suppressed = __atomic_exchange_n(&limit->suppressed, 0, __ATOMIC_RELAXED);
+		if (suppressed == 0)
+			continue;
+
+		if (limit->log_level == PB_LOG_ERROR)
+			LOGE("%u messages suppressed at %s:%d", suppressed, limit->file, limit->line);
+		else
+			LOGW("%u messages suppressed at %s:%d", suppressed, limit->file, limit->line);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void __log_queue(pb_log_limit_s *limit)
+{
+	pb_log_limit_s *head;
+
+	if (__atomic_exchange_n(&limit->pending, 1, __ATOMIC_ACQUIRE))
+		return;
+
+	head = __atomic_load_n(&__pending, __ATOMIC_RELAXED);
+	do {
+		limit->next = head;
+	} while (!__atomic_compare_exchange_n(&__pending, &head, limit,
+			false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	/* Also called from worker threads, the timer runs on the main loop */
+	if (!__atomic_exchange_n(&__flush_armed, true, __ATOMIC_ACQ_REL))
+		g_timeout_add(LOG_LIMIT_PERIOD_MS, __log_flush, NULL);
+}
+
+bool peripheral_bus_log_allow(pb_log_limit_s *limit, unsigned int *suppressed)
+{
+	uint32_t tokens;
+
+	__log_refill(limit);
+
+	tokens = __atomic_load_n(&limit->tokens, __ATOMIC_RELAXED);
+	do {
+		if (tokens == 0) {
+			__atomic_add_fetch(&limit->suppressed, 1, __ATOMIC_RELAXED);
+			__log_queue(limit);
+			return false;
+		}
+	} while (!__atomic_compare_exchange_n(&limit->tokens, &tokens, tokens - 1,
+			false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	*suppressed = __atomic_exchange_n(&limit->suppressed, 0, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+const char *peripheral_bus_log_strerror(int err, char *buf, size_t len)
+{
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+	/* The GNU variant may return a static string instead of filling buf */
+	return strerror_r(err, buf, len);
+#else
+	if (strerror_r(err, buf, len) != 0)
+		snprintf(buf, len, "error %d", err);
+
+	return buf;
+#endif
+}
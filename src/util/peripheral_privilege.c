@@ -14,23 +14,40 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+#include <errno.h>
+#include <pwd.h>
 #include <cynara-creds-gdbus.h>
+#include <cynara-creds-socket.h>
 #include <cynara-client.h>
 #include <cynara-session.h>
 
 #include "peripheral_privilege.h"
 #include "peripheral_log.h"
+#include "peripheral_trace.h"
+#ifdef PERIPHERAL_BUS_SIMULATOR
+#include "peripheral_root.h"
+#endif
 
 #define PERIPHERAL_PRIVILEGE "http://tizen.org/privilege/peripheralio"
+#define PERIPHERAL_PRIVILEGE_ADMIN_USER "service_fw"
 
 #define CACHE_SIZE  100
 
 static cynara *__cynara;
+static uid_t __admin_uid;	/* root until the admin user is found */
 
 void peripheral_privilege_init(void)
 {
 	int err;
 	cynara_configuration* conf = NULL;
+	struct passwd *pw;
+
+	pw = getpwnam(PERIPHERAL_PRIVILEGE_ADMIN_USER);
+	if (pw != NULL)
+		__admin_uid = pw->pw_uid;
+	else
+		_W("No %s user, only root is an admin", PERIPHERAL_PRIVILEGE_ADMIN_USER);
 
 	err = cynara_configuration_create(&conf);
 	RETM_IF(err != CYNARA_API_SUCCESS, "Failed to create cynara configuration");
@@ -61,27 +78,61 @@ void peripheral_privilege_deinit(void)
 	_D("Cynara deinitialized");
 }
 
-int peripheral_privilege_check(GDBusMethodInvocation *invocation, GDBusConnection *connection)
+/* Peer connections have no bus to ask, the credentials come from the socket */
+static void __privilege_peer_creds(GDBusConnection *connection, char **session, char **client, char **user)
+{
+	GIOStream *stream;
+	pid_t pid;
+	int fd;
+
+	stream = g_dbus_connection_get_stream(connection);
+	RETM_IF(!G_IS_SOCKET_CONNECTION(stream), "Peer connection is not on a socket");
+
+	fd = g_socket_get_fd(g_socket_connection_get_socket(G_SOCKET_CONNECTION(stream)));
+
+	if (cynara_creds_socket_get_pid(fd, &pid) == CYNARA_API_SUCCESS)
+		*session = cynara_session_from_pid(pid);
+
+	cynara_creds_socket_get_client(fd, CLIENT_METHOD_DEFAULT, client);
+	cynara_creds_socket_get_user(fd, USER_METHOD_DEFAULT, user);
+}
+
+static int __privilege_check(GDBusMethodInvocation *invocation)
 {
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	/* Benchmarks run the daemon below a root of their own, without cynara */
+	if (peripheral_bus_root_is_set())
+		return 0;
+#endif
+
 	RETVM_IF(!__cynara, -1, "Cynara does not initialized");
 
 	int ret;
 	int pid;
 	const char *sender;
+	GDBusConnection *connection;
 	char *session = NULL;
 	char *client = NULL;
 	char *user = NULL;
 
+	connection = g_dbus_method_invocation_get_connection(invocation);
 	sender = g_dbus_method_invocation_get_sender(invocation);
 
-	cynara_creds_gdbus_get_pid(connection, sender, &pid);
-	session = cynara_session_from_pid(pid);
+	if (sender == NULL) {
+		__privilege_peer_creds(connection, &session, &client, &user);
+	} else {
+		cynara_creds_gdbus_get_pid(connection, sender, &pid);
+		session = cynara_session_from_pid(pid);
 
-	cynara_creds_gdbus_get_client(connection, sender, CLIENT_METHOD_DEFAULT, &client);
-	cynara_creds_gdbus_get_user(connection, sender, USER_METHOD_DEFAULT, &user);
+		cynara_creds_gdbus_get_client(connection, sender, CLIENT_METHOD_DEFAULT, &client);
+		cynara_creds_gdbus_get_user(connection, sender, USER_METHOD_DEFAULT, &user);
+	}
 
 	if (!session || !client || !user) {
 		_E("Failed to get client info");
+		g_free(session);
+		g_free(client);
+		g_free(user);
 		return -1;
 	}
 
@@ -100,3 +151,79 @@ int peripheral_privilege_check(GDBusMethodInvocation *invocation, GDBusConnectio
 
 	return 0;
 }
+
+int peripheral_privilege_check(GDBusMethodInvocation *invocation)
+{
+	int ret;
+
+	/* The sender is NULL on peer connections */
+	PB_TRACE(privilege_check_entry, g_dbus_method_invocation_get_sender(invocation));
+	ret = __privilege_check(invocation);
+	PB_TRACE(privilege_check_return, ret);
+
+	return ret;
+}
+
+static int __privilege_get_uid(GDBusMethodInvocation *invocation, uid_t *uid)
+{
+	GDBusConnection *connection;
+	GIOStream *stream;
+	const char *sender;
+	char *user = NULL;
+	char *end;
+	unsigned long value;
+	int fd;
+	int ret;
+
+	connection = g_dbus_method_invocation_get_connection(invocation);
+	sender = g_dbus_method_invocation_get_sender(invocation);
+
+	if (sender == NULL) {
+		stream = g_dbus_connection_get_stream(connection);
+		RETVM_IF(!G_IS_SOCKET_CONNECTION(stream), -1, "Peer connection is not on a socket");
+
+		fd = g_socket_get_fd(g_socket_connection_get_socket(G_SOCKET_CONNECTION(stream)));
+		ret = cynara_creds_socket_get_user(fd, USER_METHOD_UID, &user);
+	} else {
+		ret = cynara_creds_gdbus_get_user(connection, sender, USER_METHOD_UID, &user);
+	}
+
+	if (ret != CYNARA_API_SUCCESS || user == NULL) {
+		_E("Failed to get client uid");
+		g_free(user);
+		return -1;
+	}
+
+	errno = 0;
+	value = strtoul(user, &end, 10);
+	if (errno != 0 || end == user || *end != '\0') {
+		_E("Invalid client uid : %s", user);
+		g_free(user);
+		return -1;
+	}
+	g_free(user);
+
+	*uid = (uid_t)value;
+
+	return 0;
+}
+
+int peripheral_privilege_check_admin(GDBusMethodInvocation *invocation)
+{
+	uid_t uid;
+
+#ifdef PERIPHERAL_BUS_SIMULATOR
+	if (peripheral_bus_root_is_set())
+		return 0;
+#endif
+
+	if (__privilege_get_uid(invocation, &uid) != 0)
+		return -1;
+
+	if (uid != 0 && uid != __admin_uid) {
+		_E("uid %u is not an admin", (unsigned int)uid);
+		return -EACCES;
+	}
+
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib-unix.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_root.h"
+#include "peripheral_recorder.h"
+
+#define RECORDER_SIZE		1024	/* a power of two */
+#define RECORDER_SENDER_LEN	16
+#define RECORDER_DIR		"/run/peripheral-bus"
+#define RECORDER_PATH		RECORDER_DIR "/records.csv"
+#define RECORDER_TMP_PATH	RECORDER_PATH ".tmp"
+#define RECORDER_PATH_MAX	256
+
+typedef struct {
+	uint64_t timestamp;
+	char sender[RECORDER_SENDER_LEN];
+	int32_t args[2];
+	int32_t result;
+	uint8_t type;
+	uint8_t method;
+	uint32_t phases[PB_STATS_PHASE_MAX];
+} pb_recorder_record_s;
+
+/* seq is 2 * index + 1 while the record is written, 2 * index + 2 after */
+typedef struct {
+	uint64_t seq;
+	pb_recorder_record_s record;
+} pb_recorder_slot_s;
+
+static const char *__recorder_methods[PB_RECORDER_METHOD_MAX] = {
+	[PB_RECORDER_OPEN] = "open",
+	[PB_RECORDER_CLOSE] = "close",
+};
+
+static pb_recorder_slot_s __ring[RECORDER_SIZE];
+static uint64_t __head;
+
+/* Requests are built up here and only copied into the ring once done */
+static __thread pb_recorder_record_s __current;
+
+static guint __signal_id;
+
+void peripheral_bus_recorder_begin(pb_board_dev_e type, pb_recorder_method_e method,
+		GDBusMethodInvocation *invocation, int arg0, int arg1)
+{
+	const char *sender;
+
+	memset(&__current, 0, sizeof(__current));
+
+	__current.timestamp = peripheral_bus_stats_now();
+	__current.type = type;
+	__current.method = method;
+	__current.args[0] = arg0;
+	__current.args[1] = arg1;
+
+	/* Peer connections have no unique name */
+	sender = g_dbus_method_invocation_get_sender(invocation);
+	g_strlcpy(__current.sender, sender ? sender : "peer", RECORDER_SENDER_LEN);
+}
+
+void peripheral_bus_recorder_phase(pb_stats_phase_e phase, uint64_t us)
+{
+	if (phase >= PB_STATS_PHASE_MAX)
+		return;
+
+	__current.phases[phase] += us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+void peripheral_bus_recorder_end(int result)
+{
+	pb_recorder_slot_s *slot;
+	uint64_t index;
+
+	__current.result = result;
+
+	index = __atomic_fetch_add(&__head, 1, __ATOMIC_RELAXED);
+	slot = &__ring[index & (RECORDER_SIZE - 1)];
+
+	__atomic_store_n(&slot->seq, 2 * index + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->record = __current;
+	__atomic_store_n(&slot->seq, 2 * index + 2, __ATOMIC_RELEASE);
+}
+
+/* Copies out a record, false if it is being written or was overwritten */
+static bool __recorder_read(uint64_t index, pb_recorder_record_s *record)
+{
+	pb_recorder_slot_s *slot = &__ring[index & (RECORDER_SIZE - 1)];
+	uint64_t seq;
+
+	seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	if (seq != 2 * index + 2)
+		return false;
+
+	*record = slot->record;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq;
+}
+
+static void __recorder_range(uint64_t *first, uint64_t *last)
+{
+	*last = __atomic_load_n(&__head, __ATOMIC_ACQUIRE);
+	*first = *last > RECORDER_SIZE ? *last - RECORDER_SIZE : 0;
+}
+
+GVariant *peripheral_bus_recorder_records(void)
+{
+	GVariantBuilder phases;
+	GVariantBuilder records;
+	GVariantBuilder durations;
+	pb_recorder_record_s record;
+	uint64_t index;
+	uint64_t last;
+	int phase;
+
+	g_variant_builder_init(&phases, G_VARIANT_TYPE("as"));
+	for (phase = 0; phase < PB_STATS_PHASE_MAX; phase++)
+		g_variant_builder_add(&phases, "s", peripheral_bus_stats_phase_name(phase));
+
+	g_variant_builder_init(&records, G_VARIANT_TYPE("a(tsssiiiau)"));
+	__recorder_range(&index, &last);
+	for (; index < last; index++) {
+		if (!__recorder_read(index, &record))
+			continue;
+
+		g_variant_builder_init(&durations, G_VARIANT_TYPE("au"));
+		for (phase = 0; phase < PB_STATS_PHASE_MAX; phase++)
+			g_variant_builder_add(&durations, "u", record.phases[phase]);
+
+		g_variant_builder_add(&records, "(tsssiii@au)",
+				(guint64)record.timestamp, record.sender,
+				peripheral_bus_stats_type_name(record.type), __recorder_methods[record.method],
+				record.args[0], record.args[1], record.result,
+				g_variant_builder_end(&durations));
+	}
+
+	return g_variant_new("(@as@a(tsssiiiau))", g_variant_builder_end(&phases), g_variant_builder_end(&records));
+}
+
+static int __recorder_dump(void)
+{
+	char path[RECORDER_PATH_MAX];
+	char tmp_path[RECORDER_PATH_MAX];
+	pb_recorder_record_s record;
+	struct timespec monotonic;
+	struct timespec realtime;
+	uint64_t index;
+	uint64_t last;
+	FILE *fp;
+	int phase;
+
+	peripheral_bus_root_path(path, RECORDER_PATH_MAX, RECORDER_DIR);
+	if (mkdir(path, 0755) != 0 && errno != EEXIST)
+		_E("Failed to create %s, errno : %d", path, errno);
+
+	peripheral_bus_root_path(path, RECORDER_PATH_MAX, RECORDER_PATH);
+	peripheral_bus_root_path(tmp_path, RECORDER_PATH_MAX, RECORDER_TMP_PATH);
+
+	fp = fopen(tmp_path, "w");
+	if (fp == NULL) {
+		_E("Failed to open %s, errno : %d", tmp_path, errno);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	/* Timestamps are monotonic, this pairs them with the wall clock */
+	clock_gettime(CLOCK_MONOTONIC, &monotonic);
+	clock_gettime(CLOCK_REALTIME, &realtime);
+	fprintf(fp, "# monotonic_us %" G_GUINT64_FORMAT " realtime %lld.%06ld\n",
+			(guint64)monotonic.tv_sec * 1000000 + monotonic.tv_nsec / 1000,
+			(long long)realtime.tv_sec, realtime.tv_nsec / 1000);
+
+	fprintf(fp, "timestamp_us,sender,interface,method,arg0,arg1,result");
+	for (phase = 0; phase < PB_STATS_PHASE_MAX; phase++)
+		fprintf(fp, ",%s_us", peripheral_bus_stats_phase_name(phase));
+	fprintf(fp, "\n");
+
+	__recorder_range(&index, &last);
+	for (; index < last; index++) {
+		if (!__recorder_read(index, &record))
+			continue;
+
+		fprintf(fp, "%" G_GUINT64_FORMAT ",%s,%s,%s,%d,%d,%d",
+				(guint64)record.timestamp, record.sender,
+				peripheral_bus_stats_type_name(record.type), __recorder_methods[record.method],
+				record.args[0], record.args[1], record.result);
+		for (phase = 0; phase < PB_STATS_PHASE_MAX; phase++)
+			fprintf(fp, ",%u", record.phases[phase]);
+		fprintf(fp, "\n");
+	}
+
+	if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+		_E("Failed to write %s, errno : %d", path, errno);
+		unlink(tmp_path);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	_D("Dumped the flight recorder to %s", path);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static gboolean __recorder_on_signal(gpointer user_data)
+{
+	__recorder_dump();
+
+	return G_SOURCE_CONTINUE;
+}
+
+int peripheral_bus_recorder_init(void)
+{
+	RETV_IF(__signal_id != 0, PERIPHERAL_ERROR_NONE);
+
+	__signal_id = g_unix_signal_add(SIGUSR1, __recorder_on_signal, NULL);
+	RETVM_IF(__signal_id == 0, PERIPHERAL_ERROR_IO_ERROR, "Failed to watch SIGUSR1");
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_bus_recorder_deinit(void)
+{
+	if (__signal_id == 0)
+		return;
+
+	g_source_remove(__signal_id);
+	__signal_id = 0;
+}
@@ -0,0 +1,442 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <glib.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_registry.h"
+#include "peripheral_root.h"
+#include "peripheral_udev.h"
+#include "peripheral_log.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
+#endif
+
+#define REGISTRY_ARG_MAX	0xFFFFFF
+#define REGISTRY_PATH_MAX	256
+#define REGISTRY_KEY(type, arg0, arg1) \
+	(((gint64)(type) << 48) | ((gint64)(arg0) << 24) | (gint64)(arg1))
+
+typedef struct {
+	gint64 key;
+	pb_board_dev_s dev;
+	char *syspath;
+	char *path;	/* node opened for the device, NULL when opened by number */
+	int rank;	/* lower wins when two nodes map to the same device */
+} pb_registry_entry_s;
+
+/* tty names that map to a uart port, in order of preference */
+static const char *__registry_uart_prefixes[] = {
+#if defined(SDTA7D)
+	"ttymxc",
+#endif
+	"ttyS",
+	"ttyAMA",
+	"ttySAC",
+};
+
+typedef struct {
+	const char *subsystem;
+	void (*add)(struct udev_device *dev, const char *syspath);
+} pb_registry_subsystem_s;
+
+static GHashTable *__registry;
+
+static void __registry_entry_free(gpointer data)
+{
+	pb_registry_entry_s *entry = (pb_registry_entry_s*)data;
+
+	free(entry->syspath);
+	free(entry->path);
+	free(entry);
+}
+
+static void __registry_add(pb_board_dev_e dev_type, int arg0, int arg1, const char *syspath, const char *path, int rank)
+{
+	pb_registry_entry_s *entry;
+	gint64 key;
+
+	if (arg0 < 0 || arg0 > REGISTRY_ARG_MAX || arg1 < 0 || arg1 > REGISTRY_ARG_MAX) {
+		_W("Ignoring %s, args %d, %d are out of range", syspath, arg0, arg1);
+		return;
+	}
+
+	key = REGISTRY_KEY(dev_type, arg0, arg1);
+	entry = (pb_registry_entry_s*)g_hash_table_lookup(__registry, &key);
+	if (entry) {
+		if (entry->rank <= rank)
+			return;
+		g_hash_table_remove(__registry, &key);
+	}
+
+	entry = (pb_registry_entry_s*)calloc(1, sizeof(pb_registry_entry_s));
+	if (entry == NULL) {
+		_E("Failed to allocate pb_registry_entry_s");
+		return;
+	}
+
+	entry->syspath = strdup(syspath);
+	entry->path = path ? strdup(path) : NULL;
+	if (entry->syspath == NULL || (path && entry->path == NULL)) {
+		_E("Failed to duplicate device path");
+		__registry_entry_free(entry);
+		return;
+	}
+
+	entry->key = key;
+	entry->rank = rank;
+	entry->dev.dev_type = dev_type;
+	entry->dev.args[0] = arg0;
+	entry->dev.args[1] = arg1;
+
+	g_hash_table_insert(__registry, &entry->key, entry);
+}
+
+static gboolean __registry_match_syspath(gpointer key, gpointer value, gpointer user_data)
+{
+	pb_registry_entry_s *entry = (pb_registry_entry_s*)value;
+
+	return strcmp(entry->syspath, (const char*)user_data) == 0;
+}
+
+static void __registry_remove(const char *syspath)
+{
+	guint count;
+
+	count = g_hash_table_foreach_remove(__registry, __registry_match_syspath, (gpointer)syspath);
+	if (count > 0)
+		_D("%u devices of %s removed", count, syspath);
+}
+
+static int __registry_sysattr_int(struct udev_device *dev, const char *name, int *value)
+{
+	const char *str;
+	char *end;
+	long ret;
+
+	str = udev_device_get_sysattr_value(dev, name);
+	if (str == NULL)
+		return -ENOENT;
+
+	errno = 0;
+	ret = strtol(str, &end, 10);
+	if (end == str || errno != 0)
+		return -EINVAL;
+
+	*value = (int)ret;
+
+	return 0;
+}
+
+static void __registry_add_gpio(struct udev_device *dev, const char *syspath)
+{
+	int base, ngpio, i;
+
+	/* Only the legacy class devices carry base, the same numbering the sysfs interface uses */
+	if (__registry_sysattr_int(dev, "base", &base) < 0 || __registry_sysattr_int(dev, "ngpio", &ngpio) < 0)
+		return;
+
+	for (i = 0; i < ngpio; i++)
+		__registry_add(PB_BOARD_DEV_GPIO, base + i, 0, syspath, NULL, 0);
+}
+
+static void __registry_add_pwm(struct udev_device *dev, const char *syspath)
+{
+	int chip, npwm, i;
+
+	if (sscanf(udev_device_get_sysname(dev), "pwmchip%d", &chip) != 1)
+		return;
+
+	if (__registry_sysattr_int(dev, "npwm", &npwm) < 0)
+		return;
+
+	for (i = 0; i < npwm; i++)
+		__registry_add(PB_BOARD_DEV_PWM, chip, i, syspath, NULL, 0);
+}
+
+static void __registry_add_i2c(struct udev_device *dev, const char *syspath)
+{
+	int bus;
+
+	if (sscanf(udev_device_get_sysname(dev), "i2c-%d", &bus) == 1 && udev_device_get_devnode(dev))
+		__registry_add(PB_BOARD_DEV_I2C, bus, 0, syspath, udev_device_get_devnode(dev), 0);
+}
+
+static void __registry_add_spi(struct udev_device *dev, const char *syspath)
+{
+	int bus, cs;
+
+	if (sscanf(udev_device_get_sysname(dev), "spidev%d.%d", &bus, &cs) == 2 && udev_device_get_devnode(dev))
+		__registry_add(PB_BOARD_DEV_SPI, bus, cs, syspath, udev_device_get_devnode(dev), 0);
+}
+
+static void __registry_add_adc(struct udev_device *dev, const char *syspath)
+{
+	struct udev_list_entry *entry;
+	char path[REGISTRY_PATH_MAX];
+	const char *name;
+	int device, channel, length;
+
+	if (sscanf(udev_device_get_sysname(dev), "iio:device%d", &device) != 1)
+		return;
+
+	udev_list_entry_foreach(entry, udev_device_get_sysattr_list_entry(dev)) {
+		name = udev_list_entry_get_name(entry);
+		length = 0;
+		sscanf(name, "in_voltage%d_raw%n", &channel, &length);
+		if (length == 0 || name[length] != '\0')
+			continue;
+
+		if (snprintf(path, REGISTRY_PATH_MAX, "%s/%s", syspath, name) >= REGISTRY_PATH_MAX) {
+			_E("Path of %s/%s is too long", syspath, name);
+			continue;
+		}
+		__registry_add(PB_BOARD_DEV_ADC, device, channel, syspath, path, 0);
+	}
+}
+
+static void __registry_add_uart(struct udev_device *dev, const char *syspath)
+{
+	const char *sysname = udev_device_get_sysname(dev);
+	const char *devnode = udev_device_get_devnode(dev);
+	const char *type;
+	int i, port, length;
+	size_t prefix_len;
+
+	if (devnode == NULL)
+		return;
+
+	/* serial8250 registers ports that have no UART behind them */
+	type = udev_device_get_sysattr_value(dev, "type");
+	if (type && strcmp(type, "0") == 0)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(__registry_uart_prefixes); i++) {
+		prefix_len = strlen(__registry_uart_prefixes[i]);
+		if (strncmp(sysname, __registry_uart_prefixes[i], prefix_len) != 0)
+			continue;
+
+		length = 0;
+		sscanf(sysname + prefix_len, "%d%n", &port, &length);
+		if (length > 0 && sysname[prefix_len + length] == '\0') {
+			/* Earlier prefixes win, as when the nodes were probed in this order */
+			__registry_add(PB_BOARD_DEV_UART, port, 0, syspath, devnode, i);
+			return;
+		}
+	}
+}
+
+static const pb_registry_subsystem_s __registry_subsystems[] = {
+	{"gpio", __registry_add_gpio},
+	{"pwm", __registry_add_pwm},
+	{"i2c-dev", __registry_add_i2c},
+	{"spidev", __registry_add_spi},
+	{"iio", __registry_add_adc},
+	{"tty", __registry_add_uart},
+};
+
+static void __registry_udev_changed(const char *action, struct udev_device *dev, void *user_data)
+{
+	const pb_registry_subsystem_s *subsystem = (const pb_registry_subsystem_s*)user_data;
+	const char *syspath = udev_device_get_syspath(dev);
+
+	if (__registry == NULL || syspath == NULL || udev_device_get_sysname(dev) == NULL)
+		return;
+
+	if (strcmp(action, "add") == 0) {
+		subsystem->add(dev, syspath);
+	} else if (strcmp(action, "remove") == 0) {
+		__registry_remove(syspath);
+	} else if (strcmp(action, "change") == 0) {
+		/* e.g. IIO channels appearing once a driver finished probing */
+		__registry_remove(syspath);
+		subsystem->add(dev, syspath);
+	}
+}
+
+int peripheral_bus_registry_init(void)
+{
+	const pb_registry_subsystem_s *subsystem;
+	int i, ret;
+
+	__registry = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, __registry_entry_free);
+
+	for (i = 0; i < ARRAY_SIZE(__registry_subsystems); i++) {
+		subsystem = &__registry_subsystems[i];
+
+		/* Listen first, a device added meanwhile is then reported twice rather than never */
+		ret = peripheral_bus_udev_add_listener(subsystem->subsystem, __registry_udev_changed, (void*)subsystem);
+		if (ret != PERIPHERAL_ERROR_NONE) {
+			_E("Failed to listen to %s devices", subsystem->subsystem);
+			goto err;
+		}
+
+		ret = peripheral_bus_udev_enumerate(subsystem->subsystem, __registry_udev_changed, (void*)subsystem);
+		if (ret != PERIPHERAL_ERROR_NONE) {
+			_E("Failed to enumerate %s devices", subsystem->subsystem);
+			goto err;
+		}
+	}
+
+	_D("%u devices registered from udev", g_hash_table_size(__registry));
+
+	return PERIPHERAL_ERROR_NONE;
+
+err:
+	peripheral_bus_registry_deinit();
+	return ret;
+}
+
+void peripheral_bus_registry_deinit(void)
+{
+	if (__registry) {
+		g_hash_table_destroy(__registry);
+		__registry = NULL;
+	}
+}
+
+const pb_board_dev_s *peripheral_bus_registry_find(pb_board_dev_e dev_type, int arg0, int arg1)
+{
+	pb_registry_entry_s *entry;
+	gint64 key;
+
+	if (__registry == NULL)
+		return NULL;
+
+	if (arg0 < 0 || arg0 > REGISTRY_ARG_MAX || arg1 < 0 || arg1 > REGISTRY_ARG_MAX)
+		return NULL;
+
+	key = REGISTRY_KEY(dev_type, arg0, arg1);
+	entry = (pb_registry_entry_s*)g_hash_table_lookup(__registry, &key);
+
+	return entry ? &entry->dev : NULL;
+}
+
+/* Conventional node of a device, used when udev has not reported it */
+/* A truncated path would open nothing, or the wrong node */
+static bool __registry_path_fits(int length, size_t len)
+{
+	if (length < 0 || (size_t)length >= len) {
+		_E("Device path does not fit in %zu bytes", len);
+		return false;
+	}
+
+	return true;
+}
+
+static int __registry_probe(pb_board_dev_e dev_type, int arg0, int arg1, char *path, size_t len)
+{
+	int i, length;
+
+	switch (dev_type) {
+	case PB_BOARD_DEV_I2C:
+		length = peripheral_bus_root_path(path, len, "/dev/i2c-%d", arg0);
+		break;
+	case PB_BOARD_DEV_SPI:
+		length = peripheral_bus_root_path(path, len, "/dev/spidev%d.%d", arg0, arg1);
+		break;
+	case PB_BOARD_DEV_ADC:
+		length = peripheral_bus_root_path(path, len, "/sys/bus/iio/devices/iio:device%d/in_voltage%d_raw", arg0, arg1);
+		break;
+	case PB_BOARD_DEV_UART:
+		for (i = 0; i < ARRAY_SIZE(__registry_uart_prefixes); i++) {
+			length = peripheral_bus_root_path(path, len, "/dev/%s%d", __registry_uart_prefixes[i], arg0);
+			if (!__registry_path_fits(length, len))
+				return PERIPHERAL_ERROR_INVALID_PARAMETER;
+			if (access(path, F_OK) == 0)
+				return PERIPHERAL_ERROR_NONE;
+		}
+		return PERIPHERAL_ERROR_NO_DEVICE;
+	default:
+		/* gpio and pwm are addressed by number through their sysfs class */
+		return PERIPHERAL_ERROR_NOT_SUPPORTED;
+	}
+
+	if (!__registry_path_fits(length, len))
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	if (access(path, F_OK) != 0)
+		return PERIPHERAL_ERROR_NO_DEVICE;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_bus_registry_resolve(pb_board_dev_e dev_type, int arg0, int arg1, char *path, size_t len)
+{
+	RETVM_IF(path == NULL || len == 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid path buffer");
+	RETVM_IF(arg0 < 0 || arg1 < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid device args");
+
+	pb_registry_entry_s *entry = NULL;
+	gint64 key;
+	int ret;
+
+	if (__registry && arg0 <= REGISTRY_ARG_MAX && arg1 <= REGISTRY_ARG_MAX) {
+		key = REGISTRY_KEY(dev_type, arg0, arg1);
+		entry = (pb_registry_entry_s*)g_hash_table_lookup(__registry, &key);
+	}
+
+	if (entry && entry->path) {
+		if (!__registry_path_fits(snprintf(path, len, "%s", entry->path), len))
+			return PERIPHERAL_ERROR_INVALID_PARAMETER;
+		return PERIPHERAL_ERROR_NONE;
+	}
+
+	/* Not reported yet, or no udev at all */
+	ret = __registry_probe(dev_type, arg0, arg1, path, len);
+	if (ret == PERIPHERAL_ERROR_NO_DEVICE)
+		_E("No device node for type %d, args %d, %d", dev_type, arg0, arg1);
+
+	return ret;
+}
+
+static int __registry_open_path(const char *path, int flags, int *fd_out)
+{
+	int fd;
+
+	fd = open(path, flags | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno == EAGAIN)
+			return PERIPHERAL_ERROR_TRY_AGAIN;
+		_E_ERRNO(errno, "Failed to open %s", path);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	*fd_out = fd;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_bus_registry_open(pb_board_dev_e dev_type, int arg0, int arg1, int flags, int *fd_out)
+{
+	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out");
+
+	char path[REGISTRY_PATH_MAX];
+	int ret;
+
+	ret = peripheral_bus_registry_resolve(dev_type, arg0, arg1, path, REGISTRY_PATH_MAX);
+	if (ret != PERIPHERAL_ERROR_NONE)
+		return ret;
+
+	return __registry_open_path(path, flags, fd_out);
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_ring.h"
+#include "peripheral_log.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC		0x0001U
+#define MFD_ALLOW_SEALING	0x0002U
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS	(1024 + 9)
+#define F_SEAL_SEAL	0x0001
+#define F_SEAL_SHRINK	0x0002
+#define F_SEAL_GROW	0x0004
+#endif
+
+#define RING_PATH_LEN	32
+
+static int __ring_memfd_create(const char *name)
+{
+	return syscall(__NR_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+}
+
+static unsigned int __ring_round_up_pow2(unsigned int value)
+{
+	unsigned int ret = 1;
+
+	while (ret < value)
+		ret <<= 1;
+
+	return ret;
+}
+
+uint64_t peripheral_bus_ring_get_timestamp(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int peripheral_bus_ring_create(const char *name, unsigned int payload_size, unsigned int slot_count, pb_ring_s **ring_out)
+{
+	RETVM_IF(name == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid ring name");
+	RETVM_IF(slot_count == 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid ring slot count");
+	RETVM_IF(ring_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid ring_out");
+
+	pb_ring_s *ring;
+	unsigned int slot_size;
+	void *addr;
+	int ret;
+
+	ring = (pb_ring_s*)calloc(1, sizeof(pb_ring_s));
+	if (ring == NULL) {
+		_E("Failed to allocate pb_ring_s");
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+
+	slot_count = __ring_round_up_pow2(slot_count);
+	slot_size = (sizeof(pb_ring_slot_s) + payload_size + 7) & ~7U;
+	ring->size = sizeof(pb_ring_header_s) + (size_t)slot_size * slot_count;
+
+	ring->fd = __ring_memfd_create(name);
+	if (ring->fd < 0) {
+		_E("Failed to create memfd for %s, errno : %d", name, errno);
+		free(ring);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	ret = ftruncate(ring->fd, ring->size);
+	if (ret < 0) {
+		_E("Failed to resize ring %s, errno : %d", name, errno);
+		goto err;
+	}
+
+	/* Clients map the ring, so its size must never change under them */
+	ret = fcntl(ring->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+	if (ret < 0) {
+		_E("Failed to seal ring %s, errno : %d", name, errno);
+		goto err;
+	}
+
+	addr = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if (addr == MAP_FAILED) {
+		_E("Failed to map ring %s, errno : %d", name, errno);
+		goto err;
+	}
+
+	ring->header = (pb_ring_header_s*)addr;
+	ring->slots = (uint8_t*)addr + sizeof(pb_ring_header_s);
+
+	ring->header->magic = PB_RING_MAGIC;
+	ring->header->version = PB_RING_VERSION;
+	ring->header->slot_size = slot_size;
+	ring->header->slot_count = slot_count;
+	ring->slot_size = slot_size;
+	ring->slot_count = slot_count;
+
+	*ring_out = ring;
+
+	return PERIPHERAL_ERROR_NONE;
+
+err:
+	close(ring->fd);
+	free(ring);
+	return PERIPHERAL_ERROR_IO_ERROR;
+}
+
+int peripheral_bus_ring_attach(int fd, pb_ring_s **ring_out)
+{
+	RETVM_IF(fd < 0, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid ring fd");
+	RETVM_IF(ring_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid ring_out");
+
+	pb_ring_s *ring;
+	pb_ring_header_s *header;
+	uint32_t slot_size, slot_count;
+	struct stat st;
+	void *addr;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(pb_ring_header_s)) {
+		_E("Invalid ring fd %d", fd);
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		_E("Failed to map ring fd %d, errno : %d", fd, errno);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	/* Read the geometry once, it is validated and kept as read */
+	header = (pb_ring_header_s*)addr;
+	slot_size = __atomic_load_n(&header->slot_size, __ATOMIC_RELAXED);
+	slot_count = __atomic_load_n(&header->slot_count, __ATOMIC_RELAXED);
+	if (header->magic != PB_RING_MAGIC || header->version != PB_RING_VERSION ||
+		slot_size < sizeof(pb_ring_slot_s) || slot_count == 0 || (slot_count & (slot_count - 1)) ||
+		sizeof(pb_ring_header_s) + (size_t)slot_size * slot_count != (size_t)st.st_size) {
+		_E("Ring fd %d does not hold a ring", fd);
+		munmap(addr, st.st_size);
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+	}
+
+	ring = (pb_ring_s*)calloc(1, sizeof(pb_ring_s));
+	if (ring == NULL) {
+		_E("Failed to allocate pb_ring_s");
+		munmap(addr, st.st_size);
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+
+	ring->fd = fd;
+	ring->size = st.st_size;
+	ring->slot_size = slot_size;
+	ring->slot_count = slot_count;
+	ring->header = header;
+	ring->slots = (uint8_t*)addr + sizeof(pb_ring_header_s);
+
+	*ring_out = ring;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_bus_ring_destroy(pb_ring_s *ring)
+{
+	if (ring == NULL)
+		return;
+
+	if (ring->header)
+		munmap(ring->header, ring->size);
+
+	close(ring->fd);
+	free(ring);
+}
+
+int peripheral_bus_ring_get_fd(pb_ring_s *ring, bool read_only, int *fd_out)
+{
+	RETVM_IF(ring == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid ring");
+	RETVM_IF(fd_out == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid fd_out for ring");
+
+	char path[RING_PATH_LEN];
+	int fd;
+
+	if (read_only) {
+		/* Reopening gives a new file description that cannot be mapped writable */
+		snprintf(path, RING_PATH_LEN, "/proc/self/fd/%d", ring->fd);
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+	} else {
+		fd = fcntl(ring->fd, F_DUPFD_CLOEXEC, 0);
+	}
+
+	if (fd < 0) {
+		_E("Failed to get ring fd, errno : %d", errno);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	*fd_out = fd;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+pb_ring_slot_s *peripheral_bus_ring_get_slot(pb_ring_s *ring, uint64_t pos)
+{
+	uint32_t index = pos & (ring->slot_count - 1);
+
+	return (pb_ring_slot_s*)(ring->slots + (size_t)index * ring->slot_size);
+}
+
+void peripheral_bus_ring_publish(pb_ring_s *ring, const void *data, unsigned int length, int result)
+{
+	uint64_t pos = ring->header->head;
+	pb_ring_slot_s *slot = peripheral_bus_ring_get_slot(ring, pos);
+	unsigned int max_length = ring->slot_size - sizeof(pb_ring_slot_s);
+
+	if (length > max_length)
+		length = max_length;
+
+	__atomic_store_n(&slot->seq, pos * 2 + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	slot->timestamp = peripheral_bus_ring_get_timestamp();
+	slot->length = length;
+	slot->result = result;
+	if (data && length > 0)
+		memcpy(slot + 1, data, length);
+
+	__atomic_store_n(&slot->seq, pos * 2 + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->header->head, pos + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_root.h"
+
+static char __root[PATH_MAX];
+static size_t __root_len;
+
+int peripheral_bus_root_init(const char *root)
+{
+	size_t len;
+
+	if (root == NULL || root[0] == '\0' || strcmp(root, "/") == 0) {
+		__root[0] = '\0';
+		__root_len = 0;
+		return PERIPHERAL_ERROR_NONE;
+	}
+
+	RETVM_IF(root[0] != '/', PERIPHERAL_ERROR_INVALID_PARAMETER, "Root %s is not absolute", root);
+
+	len = strlen(root);
+	while (len > 1 && root[len - 1] == '/')
+		len--;
+
+	RETVM_IF(len >= PATH_MAX, PERIPHERAL_ERROR_INVALID_PARAMETER, "Root %s is too long", root);
+
+	memcpy(__root, root, len);
+	__root[len] = '\0';
+	__root_len = len;
+
+	_D("Using %s as root", __root);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+bool peripheral_bus_root_is_set(void)
+{
+	return __root_len > 0;
+}
+
+const char *peripheral_bus_root_get(void)
+{
+	return __root_len > 0 ? __root : "/";
+}
+
+int peripheral_bus_root_path(char *path, size_t len, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	if (len <= __root_len) {
+		if (len > 0)
+			path[0] = '\0';
+		return -1;
+	}
+
+	memcpy(path, __root, __root_len);
+
+	va_start(ap, fmt);
+	ret = vsnprintf(path + __root_len, len - __root_len, fmt, ap);
+	va_end(ap);
+
+	return ret < 0 ? ret : ret + (int)__root_len;
+}
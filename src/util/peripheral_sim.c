@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_root.h"
+#include "peripheral_sim.h"
+
+#define SIM_PATH_MAX	256
+
+typedef struct {
+	const char *name;
+	const char *value;
+} pb_sim_attr_s;
+
+static const pb_sim_attr_s __sim_gpio_attrs[] = {
+	{"direction", "in\n"},
+	{"edge", "none\n"},
+	{"value", "0\n"},
+	{NULL, NULL},
+};
+
+static const pb_sim_attr_s __sim_pwm_attrs[] = {
+	{"period", "0\n"},
+	{"duty_cycle", "0\n"},
+	{"polarity", "normal\n"},
+	{"enable", "0\n"},
+	{NULL, NULL},
+};
+
+static unsigned int __latency_us;
+static bool __active;
+
+static int __sim_mkdirs(char *path)
+{
+	char *p;
+
+	for (p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+			_E("Failed to create %s, errno : %d", path, errno);
+			*p = '/';
+			return -1;
+		}
+		*p = '/';
+	}
+
+	return 0;
+}
+
+static int __sim_write(const char *path, const char *value)
+{
+	char dir[SIM_PATH_MAX];
+	int fd;
+	int ret;
+
+	snprintf(dir, SIM_PATH_MAX, "%s", path);
+	if (__sim_mkdirs(dir) < 0)
+		return -1;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd < 0) {
+		_E("Failed to create %s, errno : %d", path, errno);
+		return -1;
+	}
+
+	ret = write(fd, value, strlen(value));
+	close(fd);
+
+	return ret < 0 ? -1 : 0;
+}
+
+static int __sim_node(const char *fmt, int arg0, int arg1, const char *value)
+{
+	char path[SIM_PATH_MAX];
+
+	peripheral_bus_root_path(path, SIM_PATH_MAX, fmt, arg0, arg1);
+
+	return __sim_write(path, value);
+}
+
+static void __sim_remove(const char *dir, const pb_sim_attr_s *attrs)
+{
+	char path[SIM_PATH_MAX];
+	int i;
+
+	for (i = 0; attrs[i].name; i++) {
+		snprintf(path, SIM_PATH_MAX, "%s/%s", dir, attrs[i].name);
+		unlink(path);
+	}
+
+	rmdir(dir);
+}
+
+/* The attributes appear all at once, as they do when the kernel adds a device */
+static int __sim_export(const char *dir, const pb_sim_attr_s *attrs)
+{
+	char tmp[SIM_PATH_MAX];
+	char path[SIM_PATH_MAX];
+	int i;
+
+	if (access(dir, F_OK) == 0)
+		return PERIPHERAL_ERROR_RESOURCE_BUSY;
+
+	if (__latency_us)
+		usleep(__latency_us);
+
+	snprintf(tmp, SIM_PATH_MAX, "%s.tmp", dir);
+	if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+		_E("Failed to create %s, errno : %d", tmp, errno);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	for (i = 0; attrs[i].name; i++) {
+		snprintf(path, SIM_PATH_MAX, "%s/%s", tmp, attrs[i].name);
+		if (__sim_write(path, attrs[i].value) < 0) {
+			__sim_remove(tmp, attrs);
+			return PERIPHERAL_ERROR_IO_ERROR;
+		}
+	}
+
+	if (rename(tmp, dir) != 0) {
+		_E("Failed to move %s into place, errno : %d", dir, errno);
+		__sim_remove(tmp, attrs);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_bus_sim_init(pb_board_s *board, unsigned int latency_us)
+{
+	RETVM_IF(board == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid board");
+
+	const pb_board_dev_s *dev;
+	int ret = 0;
+	int i;
+
+	__latency_us = latency_us;
+
+	ret |= __sim_node("/sys/class/gpio/export", 0, 0, "");
+	ret |= __sim_node("/sys/class/gpio/unexport", 0, 0, "");
+
+	for (i = 0; i < board->num_dev; i++) {
+		dev = &board->dev[i];
+
+		switch (dev->dev_type) {
+		case PB_BOARD_DEV_I2C:
+			ret |= __sim_node("/dev/i2c-%d", dev->args[0], 0, "");
+			break;
+		case PB_BOARD_DEV_PWM:
+			ret |= __sim_node("/sys/class/pwm/pwmchip%d/export", dev->args[0], 0, "");
+			ret |= __sim_node("/sys/class/pwm/pwmchip%d/unexport", dev->args[0], 0, "");
+			break;
+		case PB_BOARD_DEV_ADC:
+			ret |= __sim_node("/sys/bus/iio/devices/iio:device%d/in_voltage%d_raw", dev->args[0], dev->args[1], "0\n");
+			break;
+		case PB_BOARD_DEV_UART:
+			ret |= __sim_node("/dev/ttyS%d", dev->args[0], 0, "");
+			break;
+		case PB_BOARD_DEV_SPI:
+			ret |= __sim_node("/dev/spidev%d.%d", dev->args[0], dev->args[1], "");
+			break;
+		default:
+			/* gpio pins show up when exported */
+			break;
+		}
+	}
+
+	RETVM_IF(ret != 0, PERIPHERAL_ERROR_IO_ERROR, "Failed to populate %s", peripheral_bus_root_get());
+
+	__active = true;
+
+	_D("Simulating %u devices below %s, export latency %u us", board->num_dev, peripheral_bus_root_get(), latency_us);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+bool peripheral_bus_sim_is_active(void)
+{
+	return __active;
+}
+
+int peripheral_bus_sim_gpio_export(int pin)
+{
+	char dir[SIM_PATH_MAX];
+
+	peripheral_bus_root_path(dir, SIM_PATH_MAX, "/sys/class/gpio/gpio%d", pin);
+
+	return __sim_export(dir, __sim_gpio_attrs);
+}
+
+int peripheral_bus_sim_gpio_unexport(int pin)
+{
+	char dir[SIM_PATH_MAX];
+
+	peripheral_bus_root_path(dir, SIM_PATH_MAX, "/sys/class/gpio/gpio%d", pin);
+	__sim_remove(dir, __sim_gpio_attrs);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_bus_sim_pwm_export(int chip, int pin)
+{
+	char dir[SIM_PATH_MAX];
+
+	peripheral_bus_root_path(dir, SIM_PATH_MAX, "/sys/class/pwm/pwmchip%d/pwm%d", chip, pin);
+
+	return __sim_export(dir, __sim_pwm_attrs);
+}
+
+int peripheral_bus_sim_pwm_unexport(int chip, int pin)
+{
+	char dir[SIM_PATH_MAX];
+
+	peripheral_bus_root_path(dir, SIM_PATH_MAX, "/sys/class/pwm/pwmchip%d/pwm%d", chip, pin);
+	__sim_remove(dir, __sim_pwm_attrs);
+
+	return PERIPHERAL_ERROR_NONE;
+}
@@ -0,0 +1,537 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_root.h"
+#include "peripheral_stats.h"
+#include "peripheral_recorder.h"
+#include "peripheral_timeline.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/*
+ * Log-linear buckets: exact below 4us, then 4 linear steps in every power
+ * of two, up to about a minute. The last bucket takes the rest.
+ */
+#define STATS_SUB_BUCKETS	4
+#define STATS_SUB_BITS		2
+#define STATS_OCTAVES		26
+#define STATS_BUCKETS		((STATS_OCTAVES - 1) * STATS_SUB_BUCKETS)
+
+#define STATS_PATH_MAX		108	/* sun_path */
+#define STATS_LABELS_MAX	64
+
+#define STATS_ADD(counter, n)	__atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+#define STATS_LOAD(counter)	__atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+typedef enum {
+	STATS_METHOD_OPEN = 0,
+	STATS_METHOD_CLOSE,
+	STATS_METHOD_MAX,
+} pb_stats_method_e;
+
+typedef struct {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t buckets[STATS_BUCKETS];
+} pb_stats_histogram_s;
+
+static const char *__stats_types[PB_BOARD_DEV_MAX] = {
+	[PB_BOARD_DEV_GPIO] = "gpio",
+	[PB_BOARD_DEV_I2C] = "i2c",
+	[PB_BOARD_DEV_PWM] = "pwm",
+	[PB_BOARD_DEV_ADC] = "adc",
+	[PB_BOARD_DEV_UART] = "uart",
+	[PB_BOARD_DEV_SPI] = "spi",
+};
+
+static const char *__stats_phases[PB_STATS_PHASE_MAX] = {
+	[PB_STATS_PHASE_PRIVILEGE] = "privilege",
+	[PB_STATS_PHASE_HANDLE_CREATE] = "handle_create",
+	[PB_STATS_PHASE_EXPORT] = "export",
+	[PB_STATS_PHASE_UDEV_WAIT] = "udev_wait",
+	[PB_STATS_PHASE_FD_OPEN] = "fd_open",
+	[PB_STATS_PHASE_REPLY] = "reply",
+	[PB_STATS_PHASE_OPEN] = "open",
+	[PB_STATS_PHASE_UNEXPORT] = "unexport",
+	[PB_STATS_PHASE_HANDLE_DESTROY] = "handle_destroy",
+	[PB_STATS_PHASE_CLOSE] = "close",
+};
+
+static const char *__stats_methods[STATS_METHOD_MAX] = {"open", "close"};
+
+/* Failures are counted by code, anything not listed counts as unknown */
+static const struct {
+	int code;
+	const char *name;
+} __stats_errors[] = {
+	{PERIPHERAL_ERROR_IO_ERROR, "io_error"},
+	{PERIPHERAL_ERROR_NO_DEVICE, "no_device"},
+	{PERIPHERAL_ERROR_TRY_AGAIN, "try_again"},
+	{PERIPHERAL_ERROR_OUT_OF_MEMORY, "out_of_memory"},
+	{PERIPHERAL_ERROR_PERMISSION_DENIED, "permission_denied"},
+	{PERIPHERAL_ERROR_RESOURCE_BUSY, "resource_busy"},
+	{PERIPHERAL_ERROR_INVALID_PARAMETER, "invalid_parameter"},
+	{PERIPHERAL_ERROR_NOT_SUPPORTED, "not_supported"},
+	{PERIPHERAL_ERROR_UNKNOWN, "unknown"},
+};
+
+#define STATS_ERRORS	ARRAY_SIZE(__stats_errors)
+
+typedef struct {
+	uint64_t requests[STATS_METHOD_MAX];
+	uint64_t failures[STATS_METHOD_MAX][STATS_ERRORS];
+	uint64_t vanished;
+} pb_stats_counters_s;
+
+static pb_stats_histogram_s __histograms[PB_BOARD_DEV_MAX][PB_STATS_PHASE_MAX];
+static pb_stats_counters_s __counters[PB_BOARD_DEV_MAX];
+static pb_stats_histogram_s __loop_delay;
+static uint64_t __loop_stalls;
+
+static GSocketService *__service;
+static char __path[STATS_PATH_MAX];
+static pb_stats_active_cb __active_cb;
+static gpointer __active_data;
+
+/* Where the next phase of the request on this thread starts */
+static __thread uint64_t __mark;
+
+const char *peripheral_bus_stats_type_name(pb_board_dev_e type)
+{
+	return type < PB_BOARD_DEV_MAX ? __stats_types[type] : "unknown";
+}
+
+const char *peripheral_bus_stats_phase_name(pb_stats_phase_e phase)
+{
+	return phase < PB_STATS_PHASE_MAX ? __stats_phases[phase] : "unknown";
+}
+
+uint64_t peripheral_bus_stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t peripheral_bus_stats_begin(void)
+{
+	__mark = peripheral_bus_stats_now();
+
+	return __mark;
+}
+
+uint64_t peripheral_bus_stats_mark(void)
+{
+	return __mark;
+}
+
+static unsigned int __stats_bucket(uint64_t us)
+{
+	unsigned int octave;
+	unsigned int index;
+
+	if (us < STATS_SUB_BUCKETS)
+		return us;
+
+	octave = 63 - __builtin_clzll(us);
+	index = (octave - 1) * STATS_SUB_BUCKETS + ((us >> (octave - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1));
+
+	return index < STATS_BUCKETS ? index : STATS_BUCKETS - 1;
+}
+
+/* Largest value a bucket counts */
+static uint64_t __stats_bucket_max(unsigned int index)
+{
+	unsigned int octave;
+	unsigned int sub;
+
+	if (index < STATS_SUB_BUCKETS)
+		return index;
+
+	if (index == STATS_BUCKETS - 1)
+		return UINT64_MAX;
+
+	octave = index / STATS_SUB_BUCKETS + 1;
+	sub = index % STATS_SUB_BUCKETS;
+
+	return ((uint64_t)(STATS_SUB_BUCKETS + sub + 1) << (octave - STATS_SUB_BITS)) - 1;
+}
+
+static void __stats_record(pb_stats_histogram_s *histogram, uint64_t us)
+{
+	STATS_ADD(histogram->count, 1);
+	STATS_ADD(histogram->sum, us);
+	STATS_ADD(histogram->buckets[__stats_bucket(us)], 1);
+}
+
+uint64_t peripheral_bus_stats_phase(pb_board_dev_e type, pb_stats_phase_e phase, uint64_t start)
+{
+	uint64_t now;
+
+	now = peripheral_bus_stats_now();
+	__mark = now;
+
+	RETVM_IF(type >= PB_BOARD_DEV_MAX || phase >= PB_STATS_PHASE_MAX, now, "Invalid stats phase");
+
+	__stats_record(&__histograms[type][phase], now - start);
+
+	peripheral_bus_recorder_phase(phase, now - start);
+
+	return now;
+}
+
+static void __stats_request(pb_board_dev_e type, pb_stats_method_e method, int result)
+{
+	int i;
+
+	RETM_IF(type >= PB_BOARD_DEV_MAX, "Invalid stats type");
+
+	STATS_ADD(__counters[type].requests[method], 1);
+
+	if (result == PERIPHERAL_ERROR_NONE)
+		return;
+
+	for (i = 0; i < STATS_ERRORS - 1; i++) {
+		if (__stats_errors[i].code == result)
+			break;
+	}
+
+	STATS_ADD(__counters[type].failures[method][i], 1);
+}
+
+void peripheral_bus_stats_open(pb_board_dev_e type, int result)
+{
+	__stats_request(type, STATS_METHOD_OPEN, result);
+}
+
+void peripheral_bus_stats_close(pb_board_dev_e type, int result)
+{
+	__stats_request(type, STATS_METHOD_CLOSE, result);
+}
+
+void peripheral_bus_stats_vanished(pb_board_dev_e type)
+{
+	RETM_IF(type >= PB_BOARD_DEV_MAX, "Invalid stats type");
+
+	STATS_ADD(__counters[type].vanished, 1);
+}
+
+void peripheral_bus_stats_loop_delay(uint64_t us)
+{
+	__stats_record(&__loop_delay, us);
+}
+
+void peripheral_bus_stats_loop_stall(void)
+{
+	STATS_ADD(__loop_stalls, 1);
+}
+
+static GVariant *__stats_failures(pb_board_dev_e type, pb_stats_method_e method)
+{
+	GVariantBuilder builder;
+	uint64_t count;
+	int i;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{st}"));
+	for (i = 0; i < STATS_ERRORS; i++) {
+		count = STATS_LOAD(__counters[type].failures[method][i]);
+		if (count)
+			g_variant_builder_add(&builder, "{st}", __stats_errors[i].name, count);
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+GVariant *peripheral_bus_stats_counters(const unsigned int active[PB_BOARD_DEV_MAX])
+{
+	GVariantBuilder builder;
+	int type;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sttta{st}a{st}u)"));
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++) {
+		g_variant_builder_add(&builder, "(ttt@a{st}@a{st}u)",
+				__stats_types[type],
+				STATS_LOAD(__counters[type].requests[STATS_METHOD_OPEN]),
+				STATS_LOAD(__counters[type].requests[STATS_METHOD_CLOSE]),
+				STATS_LOAD(__counters[type].vanished),
+				__stats_failures(type, STATS_METHOD_OPEN),
+				__stats_failures(type, STATS_METHOD_CLOSE),
+				active[type]);
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+GVariant *peripheral_bus_stats_histograms(void)
+{
+	GVariantBuilder bounds;
+	GVariantBuilder histograms;
+	GVariantBuilder buckets;
+	pb_stats_histogram_s *histogram;
+	int type;
+	int phase;
+	int i;
+
+	g_variant_builder_init(&bounds, G_VARIANT_TYPE("at"));
+	for (i = 0; i < STATS_BUCKETS; i++)
+		g_variant_builder_add(&bounds, "t", (guint64)__stats_bucket_max(i));
+
+	g_variant_builder_init(&histograms, G_VARIANT_TYPE("a(ssttat)"));
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++) {
+		for (phase = 0; phase < PB_STATS_PHASE_MAX; phase++) {
+			histogram = &__histograms[type][phase];
+			if (STATS_LOAD(histogram->count) == 0)
+				continue;
+
+			g_variant_builder_init(&buckets, G_VARIANT_TYPE("at"));
+			for (i = 0; i < STATS_BUCKETS; i++)
+				g_variant_builder_add(&buckets, "t", (guint64)STATS_LOAD(histogram->buckets[i]));
+
+			g_variant_builder_add(&histograms, "(sstt@at)",
+					__stats_types[type], __stats_phases[phase],
+					STATS_LOAD(histogram->count), STATS_LOAD(histogram->sum),
+					g_variant_builder_end(&buckets));
+		}
+	}
+
+	return g_variant_new("(@at@a(ssttat))", g_variant_builder_end(&bounds), g_variant_builder_end(&histograms));
+}
+
+/* labels go inside the braces, without a trailing comma, and may be empty */
+static void __stats_text_histogram(GString *text, const char *name, const char *labels, pb_stats_histogram_s *histogram)
+{
+	const char *sep = labels[0] ? "," : "";
+	uint64_t cumulative = 0;
+	int i;
+
+	if (STATS_LOAD(histogram->count) == 0)
+		return;
+
+	/* Only the ends of the powers of two, the sub-buckets are for Stats */
+	for (i = 0; i < STATS_BUCKETS - 1; i++) {
+		cumulative += STATS_LOAD(histogram->buckets[i]);
+		if (i >= STATS_SUB_BUCKETS && i % STATS_SUB_BUCKETS != STATS_SUB_BUCKETS - 1)
+			continue;
+
+		g_string_append_printf(text, "%s_bucket{%s%sle=\"%g\"} %" G_GUINT64_FORMAT "\n",
+				name, labels, sep, (__stats_bucket_max(i) + 1) / 1e6, (guint64)cumulative);
+	}
+
+	g_string_append_printf(text,
+			"%s_bucket{%s%sle=\"+Inf\"} %" G_GUINT64_FORMAT "\n"
+			"%s_sum{%s} %g\n"
+			"%s_count{%s} %" G_GUINT64_FORMAT "\n",
+			name, labels, sep, (guint64)STATS_LOAD(histogram->count),
+			name, labels, STATS_LOAD(histogram->sum) / 1e6,
+			name, labels, (guint64)STATS_LOAD(histogram->count));
+}
+
+gchar *peripheral_bus_stats_text(const unsigned int active[PB_BOARD_DEV_MAX])
+{
+	const pb_timeline_stage_s *stages;
+	int num_stages;
+	GString *text;
+	char labels[STATS_LABELS_MAX];
+	uint64_t count;
+	int type;
+	int method;
+	int phase;
+	int i;
+
+	text = g_string_new(NULL);
+
+	g_string_append(text, "# HELP peripheral_bus_requests_total Open and Close requests\n"
+			"# TYPE peripheral_bus_requests_total counter\n");
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++) {
+		for (method = 0; method < STATS_METHOD_MAX; method++) {
+			g_string_append_printf(text,
+					"peripheral_bus_requests_total{interface=\"%s\",method=\"%s\"} %" G_GUINT64_FORMAT "\n",
+					__stats_types[type], __stats_methods[method],
+					(guint64)STATS_LOAD(__counters[type].requests[method]));
+		}
+	}
+
+	g_string_append(text, "# HELP peripheral_bus_failures_total Failed requests by error\n"
+			"# TYPE peripheral_bus_failures_total counter\n");
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++) {
+		for (method = 0; method < STATS_METHOD_MAX; method++) {
+			for (i = 0; i < STATS_ERRORS; i++) {
+				count = STATS_LOAD(__counters[type].failures[method][i]);
+				if (count == 0)
+					continue;
+				g_string_append_printf(text,
+						"peripheral_bus_failures_total{interface=\"%s\",method=\"%s\",error=\"%s\"} %" G_GUINT64_FORMAT "\n",
+						__stats_types[type], __stats_methods[method], __stats_errors[i].name, (guint64)count);
+			}
+		}
+	}
+
+	g_string_append(text, "# HELP peripheral_bus_vanished_total Handles released because their client went away\n"
+			"# TYPE peripheral_bus_vanished_total counter\n");
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++) {
+		g_string_append_printf(text, "peripheral_bus_vanished_total{interface=\"%s\"} %" G_GUINT64_FORMAT "\n",
+				__stats_types[type], (guint64)STATS_LOAD(__counters[type].vanished));
+	}
+
+	g_string_append(text, "# HELP peripheral_bus_active_handles Open handles\n"
+			"# TYPE peripheral_bus_active_handles gauge\n");
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++) {
+		g_string_append_printf(text, "peripheral_bus_active_handles{interface=\"%s\"} %u\n",
+				__stats_types[type], active[type]);
+	}
+
+	g_string_append(text, "# HELP peripheral_bus_phase_seconds Time spent in each phase of Open and Close\n"
+			"# TYPE peripheral_bus_phase_seconds histogram\n");
+	for (type = 0; type < PB_BOARD_DEV_MAX; type++) {
+		for (phase = 0; phase < PB_STATS_PHASE_MAX; phase++) {
+			snprintf(labels, STATS_LABELS_MAX, "interface=\"%s\",phase=\"%s\"", __stats_types[type], __stats_phases[phase]);
+			__stats_text_histogram(text, "peripheral_bus_phase_seconds", labels, &__histograms[type][phase]);
+		}
+	}
+
+	g_string_append(text, "# HELP peripheral_bus_loop_delay_seconds How late the main loop ran its heartbeat\n"
+			"# TYPE peripheral_bus_loop_delay_seconds histogram\n");
+	__stats_text_histogram(text, "peripheral_bus_loop_delay_seconds", "", &__loop_delay);
+
+	g_string_append_printf(text, "# HELP peripheral_bus_loop_stalls_total Main loop stalls over the threshold\n"
+			"# TYPE peripheral_bus_loop_stalls_total counter\n"
+			"peripheral_bus_loop_stalls_total %" G_GUINT64_FORMAT "\n", (guint64)STATS_LOAD(__loop_stalls));
+
+	g_string_append(text, "# HELP peripheral_bus_startup_stage_seconds Time each startup stage took, from exec to READY\n"
+			"# TYPE peripheral_bus_startup_stage_seconds gauge\n");
+	num_stages = peripheral_bus_timeline_get(&stages);
+	for (i = 0; i < num_stages; i++) {
+		g_string_append_printf(text, "peripheral_bus_startup_stage_seconds{stage=\"%s\"} %g\n",
+				stages[i].name, stages[i].duration / 1e6);
+	}
+
+	return g_string_free(text, FALSE);
+}
+
+static gboolean __stats_incoming(GSocketService *service,
+		GSocketConnection *connection,
+		GObject *source_object,
+		gpointer user_data)
+{
+	unsigned int active[PB_BOARD_DEV_MAX] = {0, };
+	GOutputStream *out;
+	GError *error = NULL;
+	gchar *text;
+
+	if (__active_cb)
+		__active_cb(active, __active_data);
+
+	text = peripheral_bus_stats_text(active);
+
+	/* Scrapers are local and read everything at once, a synchronous write is fine */
+	out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+	if (!g_output_stream_write_all(out, text, strlen(text), NULL, NULL, &error)) {
+		_E("Failed to write stats : %s", error->message);
+		g_error_free(error);
+	}
+
+	g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+	g_free(text);
+
+	return TRUE;
+}
+
+int peripheral_bus_stats_listen(const char *path, pb_stats_active_cb cb, gpointer user_data)
+{
+	RETVM_IF(path == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid stats socket path");
+	RETV_IF(__service != NULL, PERIPHERAL_ERROR_NONE);
+
+	GSocketAddress *address;
+	GError *error = NULL;
+	mode_t mask;
+	gchar *dir;
+	gboolean ret;
+
+	peripheral_bus_root_path(__path, STATS_PATH_MAX, "%s", path);
+
+	dir = g_path_get_dirname(__path);
+	mkdir(dir, 0755);
+	g_free(dir);
+
+	/* A socket left behind by a previous instance would make the bind fail */
+	unlink(__path);
+
+	__service = g_socket_service_new();
+
+	/* Only root may scrape, the socket is never reachable with wider modes */
+	mask = umask(0177);
+	address = g_unix_socket_address_new(__path);
+	ret = g_socket_listener_add_address(G_SOCKET_LISTENER(__service), address, G_SOCKET_TYPE_STREAM,
+			G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error);
+	g_object_unref(address);
+	umask(mask);
+
+	if (ret && chmod(__path, 0600) != 0) {
+		_E("Failed to restrict %s, errno : %d", __path, errno);
+		g_socket_listener_close(G_SOCKET_LISTENER(__service));
+		g_object_unref(__service);
+		__service = NULL;
+		unlink(__path);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	if (!ret) {
+		_E("Failed to listen on %s : %s", __path, error->message);
+		g_error_free(error);
+		g_object_unref(__service);
+		__service = NULL;
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	__active_cb = cb;
+	__active_data = user_data;
+
+	g_signal_connect(__service, "incoming", G_CALLBACK(__stats_incoming), NULL);
+	g_socket_service_start(__service);
+
+	_D("Serving stats on %s", __path);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_bus_stats_unlisten(void)
+{
+	if (__service == NULL)
+		return;
+
+	g_socket_service_stop(__service);
+	g_socket_listener_close(G_SOCKET_LISTENER(__service));
+	g_object_unref(__service);
+	__service = NULL;
+
+	unlink(__path);
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <glib.h>
+
+#include "peripheral_log.h"
+#include "peripheral_timeline.h"
+
+#define TIMELINE_STAGES_MAX	32
+#define TIMELINE_STAT_LEN	1024
+#define TIMELINE_LINE_LEN	1024
+
+static pb_timeline_stage_s __stages[TIMELINE_STAGES_MAX];
+static int __num_stages;
+static uint64_t __exec;		/* monotonic us */
+static uint64_t __last;		/* monotonic us */
+static pthread_t __owner;
+static bool __active;
+
+static uint64_t __timeline_clock(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Microseconds since exec, only as precise as the clock ticks the kernel keeps it in */
+static uint64_t __timeline_since_exec(void)
+{
+	char buf[TIMELINE_STAT_LEN] = {0, };
+	unsigned long long starttime;
+	char *fields;
+	long ticks;
+	FILE *fp;
+	size_t len;
+	uint64_t boot;
+
+	fp = fopen("/proc/self/stat", "r");
+	if (fp == NULL)
+		return 0;
+
+	len = fread(buf, 1, TIMELINE_STAT_LEN - 1, fp);
+	fclose(fp);
+	buf[len] = '\0';
+
+	/* The command name may hold spaces and parentheses, fields resume after the last ')' */
+	fields = strrchr(buf, ')');
+	ticks = sysconf(_SC_CLK_TCK);
+	if (fields == NULL || ticks <= 0)
+		return 0;
+
+	/* starttime is field 22, the state after ')' is field 3 */
+	if (sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+			&starttime) != 1)
+		return 0;
+
+	boot = __timeline_clock(CLOCK_BOOTTIME);
+	starttime = starttime * 1000000 / ticks;
+
+	return boot > starttime ? boot - starttime : 0;
+}
+
+void peripheral_bus_timeline_init(void)
+{
+	__exec = __timeline_clock(CLOCK_MONOTONIC) - __timeline_since_exec();
+	__last = __exec;
+	__owner = pthread_self();
+	__num_stages = 0;
+	__active = true;
+
+	peripheral_bus_timeline_mark("exec");
+}
+
+void peripheral_bus_timeline_mark(const char *stage)
+{
+	pb_timeline_stage_s *entry;
+	uint64_t now;
+
+	if (!__active || !pthread_equal(__owner, pthread_self()))
+		return;
+
+	RETM_IF(__num_stages >= TIMELINE_STAGES_MAX, "Too many startup stages, %s is not timed", stage);
+
+	now = __timeline_clock(CLOCK_MONOTONIC);
+
+	entry = &__stages[__num_stages++];
+	entry->name = stage;
+	entry->start = __last - __exec;
+	entry->duration = now - __last;
+
+	__last = now;
+}
+
+void peripheral_bus_timeline_finish(void)
+{
+	char line[TIMELINE_LINE_LEN];
+	int len;
+	int i;
+
+	if (!__active)
+		return;
+
+	__active = false;
+
+	len = snprintf(line, TIMELINE_LINE_LEN, "startup total_us=%llu", (unsigned long long)(__last - __exec));
+	for (i = 0; i < __num_stages && len < TIMELINE_LINE_LEN; i++) {
+		len += snprintf(line + len, TIMELINE_LINE_LEN - len, " %s_us=%llu",
+				__stages[i].name, (unsigned long long)__stages[i].duration);
+	}
+
+	_I("%s", line);
+}
+
+int peripheral_bus_timeline_get(const pb_timeline_stage_s **stages)
+{
+	*stages = __stages;
+
+	return __num_stages;
+}
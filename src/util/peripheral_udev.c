@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <glib-unix.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_udev.h"
+#include "peripheral_log.h"
+
+typedef struct {
+	char *subsystem;
+	peripheral_bus_udev_cb callback;
+	void *user_data;
+} peripheral_bus_udev_listener_s;
+
+static struct udev *__udev;
+static struct udev_monitor *__monitor;
+static guint __monitor_source_id;
+static GList *__listener_list;
+
+static gboolean __peripheral_bus_udev_dispatch(gint fd, GIOCondition condition, gpointer user_data)
+{
+	peripheral_bus_udev_listener_s *listener;
+	struct udev_device *dev;
+	const char *subsystem;
+	const char *action;
+	GList *link;
+
+	dev = udev_monitor_receive_device(__monitor);
+	if (dev == NULL)
+		return G_SOURCE_CONTINUE;
+
+	subsystem = udev_device_get_subsystem(dev);
+	action = udev_device_get_action(dev);
+	if (subsystem == NULL || action == NULL)
+		goto out;
+
+	link = __listener_list;
+	while (link) {
+		listener = (peripheral_bus_udev_listener_s*)link->data;
+		if (strcmp(listener->subsystem, subsystem) == 0)
+			listener->callback(action, dev, listener->user_data);
+		link = g_list_next(link);
+	}
+
+out:
+	udev_device_unref(dev);
+
+	return G_SOURCE_CONTINUE;
+}
+
+int peripheral_bus_udev_init(void)
+{
+	int ret;
+
+	__udev = udev_new();
+	if (__udev == NULL) {
+		_E("Cannot create udev");
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	__monitor = udev_monitor_new_from_netlink(__udev, "udev");
+	if (__monitor == NULL) {
+		_E("Cannot create udev monitor");
+		goto err;
+	}
+
+	ret = udev_monitor_enable_receiving(__monitor);
+	if (ret < 0) {
+		_E("Failed to enable udev receiving");
+		goto err;
+	}
+
+	__monitor_source_id = g_unix_fd_add(udev_monitor_get_fd(__monitor), G_IO_IN, __peripheral_bus_udev_dispatch, NULL);
+
+	return PERIPHERAL_ERROR_NONE;
+
+err:
+	peripheral_bus_udev_deinit();
+	return PERIPHERAL_ERROR_IO_ERROR;
+}
+
+static void __peripheral_bus_udev_listener_free(gpointer data)
+{
+	peripheral_bus_udev_listener_s *listener = (peripheral_bus_udev_listener_s*)data;
+
+	free(listener->subsystem);
+	free(listener);
+}
+
+void peripheral_bus_udev_deinit(void)
+{
+	if (__monitor_source_id) {
+		g_source_remove(__monitor_source_id);
+		__monitor_source_id = 0;
+	}
+
+	g_list_free_full(__listener_list, __peripheral_bus_udev_listener_free);
+	__listener_list = NULL;
+
+	if (__monitor) {
+		udev_monitor_unref(__monitor);
+		__monitor = NULL;
+	}
+
+	if (__udev) {
+		udev_unref(__udev);
+		__udev = NULL;
+	}
+}
+
+int peripheral_bus_udev_add_listener(const char *subsystem, peripheral_bus_udev_cb callback, void *user_data)
+{
+	RETVM_IF(subsystem == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid udev subsystem");
+	RETVM_IF(callback == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid udev callback");
+	RETVM_IF(__monitor == NULL, PERIPHERAL_ERROR_IO_ERROR, "udev monitor is not initialized");
+
+	peripheral_bus_udev_listener_s *listener;
+	int ret;
+
+	listener = (peripheral_bus_udev_listener_s*)calloc(1, sizeof(peripheral_bus_udev_listener_s));
+	if (listener == NULL) {
+		_E("failed to allocate peripheral_bus_udev_listener_s");
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+
+	listener->subsystem = strdup(subsystem);
+	if (listener->subsystem == NULL) {
+		_E("failed to duplicate udev subsystem");
+		free(listener);
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+	listener->callback = callback;
+	listener->user_data = user_data;
+
+	/* Only wake up for subsystems somebody listens to */
+	ret = udev_monitor_filter_add_match_subsystem_devtype(__monitor, subsystem, NULL);
+	if (ret < 0 || udev_monitor_filter_update(__monitor) < 0) {
+		_E("Failed to add udev monitor filter for %s", subsystem);
+		__peripheral_bus_udev_listener_free(listener);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	__listener_list = g_list_append(__listener_list, listener);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_bus_udev_enumerate(const char *subsystem, peripheral_bus_udev_cb callback, void *user_data)
+{
+	RETVM_IF(subsystem == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid udev subsystem");
+	RETVM_IF(callback == NULL, PERIPHERAL_ERROR_INVALID_PARAMETER, "Invalid udev callback");
+	RETVM_IF(__udev == NULL, PERIPHERAL_ERROR_IO_ERROR, "udev is not initialized");
+
+	struct udev_enumerate *enumerate;
+	struct udev_list_entry *entry;
+	struct udev_device *dev;
+	int ret;
+
+	enumerate = udev_enumerate_new(__udev);
+	if (enumerate == NULL) {
+		_E("Cannot create udev enumerate");
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	ret = udev_enumerate_add_match_subsystem(enumerate, subsystem);
+	if (ret == 0)
+		ret = udev_enumerate_scan_devices(enumerate);
+	if (ret < 0) {
+		_E("Failed to enumerate %s devices", subsystem);
+		udev_enumerate_unref(enumerate);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	/* Existing devices are reported the way a hotplug would report them */
+	udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate)) {
+		dev = udev_device_new_from_syspath(__udev, udev_list_entry_get_name(entry));
+		if (dev == NULL)
+			continue;
+
+		callback("add", dev, user_data);
+		udev_device_unref(dev);
+	}
+
+	udev_enumerate_unref(enumerate);
+
+	return PERIPHERAL_ERROR_NONE;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glib.h>
+#include <systemd/sd-daemon.h>
+
+#include <peripheral_io.h>
+
+#include "peripheral_log.h"
+#include "peripheral_stats.h"
+#include "peripheral_watchdog.h"
+
+#define WATCHDOG_BEAT_MS		100
+#define WATCHDOG_THRESHOLD_MS		500
+
+typedef struct {
+	GThread *thread;
+	GMutex lock;
+	GCond cond;
+	bool stopping;
+	guint beat_id;
+	uint64_t threshold;	/* us */
+	uint64_t ping_interval;	/* us, 0 without a systemd watchdog */
+} pb_watchdog_s;
+
+static pb_watchdog_s __watchdog;
+
+/* Shared with the watchdog thread */
+static uint64_t __beat;
+static const char *__interface;
+static const char *__method;
+static uint64_t __entered;
+
+void peripheral_bus_watchdog_enter(const char *interface, const char *method)
+{
+	__atomic_store_n(&__interface, interface, __ATOMIC_RELAXED);
+	__atomic_store_n(&__method, method, __ATOMIC_RELAXED);
+	__atomic_store_n(&__entered, peripheral_bus_stats_now(), __ATOMIC_RELEASE);
+}
+
+void peripheral_bus_watchdog_leave(void)
+{
+	__atomic_store_n(&__entered, 0, __ATOMIC_RELEASE);
+}
+
+static gboolean __watchdog_beat(gpointer user_data)
+{
+	uint64_t now = peripheral_bus_stats_now();
+	uint64_t last = __atomic_load_n(&__beat, __ATOMIC_RELAXED);
+	uint64_t late = now - last;
+
+	/* Timeouts are scheduled from their last dispatch, anything over the period is delay */
+	late = late > WATCHDOG_BEAT_MS * 1000 ? late - WATCHDOG_BEAT_MS * 1000 : 0;
+	peripheral_bus_stats_loop_delay(late);
+
+	__atomic_store_n(&__beat, now, __ATOMIC_RELEASE);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void __watchdog_report(uint64_t now, uint64_t beat)
+{
+	const char *interface = __atomic_load_n(&__interface, __ATOMIC_RELAXED);
+	const char *method = __atomic_load_n(&__method, __ATOMIC_RELAXED);
+	uint64_t entered = __atomic_load_n(&__entered, __ATOMIC_ACQUIRE);
+
+	peripheral_bus_stats_loop_stall();
+
+	if (entered == 0) {
+		_E("Main loop stalled for %llu ms outside of any handler",
+				(unsigned long long)(now - beat) / 1000);
+		return;
+	}
+
+	_E("Main loop stalled for %llu ms, %s.%s has been running for %llu ms",
+			(unsigned long long)(now - beat) / 1000, interface, method,
+			(unsigned long long)(now - entered) / 1000);
+}
+
+static gpointer __watchdog_thread(gpointer data)
+{
+	pb_watchdog_s *watchdog = (pb_watchdog_s*)data;
+	uint64_t stalled = 0;	/* the beat a stall was reported after */
+	uint64_t pinged = 0;
+	uint64_t now;
+	uint64_t beat;
+
+	g_mutex_lock(&watchdog->lock);
+	while (!watchdog->stopping) {
+		g_cond_wait_until(&watchdog->cond, &watchdog->lock,
+				g_get_monotonic_time() + WATCHDOG_BEAT_MS * 1000);
+		if (watchdog->stopping)
+			break;
+
+		now = peripheral_bus_stats_now();
+		beat = __atomic_load_n(&__beat, __ATOMIC_ACQUIRE);
+
+		if (now - beat > watchdog->threshold) {
+			/* Once per stall, systemd goes without pings until the loop is back */
+			if (beat != stalled) {
+				stalled = beat;
+				__watchdog_report(now, beat);
+			}
+			continue;
+		}
+
+		if (stalled) {
+			_W("Main loop is running again after %llu ms",
+					(unsigned long long)(beat - stalled) / 1000);
+			stalled = 0;
+		}
+
+		if (watchdog->ping_interval && now - pinged >= watchdog->ping_interval) {
+			sd_notify(0, "WATCHDOG=1");
+			pinged = now;
+		}
+	}
+	g_mutex_unlock(&watchdog->lock);
+
+	return NULL;
+}
+
+int peripheral_bus_watchdog_init(unsigned int threshold_ms)
+{
+	pb_watchdog_s *watchdog = &__watchdog;
+	uint64_t usec = 0;
+
+	RETV_IF(watchdog->thread != NULL, PERIPHERAL_ERROR_NONE);
+
+	watchdog->threshold = (uint64_t)(threshold_ms ? threshold_ms : WATCHDOG_THRESHOLD_MS) * 1000;
+	watchdog->ping_interval = 0;
+
+	/* Pinging at half the timeout leaves systemd a margin */
+	if (sd_watchdog_enabled(0, &usec) > 0) {
+		watchdog->ping_interval = usec / 2;
+		if (watchdog->threshold >= watchdog->ping_interval) {
+			_W("Stall threshold lowered to %llu ms to fit the systemd watchdog",
+					(unsigned long long)watchdog->ping_interval / 2000);
+			watchdog->threshold = watchdog->ping_interval / 2;
+		}
+	}
+
+	__atomic_store_n(&__beat, peripheral_bus_stats_now(), __ATOMIC_RELEASE);
+
+	g_mutex_init(&watchdog->lock);
+	g_cond_init(&watchdog->cond);
+	watchdog->stopping = false;
+
+	watchdog->beat_id = g_timeout_add(WATCHDOG_BEAT_MS, __watchdog_beat, NULL);
+
+	watchdog->thread = g_thread_try_new("pbus-watchdog", __watchdog_thread, watchdog, NULL);
+	if (watchdog->thread == NULL) {
+		_E("Failed to start the watchdog thread");
+		g_source_remove(watchdog->beat_id);
+		watchdog->beat_id = 0;
+		g_cond_clear(&watchdog->cond);
+		g_mutex_clear(&watchdog->lock);
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+	}
+
+	_D("Watching the main loop, stall threshold %llu ms, systemd watchdog %s",
+			(unsigned long long)watchdog->threshold / 1000, watchdog->ping_interval ? "on" : "off");
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+void peripheral_bus_watchdog_deinit(void)
+{
+	pb_watchdog_s *watchdog = &__watchdog;
+
+	if (watchdog->thread == NULL)
+		return;
+
+	g_mutex_lock(&watchdog->lock);
+	watchdog->stopping = true;
+	g_cond_signal(&watchdog->cond);
+	g_mutex_unlock(&watchdog->lock);
+
+	g_thread_join(watchdog->thread);
+	watchdog->thread = NULL;
+
+	g_source_remove(watchdog->beat_id);
+	watchdog->beat_id = 0;
+
+	g_cond_clear(&watchdog->cond);
+	g_mutex_clear(&watchdog->lock);
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * pbus-bench: Open/Close throughput of every interface, against a daemon
+ * simulating the board below a temporary root on a private dbus-daemon,
+ * so that it runs on machines without peripherals.
+ *
+ *   pbus-bench [--iterations=N] [--latency=USEC] [--daemon=PATH]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#include "pbus_bench_common.h"
+
+#ifndef PBUS_BENCH_DAEMON
+#define PBUS_BENCH_DAEMON "peripheral-bus"
+#endif
+
+/* One device of every type */
+static const char __board_ini[] =
+	"[gpio]\n"
+	"gpio20 = 38\n"
+	"\n"
+	"[i2c]\n"
+	"i2c-1 = 3, 5\n"
+	"\n"
+	"[pwm]\n"
+	"pwmchip0/pwm0 = 12\n"
+	"\n"
+	"[adc]\n"
+	"iio:device0/in_voltage0_raw = 40\n"
+	"\n"
+	"[uart]\n"
+	"ttyS0 = 8, 10\n"
+	"\n"
+	"[spi]\n"
+	"spidev0.0 = 24, 23, 21, 19\n";
+
+typedef struct {
+	const char *type;
+	const char *path;
+	int nargs;
+	int args[2];
+} pbus_bench_iface_s;
+
+static const pbus_bench_iface_s __ifaces[] = {
+	{"gpio", PBUS_BENCH_GPIO_PATH, 1, {20, 0}},
+	{"i2c", PBUS_BENCH_I2C_PATH, 2, {1, 0x20}},
+	{"pwm", PBUS_BENCH_PWM_PATH, 2, {0, 0}},
+	{"adc", PBUS_BENCH_ADC_PATH, 2, {0, 0}},
+	{"uart", PBUS_BENCH_UART_PATH, 1, {0, 0}},
+	{"spi", PBUS_BENCH_SPI_PATH, 2, {0, 0}},
+};
+
+#define PBUS_BENCH_IFACES	(sizeof(__ifaces) / sizeof(__ifaces[0]))
+
+static gint __iterations = 1000;
+static gint __warmup = 50;
+static gint __latency;
+static gchar *__daemon;
+static gboolean __keep_root;
+
+static GOptionEntry __entries[] = {
+	{"iterations", 'n', 0, G_OPTION_ARG_INT, &__iterations, "Open/Close pairs per interface", "N"},
+	{"warmup", 'w', 0, G_OPTION_ARG_INT, &__warmup, "Unrecorded pairs before measuring", "N"},
+	{"latency", 'l', 0, G_OPTION_ARG_INT, &__latency, "Simulated sysfs export latency", "USEC"},
+	{"daemon", 'd', 0, G_OPTION_ARG_FILENAME, &__daemon, "peripheral-bus binary to run", "PATH"},
+	{"keep-root", 'k', 0, G_OPTION_ARG_NONE, &__keep_root, "Leave the simulated root behind", NULL},
+	{NULL}
+};
+
+static GVariant *__bench_open_args(const pbus_bench_iface_s *iface)
+{
+	if (iface->nargs == 1)
+		return g_variant_new("(i)", iface->args[0]);
+
+	return g_variant_new("(ii)", iface->args[0], iface->args[1]);
+}
+
+static void __bench_iface(GDBusConnection *connection, const pbus_bench_iface_s *iface,
+		pbus_bench_phase_s *open, pbus_bench_phase_s *close)
+{
+	guint handle;
+	uint64_t start;
+	int result;
+	int i;
+
+	for (i = -__warmup; i < __iterations; i++) {
+		start = pbus_bench_now();
+		result = pbus_bench_call(connection, iface->type, iface->path, "Open",
+				__bench_open_args(iface), G_VARIANT_TYPE("(ui)"), &handle, NULL);
+		if (i >= 0) {
+			if (result == 0)
+				pbus_bench_phase_add(open, pbus_bench_now() - start);
+			else
+				open->failures++;
+		}
+		if (result != 0)
+			continue;
+
+		start = pbus_bench_now();
+		result = pbus_bench_call(connection, iface->type, iface->path, "Close",
+				g_variant_new("(u)", handle), G_VARIANT_TYPE("(i)"), NULL, NULL);
+		if (i >= 0) {
+			if (result == 0)
+				pbus_bench_phase_add(close, pbus_bench_now() - start);
+			else
+				close->failures++;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	pbus_bench_phase_s phases[PBUS_BENCH_IFACES * 2];
+	pbus_bench_env_s env;
+	char name[32];
+	char latency[16];
+	const char *daemon_args[] = {"--simulate", "--sim-latency", latency, NULL};
+	int ret = EXIT_SUCCESS;
+	unsigned int i;
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, __entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+
+	if (__iterations <= 0 || __warmup < 0) {
+		g_printerr("Invalid iteration count\n");
+		return EXIT_FAILURE;
+	}
+
+	snprintf(latency, sizeof(latency), "%d", __latency);
+
+	memset(&env, 0, sizeof(env));
+	env.daemon = __daemon ? __daemon : PBUS_BENCH_DAEMON;
+	env.board_ini = __board_ini;
+	env.daemon_args = daemon_args;
+	env.keep_root = __keep_root;
+
+	if (pbus_bench_env_start(&env) < 0)
+		return EXIT_FAILURE;
+
+	printf("root %s, %d iterations, export latency %d us\n\n", env.root, __iterations, __latency);
+
+	for (i = 0; i < PBUS_BENCH_IFACES; i++) {
+		snprintf(name, sizeof(name), "%s.Open", __ifaces[i].type);
+		pbus_bench_phase_init(&phases[i * 2], name, __iterations);
+		snprintf(name, sizeof(name), "%s.Close", __ifaces[i].type);
+		pbus_bench_phase_init(&phases[i * 2 + 1], name, __iterations);
+
+		__bench_iface(env.connection, &__ifaces[i], &phases[i * 2], &phases[i * 2 + 1]);
+	}
+
+	pbus_bench_env_stop(&env);
+
+	pbus_bench_report(phases, PBUS_BENCH_IFACES * 2);
+
+	for (i = 0; i < PBUS_BENCH_IFACES * 2; i++) {
+		if (phases[i].failures)
+			ret = EXIT_FAILURE;
+		pbus_bench_phase_free(&phases[i]);
+	}
+
+	g_free(__daemon);
+
+	return ret;
+}
@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <gio/gunixfdlist.h>
+
+#include "pbus_bench_common.h"
+
+#ifndef SYSCONFDIR
+#define SYSCONFDIR "/etc"
+#endif
+
+#define PBUS_BENCH_START_TIMEOUT_MS	5000
+
+/* The daemon falls back to the ini of the unknown board */
+#define PBUS_BENCH_BOARD_MODEL	"unknown board"
+#define PBUS_BENCH_BOARD_INI	SYSCONFDIR "/peripheral-bus/pio_board_unknown.ini"
+
+uint64_t pbus_bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void pbus_bench_phase_init(pbus_bench_phase_s *phase, const char *name, unsigned int capacity)
+{
+	memset(phase, 0, sizeof(*phase));
+	snprintf(phase->name, sizeof(phase->name), "%s", name);
+	phase->samples = g_new(uint64_t, capacity);
+	phase->capacity = capacity;
+}
+
+void pbus_bench_phase_add(pbus_bench_phase_s *phase, uint64_t ns)
+{
+	if (phase->count < phase->capacity)
+		phase->samples[phase->count++] = ns;
+}
+
+void pbus_bench_phase_free(pbus_bench_phase_s *phase)
+{
+	g_free(phase->samples);
+	phase->samples = NULL;
+}
+
+static int __bench_compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+
+	return (x > y) - (x < y);
+}
+
+static double __bench_percentile(const pbus_bench_phase_s *phase, double p)
+{
+	unsigned int index;
+
+	if (phase->count == 0)
+		return 0;
+
+	index = (unsigned int)(p * phase->count + 0.999999);
+	if (index > 0)
+		index--;
+	if (index >= phase->count)
+		index = phase->count - 1;
+
+	return phase->samples[index] / 1000.0;
+}
+
+void pbus_bench_report(pbus_bench_phase_s *phases, unsigned int count)
+{
+	pbus_bench_phase_s *phase;
+	uint64_t total;
+	unsigned int i;
+	unsigned int j;
+
+	printf("%-16s %8s %8s %10s %10s %10s %10s\n",
+			"phase", "ops", "failed", "ops/s", "p50(us)", "p99(us)", "p999(us)");
+
+	for (i = 0; i < count; i++) {
+		phase = &phases[i];
+
+		qsort(phase->samples, phase->count, sizeof(uint64_t), __bench_compare);
+
+		total = 0;
+		for (j = 0; j < phase->count; j++)
+			total += phase->samples[j];
+
+		printf("%-16s %8u %8u %10.0f %10.1f %10.1f %10.1f\n",
+				phase->name, phase->count, phase->failures,
+				total ? phase->count * 1e9 / total : 0,
+				__bench_percentile(phase, 0.50),
+				__bench_percentile(phase, 0.99),
+				__bench_percentile(phase, 0.999));
+	}
+}
+
+int pbus_bench_write(const char *path, const char *value)
+{
+	int length = strlen(value);
+	int ret;
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+
+	ret = write(fd, value, length);
+	if (ret != length) {
+		ret = ret < 0 ? -errno : -EIO;
+		close(fd);
+		return ret;
+	}
+
+	close(fd);
+
+	return 0;
+}
+
+int pbus_bench_read(const char *path, char *buf, size_t len)
+{
+	int ret;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	ret = read(fd, buf, len - 1);
+	if (ret < 0) {
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	close(fd);
+
+	buf[ret] = '\0';
+	g_strchomp(buf);
+
+	return 0;
+}
+
+static int __bench_write_file(const char *root, const char *path, const char *contents)
+{
+	char full[PBUS_BENCH_PATH_MAX];
+	gchar *dir;
+	GError *error = NULL;
+
+	snprintf(full, sizeof(full), "%s%s", root, path);
+
+	dir = g_path_get_dirname(full);
+	g_mkdir_with_parents(dir, 0755);
+	g_free(dir);
+
+	if (!g_file_set_contents(full, contents, -1, &error)) {
+		g_printerr("Failed to write %s : %s\n", full, error->message);
+		g_error_free(error);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int __bench_remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+	return remove(path);
+}
+
+/* FTW_PHYS removes links to host directories, not what they point to */
+static void __bench_remove_root(const char *root)
+{
+	nftw(root, __bench_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static int __bench_make_root(pbus_bench_env_s *env)
+{
+	char link[PBUS_BENCH_PATH_MAX];
+	GError *error = NULL;
+	gchar *run;
+	int i;
+
+	env->root = g_dir_make_tmp("pbus-bench-XXXXXX", &error);
+	if (env->root == NULL) {
+		g_printerr("Failed to create the root : %s\n", error->message);
+		g_error_free(error);
+		return -1;
+	}
+
+	if (__bench_write_file(env->root, "/proc/device-tree/model", PBUS_BENCH_BOARD_MODEL) < 0 ||
+		__bench_write_file(env->root, PBUS_BENCH_BOARD_INI, env->board_ini) < 0)
+		return -1;
+
+	for (i = 0; env->host_dirs && env->host_dirs[i]; i++) {
+		snprintf(link, sizeof(link), "%s%s", env->root, env->host_dirs[i]);
+		if (symlink(env->host_dirs[i], link) < 0) {
+			g_printerr("Failed to link %s : %s\n", link, g_strerror(errno));
+			return -1;
+		}
+	}
+
+	run = g_build_filename(env->root, "run", NULL);
+	g_mkdir_with_parents(run, 0755);
+	g_free(run);
+
+	return 0;
+}
+
+/* A private bus, so that the benchmarks need no system bus policy */
+static int __bench_spawn_bus(pbus_bench_env_s *env)
+{
+	gchar *argv[] = {"dbus-daemon", "--session", "--nofork", "--print-address", NULL};
+	GError *error = NULL;
+	GIOChannel *channel;
+	gint out;
+
+	if (!g_spawn_async_with_pipes(NULL, argv, NULL,
+			G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+			NULL, NULL, &env->bus_pid, NULL, &out, NULL, &error)) {
+		g_printerr("Failed to start dbus-daemon : %s\n", error->message);
+		g_error_free(error);
+		return -1;
+	}
+
+	channel = g_io_channel_unix_new(out);
+	g_io_channel_set_close_on_unref(channel, TRUE);
+	if (g_io_channel_read_line(channel, &env->address, NULL, NULL, &error) != G_IO_STATUS_NORMAL) {
+		g_printerr("Failed to read the bus address : %s\n", error ? error->message : "EOF");
+		g_clear_error(&error);
+	}
+	g_io_channel_unref(channel);
+
+	if (env->address == NULL)
+		return -1;
+
+	g_strchomp(env->address);
+
+	return 0;
+}
+
+static int __bench_spawn_daemon(pbus_bench_env_s *env)
+{
+	GPtrArray *argv;
+	gchar **envp;
+	GError *error = NULL;
+	gboolean ret;
+	int i;
+
+	argv = g_ptr_array_new();
+	g_ptr_array_add(argv, (gpointer)env->daemon);
+	g_ptr_array_add(argv, "--root");
+	g_ptr_array_add(argv, env->root);
+	for (i = 0; env->daemon_args && env->daemon_args[i]; i++)
+		g_ptr_array_add(argv, (gpointer)env->daemon_args[i]);
+	g_ptr_array_add(argv, NULL);
+
+	envp = g_environ_setenv(g_get_environ(), "DBUS_SYSTEM_BUS_ADDRESS", env->address, TRUE);
+	ret = g_spawn_async(NULL, (gchar**)argv->pdata, envp, G_SPAWN_DO_NOT_REAP_CHILD,
+			NULL, NULL, &env->daemon_pid, &error);
+	g_strfreev(envp);
+	g_ptr_array_free(argv, TRUE);
+
+	if (!ret) {
+		g_printerr("Failed to start %s : %s\n", env->daemon, error->message);
+		g_error_free(error);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int __bench_wait_for_name(GDBusConnection *connection)
+{
+	GVariant *reply;
+	gboolean has_owner = FALSE;
+	int waited;
+
+	for (waited = 0; waited < PBUS_BENCH_START_TIMEOUT_MS; waited += 10) {
+		reply = g_dbus_connection_call_sync(connection, "org.freedesktop.DBus",
+				"/org/freedesktop/DBus", "org.freedesktop.DBus", "NameHasOwner",
+				g_variant_new("(s)", PBUS_BENCH_NAME), G_VARIANT_TYPE("(b)"),
+				G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+		if (reply) {
+			g_variant_get(reply, "(b)", &has_owner);
+			g_variant_unref(reply);
+		}
+
+		if (has_owner)
+			return 0;
+
+		g_usleep(10000);
+	}
+
+	g_printerr("%s did not show up on the bus\n", PBUS_BENCH_NAME);
+	return -1;
+}
+
+GDBusConnection *pbus_bench_env_connect(pbus_bench_env_s *env)
+{
+	GDBusConnection *connection;
+	GError *error = NULL;
+
+	connection = g_dbus_connection_new_for_address_sync(env->address,
+			G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+			NULL, NULL, &error);
+	if (connection == NULL) {
+		g_printerr("Failed to connect to %s : %s\n", env->address, error->message);
+		g_error_free(error);
+	}
+
+	return connection;
+}
+
+int pbus_bench_env_start(pbus_bench_env_s *env)
+{
+	if (__bench_make_root(env) < 0 || __bench_spawn_bus(env) < 0 || __bench_spawn_daemon(env) < 0)
+		goto error;
+
+	env->connection = pbus_bench_env_connect(env);
+	if (env->connection == NULL)
+		goto error;
+
+	if (__bench_wait_for_name(env->connection) < 0)
+		goto error;
+
+	return 0;
+
+error:
+	pbus_bench_env_stop(env);
+	return -1;
+}
+
+static void __bench_stop(GPid *pid)
+{
+	if (*pid <= 0)
+		return;
+
+	kill(*pid, SIGTERM);
+	waitpid(*pid, NULL, 0);
+	g_spawn_close_pid(*pid);
+	*pid = 0;
+}
+
+void pbus_bench_env_stop(pbus_bench_env_s *env)
+{
+	if (env->connection) {
+		g_object_unref(env->connection);
+		env->connection = NULL;
+	}
+
+	__bench_stop(&env->daemon_pid);
+	__bench_stop(&env->bus_pid);
+
+	if (env->root && !env->keep_root)
+		__bench_remove_root(env->root);
+
+	g_free(env->root);
+	env->root = NULL;
+	g_free(env->address);
+	env->address = NULL;
+}
+
+int pbus_bench_call_full(GDBusConnection *connection, const char *type, const char *path,
+		const char *method, GVariant *args, const GVariantType *reply_type, int timeout_ms,
+		guint *handle, GUnixFDList **fds_out, GError **error)
+{
+	gchar interface[64];
+	GUnixFDList *fds = NULL;
+	GVariant *reply;
+	gint result;
+
+	snprintf(interface, sizeof(interface), PBUS_BENCH_INTERFACE_PREFIX "%s", type);
+
+	reply = g_dbus_connection_call_with_unix_fd_list_sync(connection, PBUS_BENCH_NAME,
+			path, interface, method, args, reply_type,
+			G_DBUS_CALL_FLAGS_NONE, timeout_ms, NULL, &fds, NULL, error);
+	if (reply == NULL)
+		return -1;
+
+	if (handle)
+		g_variant_get(reply, "(ui)", handle, &result);
+	else
+		g_variant_get_child(reply, 0, "i", &result);
+
+	g_variant_unref(reply);
+
+	/* Received fds are closed with the list, unless the caller keeps it */
+	if (fds_out)
+		*fds_out = fds;
+	else if (fds)
+		g_object_unref(fds);
+
+	return result;
+}
+
+int pbus_bench_call(GDBusConnection *connection, const char *type, const char *path,
+		const char *method, GVariant *args, const GVariantType *reply_type,
+		guint *handle, GUnixFDList **fds_out)
+{
+	GError *error = NULL;
+	int result;
+
+	result = pbus_bench_call_full(connection, type, path, method, args, reply_type, -1,
+			handle, fds_out, &error);
+	if (error) {
+		g_printerr("%s.%s failed : %s\n", type, method, error->message);
+		g_error_free(error);
+	}
+
+	return result;
+}
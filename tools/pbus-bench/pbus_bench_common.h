@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PBUS_BENCH_COMMON_H__
+#define __PBUS_BENCH_COMMON_H__
+
+#include <stdint.h>
+#include <gio/gio.h>
+
+#define PBUS_BENCH_NAME			"org.tizen.peripheral_io"
+#define PBUS_BENCH_INTERFACE_PREFIX	"org.tizen.peripheral_io."
+#define PBUS_BENCH_PATH_MAX		256
+
+#define PBUS_BENCH_GPIO_PATH	"/Org/Tizen/Peripheral_io/Gpio"
+#define PBUS_BENCH_I2C_PATH	"/Org/Tizen/Peripheral_io/I2c"
+#define PBUS_BENCH_PWM_PATH	"/Org/Tizen/Peripheral_io/Pwm"
+#define PBUS_BENCH_ADC_PATH	"/Org/Tizen/Peripheral_io/Adc"
+#define PBUS_BENCH_UART_PATH	"/Org/Tizen/Peripheral_io/Uart"
+#define PBUS_BENCH_SPI_PATH	"/Org/Tizen/Peripheral_io/Spi"
+
+/* Latency samples of one phase, in nanoseconds */
+typedef struct {
+	char name[32];
+	uint64_t *samples;
+	unsigned int count;
+	unsigned int capacity;
+	unsigned int failures;
+} pbus_bench_phase_s;
+
+uint64_t pbus_bench_now(void);
+
+void pbus_bench_phase_init(pbus_bench_phase_s *phase, const char *name, unsigned int capacity);
+void pbus_bench_phase_add(pbus_bench_phase_s *phase, uint64_t ns);
+void pbus_bench_phase_free(pbus_bench_phase_s *phase);
+
+/* Prints ops/s and p50/p99/p999 of each phase, sorting its samples */
+void pbus_bench_report(pbus_bench_phase_s *phases, unsigned int count);
+
+/*
+ * A daemon on a private dbus-daemon, below a temporary root holding the
+ * board ini. Directories in host_dirs (e.g. "/sys") are links to the
+ * host's, so that the daemon reaches real drivers through the root.
+ */
+typedef struct {
+	const char *daemon;
+	const char *board_ini;
+	const char * const *host_dirs;
+	const char * const *daemon_args;
+	gboolean keep_root;
+
+	gchar *root;
+	gchar *address;
+	GPid bus_pid;
+	GPid daemon_pid;
+	GDBusConnection *connection;
+} pbus_bench_env_s;
+
+int pbus_bench_env_start(pbus_bench_env_s *env);
+void pbus_bench_env_stop(pbus_bench_env_s *env);
+
+/* Opens another connection to the private bus, e.g. one per client */
+GDBusConnection *pbus_bench_env_connect(pbus_bench_env_s *env);
+
+/*
+ * Calls method of the interface of type ("gpio", ...) at path. Returns
+ * the peripheral-io result of the reply, or -1 if the call itself failed.
+ * The handle is read from "(ui)" replies when handle is not NULL.
+ */
+int pbus_bench_call(GDBusConnection *connection, const char *type, const char *path,
+		const char *method, GVariant *args, const GVariantType *reply_type,
+		guint *handle, GUnixFDList **fds_out);
+
+/* As pbus_bench_call(), but quiet and with a timeout, for callers that count errors */
+int pbus_bench_call_full(GDBusConnection *connection, const char *type, const char *path,
+		const char *method, GVariant *args, const GVariantType *reply_type, int timeout_ms,
+		guint *handle, GUnixFDList **fds_out, GError **error);
+
+/* Writes value to a sysfs or configfs attribute */
+int pbus_bench_write(const char *path, const char *value);
+int pbus_bench_read(const char *path, char *buf, size_t len);
+
+#endif /* __PBUS_BENCH_COMMON_H__ */
@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * pbus-gpio-bench: GPIO latencies through the daemon on the kernel's
+ * gpio-sim, against the same lines requested straight from the gpiochip.
+ *
+ * Creates a simulated chip over configfs and a board ini listing its
+ * lines, then measures Open/Close and the time from flipping a line's
+ * pull to the wake-up of a client polling it. Needs root, configfs and
+ * the gpio-sim module, and a kernel with the sysfs gpio interface.
+ *
+ *   modprobe gpio-sim && pbus-gpio-bench [--iterations=N] [--edges=N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/gpio.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#include "pbus_bench_common.h"
+
+#ifndef PBUS_BENCH_DAEMON
+#define PBUS_BENCH_DAEMON "peripheral-bus"
+#endif
+
+#define GPIO_SIM_CONFIGFS	"/sys/kernel/config/gpio-sim"
+#define GPIO_SIM_PLATFORM	"/sys/devices/platform"
+#define GPIO_EDGE_TIMEOUT_MS	1000
+
+/* Order of the fds in a gpio Open reply */
+enum {
+	GPIO_FD_DIRECTION,
+	GPIO_FD_EDGE,
+	GPIO_FD_VALUE,
+};
+
+typedef struct {
+	char config[PBUS_BENCH_PATH_MAX];	/* configfs directory */
+	char dev_name[64];			/* gpio-sim.N */
+	char chip_name[64];			/* gpiochipN */
+	int base;				/* number of line 0 in sysfs */
+} pbus_gpio_sim_s;
+
+enum {
+	PHASE_OPEN,
+	PHASE_CLOSE,
+	PHASE_EDGE,
+	PHASE_DIRECT_OPEN,
+	PHASE_DIRECT_CLOSE,
+	PHASE_DIRECT_EDGE,
+	PHASE_MAX,
+};
+
+static const char *__phase_names[PHASE_MAX] = {
+	"gpio.Open",
+	"gpio.Close",
+	"gpio.edge",
+	"cdev.request",
+	"cdev.release",
+	"cdev.edge",
+};
+
+static gint __lines = 8;
+static gint __iterations = 1000;
+static gint __edges = 1000;
+static gchar *__daemon;
+static gboolean __keep_root;
+
+static GOptionEntry __entries[] = {
+	{"lines", 'L', 0, G_OPTION_ARG_INT, &__lines, "Lines of the simulated chip", "N"},
+	{"iterations", 'n', 0, G_OPTION_ARG_INT, &__iterations, "Open/Close pairs", "N"},
+	{"edges", 'e', 0, G_OPTION_ARG_INT, &__edges, "Edges to deliver", "N"},
+	{"daemon", 'd', 0, G_OPTION_ARG_FILENAME, &__daemon, "peripheral-bus binary to run", "PATH"},
+	{"keep-root", 'k', 0, G_OPTION_ARG_NONE, &__keep_root, "Leave the root behind", NULL},
+	{NULL}
+};
+
+static int __sim_attr(const pbus_gpio_sim_s *sim, const char *attr, const char *value)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", sim->config, attr);
+	ret = pbus_bench_write(path, value);
+	if (ret < 0)
+		g_printerr("Failed to write %s : %s\n", path, g_strerror(-ret));
+
+	return ret;
+}
+
+/* Finds the number sysfs gives line 0, from the legacy gpiochip<base> */
+static int __sim_find_base(pbus_gpio_sim_s *sim)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+	const gchar *entry;
+	GDir *dir;
+
+	snprintf(path, sizeof(path), GPIO_SIM_PLATFORM "/%s/%s/gpio", sim->dev_name, sim->chip_name);
+
+	dir = g_dir_open(path, 0, NULL);
+	if (dir == NULL) {
+		g_printerr("No %s, the kernel lacks the sysfs gpio interface\n", path);
+		return -1;
+	}
+
+	sim->base = -1;
+	while ((entry = g_dir_read_name(dir)) != NULL) {
+		if (sscanf(entry, "gpiochip%d", &sim->base) == 1)
+			break;
+	}
+	g_dir_close(dir);
+
+	return sim->base < 0 ? -1 : 0;
+}
+
+static void __sim_destroy(pbus_gpio_sim_s *sim)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+
+	if (sim->config[0] == '\0')
+		return;
+
+	__sim_attr(sim, "live", "0");
+
+	snprintf(path, sizeof(path), "%s/bank0", sim->config);
+	rmdir(path);
+	rmdir(sim->config);
+}
+
+static int __sim_create(pbus_gpio_sim_s *sim)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+	char lines[16];
+
+	if (access(GPIO_SIM_CONFIGFS, F_OK) < 0) {
+		g_printerr("No %s, is gpio-sim loaded and configfs mounted?\n", GPIO_SIM_CONFIGFS);
+		return -1;
+	}
+
+	snprintf(sim->config, sizeof(sim->config), GPIO_SIM_CONFIGFS "/pbus-bench-%d", getpid());
+	snprintf(path, sizeof(path), "%s/bank0", sim->config);
+	if (mkdir(sim->config, 0755) < 0 || mkdir(path, 0755) < 0) {
+		g_printerr("Failed to create %s : %s\n", path, g_strerror(errno));
+		rmdir(sim->config);
+		sim->config[0] = '\0';
+		return -1;
+	}
+
+	snprintf(lines, sizeof(lines), "%d", __lines);
+	if (__sim_attr(sim, "bank0/num_lines", lines) < 0 || __sim_attr(sim, "live", "1") < 0)
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/dev_name", sim->config);
+	if (pbus_bench_read(path, sim->dev_name, sizeof(sim->dev_name)) < 0)
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/bank0/chip_name", sim->config);
+	if (pbus_bench_read(path, sim->chip_name, sizeof(sim->chip_name)) < 0)
+		return -1;
+
+	return __sim_find_base(sim);
+}
+
+/* Pulling an input line up or down is what makes gpio-sim raise an edge */
+static int __sim_pull(const pbus_gpio_sim_s *sim, int line, gboolean up)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+
+	snprintf(path, sizeof(path), GPIO_SIM_PLATFORM "/%s/%s/sim_gpio%d/pull",
+			sim->dev_name, sim->chip_name, line);
+
+	return pbus_bench_write(path, up ? "pull-up" : "pull-down");
+}
+
+static gchar *__board_ini(const pbus_gpio_sim_s *sim)
+{
+	GString *ini;
+	int i;
+
+	ini = g_string_new("[gpio]\n");
+	for (i = 0; i < __lines; i++)
+		g_string_append_printf(ini, "gpio%d = %d\n", sim->base + i, i + 1);
+
+	return g_string_free(ini, FALSE);
+}
+
+static int __fd_write(int fd, const char *value)
+{
+	int length = strlen(value);
+
+	return pwrite(fd, value, length, 0) == length ? 0 : -1;
+}
+
+/* Reading the value back rearms the sysfs notification */
+static void __fd_rearm(int fd)
+{
+	char buf[8];
+
+	if (pread(fd, buf, sizeof(buf), 0) < 0)
+		g_printerr("Failed to read the gpio value : %s\n", g_strerror(errno));
+}
+
+static void __bench_open(GDBusConnection *connection, int pin, pbus_bench_phase_s *phases)
+{
+	guint handle;
+	uint64_t start;
+	int result;
+	int i;
+
+	for (i = 0; i < __iterations; i++) {
+		start = pbus_bench_now();
+		result = pbus_bench_call(connection, "gpio", PBUS_BENCH_GPIO_PATH, "Open",
+				g_variant_new("(i)", pin), G_VARIANT_TYPE("(ui)"), &handle, NULL);
+		if (result != 0) {
+			phases[PHASE_OPEN].failures++;
+			continue;
+		}
+		pbus_bench_phase_add(&phases[PHASE_OPEN], pbus_bench_now() - start);
+
+		start = pbus_bench_now();
+		result = pbus_bench_call(connection, "gpio", PBUS_BENCH_GPIO_PATH, "Close",
+				g_variant_new("(u)", handle), G_VARIANT_TYPE("(i)"), NULL, NULL);
+		if (result != 0)
+			phases[PHASE_CLOSE].failures++;
+		else
+			pbus_bench_phase_add(&phases[PHASE_CLOSE], pbus_bench_now() - start);
+	}
+}
+
+/* Times pull changes until the client polling fd wakes up */
+static void __bench_edges(const pbus_gpio_sim_s *sim, int line, int fd, short events,
+		void (*rearm)(int fd), pbus_bench_phase_s *phase)
+{
+	struct pollfd pfd = {.fd = fd, .events = events};
+	uint64_t start;
+	int ret;
+	int i;
+
+	for (i = 0; i < __edges; i++) {
+		start = pbus_bench_now();
+		if (__sim_pull(sim, line, i % 2 == 0) < 0) {
+			phase->failures++;
+			continue;
+		}
+
+		ret = poll(&pfd, 1, GPIO_EDGE_TIMEOUT_MS);
+		if (ret <= 0) {
+			phase->failures++;
+			continue;
+		}
+		pbus_bench_phase_add(phase, pbus_bench_now() - start);
+
+		rearm(fd);
+	}
+}
+
+static void __bench_daemon_edges(GDBusConnection *connection, const pbus_gpio_sim_s *sim,
+		int line, pbus_bench_phase_s *phases)
+{
+	GUnixFDList *fds = NULL;
+	guint handle;
+	int value;
+	int result;
+
+	__sim_pull(sim, line, FALSE);
+
+	result = pbus_bench_call(connection, "gpio", PBUS_BENCH_GPIO_PATH, "Open",
+			g_variant_new("(i)", sim->base + line), G_VARIANT_TYPE("(ui)"), &handle, &fds);
+	if (result != 0 || fds == NULL || g_unix_fd_list_get_length(fds) != 3) {
+		g_printerr("Failed to open gpio%d for edges\n", sim->base + line);
+		phases[PHASE_EDGE].failures++;
+		if (fds)
+			g_object_unref(fds);
+		return;
+	}
+
+	/* Clients set the line up through the fds, as the native library does */
+	if (__fd_write(g_unix_fd_list_peek_fds(fds, NULL)[GPIO_FD_DIRECTION], "in") < 0 ||
+		__fd_write(g_unix_fd_list_peek_fds(fds, NULL)[GPIO_FD_EDGE], "both") < 0) {
+		g_printerr("Failed to set gpio%d up for edges : %s\n", sim->base + line, g_strerror(errno));
+		phases[PHASE_EDGE].failures++;
+	} else {
+		value = g_unix_fd_list_peek_fds(fds, NULL)[GPIO_FD_VALUE];
+		__fd_rearm(value);
+		__bench_edges(sim, line, value, POLLPRI | POLLERR, __fd_rearm, &phases[PHASE_EDGE]);
+	}
+
+	g_object_unref(fds);
+
+	pbus_bench_call(connection, "gpio", PBUS_BENCH_GPIO_PATH, "Close",
+			g_variant_new("(u)", handle), G_VARIANT_TYPE("(i)"), NULL, NULL);
+}
+
+static int __cdev_request(int chip, int line, uint64_t flags)
+{
+	struct gpio_v2_line_request request;
+
+	memset(&request, 0, sizeof(request));
+	request.offsets[0] = line;
+	request.num_lines = 1;
+	request.config.flags = flags;
+	snprintf(request.consumer, sizeof(request.consumer), "pbus-gpio-bench");
+
+	if (ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request) < 0)
+		return -1;
+
+	return request.fd;
+}
+
+static void __cdev_rearm(int fd)
+{
+	struct gpio_v2_line_event event;
+
+	if (read(fd, &event, sizeof(event)) < 0)
+		g_printerr("Failed to read the line event : %s\n", g_strerror(errno));
+}
+
+/* The floor: the same line without the daemon and without sysfs */
+static void __bench_direct(const pbus_gpio_sim_s *sim, int line, pbus_bench_phase_s *phases)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+	uint64_t start;
+	int chip;
+	int fd;
+	int i;
+
+	snprintf(path, sizeof(path), "/dev/%s", sim->chip_name);
+	chip = open(path, O_RDWR | O_CLOEXEC);
+	if (chip < 0) {
+		g_printerr("Failed to open %s : %s\n", path, g_strerror(errno));
+		phases[PHASE_DIRECT_OPEN].failures++;
+		return;
+	}
+
+	for (i = 0; i < __iterations; i++) {
+		start = pbus_bench_now();
+		fd = __cdev_request(chip, line, GPIO_V2_LINE_FLAG_INPUT);
+		if (fd < 0) {
+			phases[PHASE_DIRECT_OPEN].failures++;
+			continue;
+		}
+		pbus_bench_phase_add(&phases[PHASE_DIRECT_OPEN], pbus_bench_now() - start);
+
+		start = pbus_bench_now();
+		close(fd);
+		pbus_bench_phase_add(&phases[PHASE_DIRECT_CLOSE], pbus_bench_now() - start);
+	}
+
+	__sim_pull(sim, line, FALSE);
+
+	fd = __cdev_request(chip, line, GPIO_V2_LINE_FLAG_INPUT |
+			GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING);
+	if (fd < 0) {
+		g_printerr("Failed to request line %d for edges : %s\n", line, g_strerror(errno));
+		phases[PHASE_DIRECT_EDGE].failures++;
+	} else {
+		__bench_edges(sim, line, fd, POLLIN, __cdev_rearm, &phases[PHASE_DIRECT_EDGE]);
+		close(fd);
+	}
+
+	close(chip);
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	pbus_bench_phase_s phases[PHASE_MAX];
+	pbus_gpio_sim_s sim;
+	pbus_bench_env_s env;
+	const char *host_dirs[] = {"/sys", "/dev", NULL};
+	gchar *ini = NULL;
+	int ret = EXIT_FAILURE;
+	int i;
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, __entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+
+	if (__lines <= 0 || __iterations <= 0 || __edges <= 0) {
+		g_printerr("Invalid count\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < PHASE_MAX; i++) {
+		pbus_bench_phase_init(&phases[i], __phase_names[i],
+				i == PHASE_EDGE || i == PHASE_DIRECT_EDGE ? __edges : __iterations);
+	}
+
+	memset(&sim, 0, sizeof(sim));
+	memset(&env, 0, sizeof(env));
+
+	if (__sim_create(&sim) < 0)
+		goto out;
+
+	ini = __board_ini(&sim);
+
+	/* The daemon goes through the real sysfs, only the board is its own */
+	env.daemon = __daemon ? __daemon : PBUS_BENCH_DAEMON;
+	env.board_ini = ini;
+	env.host_dirs = host_dirs;
+	env.keep_root = __keep_root;
+
+	if (pbus_bench_env_start(&env) < 0)
+		goto out;
+
+	printf("%s (%s), gpio%d..gpio%d, %d iterations, %d edges\n\n",
+			sim.chip_name, sim.dev_name, sim.base, sim.base + __lines - 1, __iterations, __edges);
+
+	__bench_open(env.connection, sim.base, phases);
+	__bench_daemon_edges(env.connection, &sim, 0, phases);
+
+	/* The daemon must let go of the line before it can be requested */
+	pbus_bench_env_stop(&env);
+
+	__bench_direct(&sim, 0, phases);
+
+	pbus_bench_report(phases, PHASE_MAX);
+
+	ret = EXIT_SUCCESS;
+	for (i = 0; i < PHASE_MAX; i++) {
+		if (phases[i].failures)
+			ret = EXIT_FAILURE;
+	}
+
+out:
+	pbus_bench_env_stop(&env);
+	__sim_destroy(&sim);
+
+	for (i = 0; i < PHASE_MAX; i++)
+		pbus_bench_phase_free(&phases[i]);
+
+	g_free(ini);
+	g_free(__daemon);
+
+	return ret;
+}
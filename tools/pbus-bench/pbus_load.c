@@ -0,0 +1,547 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * pbus-load: many clients at once, the way apps hit the daemon when they
+ * all restart together.
+ *
+ * Every client has a bus connection of its own and runs a mix of Open,
+ * Close, holding its handles, and dropping its connection with handles
+ * still open. Devices are shared, so clients contend for them. At the end
+ * all clients disconnect at once, and the time the daemon takes to
+ * release what they held is read from its handle state file.
+ *
+ *   pbus-load [--clients=N] [--ops=N] [--mix=open:40,close:40,hold:10,crash:10]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <gio/gio.h>
+#include <peripheral_io.h>
+
+#include "pbus_bench_common.h"
+
+#ifndef PBUS_BENCH_DAEMON
+#define PBUS_BENCH_DAEMON "peripheral-bus"
+#endif
+
+#define LOAD_STATE_PATH		"/run/peripheral-bus/handles"
+#define LOAD_CLEANUP_TIMEOUT_MS	30000
+#define LOAD_GPIO_BASE		100
+
+typedef enum {
+	LOAD_OPEN,
+	LOAD_CLOSE,
+	LOAD_HOLD,
+	LOAD_CRASH,
+	LOAD_ACTION_MAX,
+} pbus_load_action_e;
+
+static const char *__action_names[LOAD_ACTION_MAX] = {"open", "close", "hold", "crash"};
+
+/* Failures by what the reply, or the lack of one, said */
+typedef enum {
+	LOAD_FAIL_BUSY,
+	LOAD_FAIL_NO_DEVICE,
+	LOAD_FAIL_INVALID,
+	LOAD_FAIL_OTHER_CODE,
+	LOAD_FAIL_TIMEOUT,
+	LOAD_FAIL_DBUS,
+	LOAD_FAIL_MAX,
+} pbus_load_fail_e;
+
+static const char *__fail_names[LOAD_FAIL_MAX] = {
+	"RESOURCE_BUSY", "NO_DEVICE", "INVALID_PARAMETER", "other code", "timeout", "D-Bus error",
+};
+
+typedef struct {
+	const char *type;
+	const char *path;
+	int nargs;
+	int args[2];
+} pbus_load_dev_s;
+
+typedef struct {
+	const pbus_load_dev_s *dev;
+	guint handle;
+} pbus_load_held_s;
+
+typedef struct {
+	int id;
+	GThread *thread;
+	GDBusConnection *connection;
+	GRand *rand;
+	GArray *held;
+	pbus_bench_phase_s open;
+	pbus_bench_phase_s close;
+	unsigned int actions[LOAD_ACTION_MAX];
+	unsigned int fails[LOAD_FAIL_MAX];
+} pbus_load_client_s;
+
+static gint __clients = 50;
+static gint __ops = 200;
+static gchar *__mix;
+static gint __hold_ms = 20;
+static gint __devices = 4;
+static gint __timeout_ms = 5000;
+static gint __latency;
+static gchar *__daemon;
+static gboolean __keep_root;
+
+static GOptionEntry __entries[] = {
+	{"clients", 'c', 0, G_OPTION_ARG_INT, &__clients, "Concurrent clients", "N"},
+	{"ops", 'n', 0, G_OPTION_ARG_INT, &__ops, "Actions per client", "N"},
+	{"mix", 'm', 0, G_OPTION_ARG_STRING, &__mix, "Weights of open, close, hold and crash", "open:W,close:W,hold:W,crash:W"},
+	{"hold-ms", 'H', 0, G_OPTION_ARG_INT, &__hold_ms, "Time a hold keeps the handles", "MS"},
+	{"devices", 'D', 0, G_OPTION_ARG_INT, &__devices, "Devices of each type", "N"},
+	{"timeout-ms", 't', 0, G_OPTION_ARG_INT, &__timeout_ms, "D-Bus call timeout", "MS"},
+	{"latency", 'l', 0, G_OPTION_ARG_INT, &__latency, "Simulated sysfs export latency", "USEC"},
+	{"daemon", 'd', 0, G_OPTION_ARG_FILENAME, &__daemon, "peripheral-bus binary to run", "PATH"},
+	{"keep-root", 'k', 0, G_OPTION_ARG_NONE, &__keep_root, "Leave the simulated root behind", NULL},
+	{NULL}
+};
+
+static unsigned int __weights[LOAD_ACTION_MAX] = {40, 40, 10, 10};
+static unsigned int __weight_total;
+
+static pbus_bench_env_s __env;
+static pbus_load_dev_s *__pool;
+static int __pool_len;
+
+/* All clients start together, once every one of them is connected */
+static GMutex __start_lock;
+static GCond __start_cond;
+static gboolean __started;
+
+static int __parse_mix(const char *mix)
+{
+	gchar **items;
+	gchar **kv;
+	int i;
+	int j;
+
+	if (mix == NULL)
+		return 0;
+
+	memset(__weights, 0, sizeof(__weights));
+
+	items = g_strsplit(mix, ",", -1);
+	for (i = 0; items[i]; i++) {
+		kv = g_strsplit(items[i], ":", 2);
+		for (j = 0; j < LOAD_ACTION_MAX; j++) {
+			if (kv[0] && kv[1] && strcmp(kv[0], __action_names[j]) == 0) {
+				__weights[j] = atoi(kv[1]);
+				break;
+			}
+		}
+		g_strfreev(kv);
+
+		if (j == LOAD_ACTION_MAX) {
+			g_printerr("Invalid mix entry '%s'\n", items[i]);
+			g_strfreev(items);
+			return -1;
+		}
+	}
+	g_strfreev(items);
+
+	return 0;
+}
+
+/* __devices each of gpio, i2c addresses, pwm channels and adc channels */
+static gchar *__pool_create(void)
+{
+	GString *ini;
+	int i;
+
+	__pool_len = __devices * 4;
+	__pool = g_new0(pbus_load_dev_s, __pool_len);
+
+	ini = g_string_new(NULL);
+
+	g_string_append(ini, "[gpio]\n");
+	for (i = 0; i < __devices; i++) {
+		g_string_append_printf(ini, "gpio%d = %d\n", LOAD_GPIO_BASE + i, i + 1);
+		__pool[i] = (pbus_load_dev_s){"gpio", PBUS_BENCH_GPIO_PATH, 1, {LOAD_GPIO_BASE + i, 0}};
+	}
+
+	g_string_append(ini, "\n[i2c]\ni2c-1 = 3, 5\n");
+	for (i = 0; i < __devices; i++)
+		__pool[__devices + i] = (pbus_load_dev_s){"i2c", PBUS_BENCH_I2C_PATH, 2, {1, 0x20 + i}};
+
+	g_string_append(ini, "\n[pwm]\n");
+	for (i = 0; i < __devices; i++) {
+		g_string_append_printf(ini, "pwmchip0/pwm%d = %d\n", i, 100 + i);
+		__pool[__devices * 2 + i] = (pbus_load_dev_s){"pwm", PBUS_BENCH_PWM_PATH, 2, {0, i}};
+	}
+
+	g_string_append(ini, "\n[adc]\n");
+	for (i = 0; i < __devices; i++) {
+		g_string_append_printf(ini, "iio:device0/in_voltage%d_raw = %d\n", i, 200 + i);
+		__pool[__devices * 3 + i] = (pbus_load_dev_s){"adc", PBUS_BENCH_ADC_PATH, 2, {0, i}};
+	}
+
+	return g_string_free(ini, FALSE);
+}
+
+static void __client_fail(pbus_load_client_s *client, int result, GError *error)
+{
+	pbus_load_fail_e fail;
+
+	if (error) {
+		fail = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ? LOAD_FAIL_TIMEOUT : LOAD_FAIL_DBUS;
+		g_error_free(error);
+	} else if (result == PERIPHERAL_ERROR_RESOURCE_BUSY) {
+		fail = LOAD_FAIL_BUSY;
+	} else if (result == PERIPHERAL_ERROR_NO_DEVICE) {
+		fail = LOAD_FAIL_NO_DEVICE;
+	} else if (result == PERIPHERAL_ERROR_INVALID_PARAMETER) {
+		fail = LOAD_FAIL_INVALID;
+	} else {
+		fail = LOAD_FAIL_OTHER_CODE;
+	}
+
+	client->fails[fail]++;
+}
+
+static void __client_open(pbus_load_client_s *client)
+{
+	pbus_load_held_s held;
+	GError *error = NULL;
+	GVariant *args;
+	uint64_t start;
+	int result;
+
+	held.dev = &__pool[g_rand_int_range(client->rand, 0, __pool_len)];
+	if (held.dev->nargs == 1)
+		args = g_variant_new("(i)", held.dev->args[0]);
+	else
+		args = g_variant_new("(ii)", held.dev->args[0], held.dev->args[1]);
+
+	start = pbus_bench_now();
+	result = pbus_bench_call_full(client->connection, held.dev->type, held.dev->path, "Open",
+			args, G_VARIANT_TYPE("(ui)"), __timeout_ms, &held.handle, NULL, &error);
+	if (error || result != 0) {
+		client->open.failures++;
+		__client_fail(client, result, error);
+		return;
+	}
+	pbus_bench_phase_add(&client->open, pbus_bench_now() - start);
+
+	g_array_append_val(client->held, held);
+}
+
+static void __client_close(pbus_load_client_s *client)
+{
+	pbus_load_held_s held;
+	GError *error = NULL;
+	uint64_t start;
+	int index;
+	int result;
+
+	index = g_rand_int_range(client->rand, 0, client->held->len);
+	held = g_array_index(client->held, pbus_load_held_s, index);
+	g_array_remove_index_fast(client->held, index);
+
+	start = pbus_bench_now();
+	result = pbus_bench_call_full(client->connection, held.dev->type, held.dev->path, "Close",
+			g_variant_new("(u)", held.handle), G_VARIANT_TYPE("(i)"), __timeout_ms, NULL, NULL, &error);
+	if (error || result != 0) {
+		client->close.failures++;
+		__client_fail(client, result, error);
+		return;
+	}
+	pbus_bench_phase_add(&client->close, pbus_bench_now() - start);
+}
+
+/* Leaves without closing, the daemon is to notice the name vanish */
+static void __client_disconnect(pbus_load_client_s *client)
+{
+	if (client->connection == NULL)
+		return;
+
+	g_dbus_connection_close_sync(client->connection, NULL, NULL);
+	g_object_unref(client->connection);
+	client->connection = NULL;
+
+	g_array_set_size(client->held, 0);
+}
+
+static void __client_crash(pbus_load_client_s *client)
+{
+	__client_disconnect(client);
+	client->connection = pbus_bench_env_connect(&__env);
+}
+
+static pbus_load_action_e __client_pick(pbus_load_client_s *client)
+{
+	unsigned int pick;
+	int action;
+
+	pick = g_rand_int_range(client->rand, 0, __weight_total);
+	for (action = 0; action < LOAD_ACTION_MAX - 1; action++) {
+		if (pick < __weights[action])
+			break;
+		pick -= __weights[action];
+	}
+
+	/* Nothing to close yet, so open something to close later */
+	if (action == LOAD_CLOSE && client->held->len == 0)
+		action = LOAD_OPEN;
+
+	return action;
+}
+
+static gpointer __client_run(gpointer data)
+{
+	pbus_load_client_s *client = (pbus_load_client_s*)data;
+	pbus_load_action_e action;
+	int i;
+
+	g_mutex_lock(&__start_lock);
+	while (!__started)
+		g_cond_wait(&__start_cond, &__start_lock);
+	g_mutex_unlock(&__start_lock);
+
+	for (i = 0; i < __ops && client->connection; i++) {
+		action = __client_pick(client);
+		client->actions[action]++;
+
+		switch (action) {
+		case LOAD_OPEN:
+			__client_open(client);
+			break;
+		case LOAD_CLOSE:
+			__client_close(client);
+			break;
+		case LOAD_HOLD:
+			g_usleep(__hold_ms * 1000);
+			break;
+		case LOAD_CRASH:
+			__client_crash(client);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/* Handles the daemon still has, from the state it saves on every change */
+static int __state_handles(const char *root)
+{
+	gchar *path;
+	gchar *contents = NULL;
+	int count = 0;
+	int i;
+
+	path = g_strconcat(root, LOAD_STATE_PATH, NULL);
+	if (g_file_get_contents(path, &contents, NULL, NULL)) {
+		for (i = 0; contents[i]; i++) {
+			if (contents[i] == '\n')
+				count++;
+		}
+	}
+	g_free(contents);
+	g_free(path);
+
+	return count;
+}
+
+static void __report_fails(pbus_load_client_s *clients)
+{
+	unsigned int total;
+	int fail;
+	int i;
+
+	printf("\n%-20s %8s\n", "failure", "count");
+	for (fail = 0; fail < LOAD_FAIL_MAX; fail++) {
+		total = 0;
+		for (i = 0; i < __clients; i++)
+			total += clients[i].fails[fail];
+		printf("%-20s %8u\n", __fail_names[fail], total);
+	}
+}
+
+static void __report_cleanup(pbus_load_client_s *clients)
+{
+	uint64_t start;
+	int held = 0;
+	int left;
+	int i;
+
+	for (i = 0; i < __clients; i++)
+		held += clients[i].held->len;
+
+	/* Everyone goes at once, as when a session restarts */
+	start = pbus_bench_now();
+	for (i = 0; i < __clients; i++)
+		__client_disconnect(&clients[i]);
+
+	do {
+		left = __state_handles(__env.root);
+		if (left == 0)
+			break;
+		g_usleep(1000);
+	} while (pbus_bench_now() - start < LOAD_CLEANUP_TIMEOUT_MS * 1000000ULL);
+
+	printf("\nmass disconnect : %d handles of %d clients, ", held, __clients);
+	if (left == 0)
+		printf("released in %.1f ms\n", (pbus_bench_now() - start) / 1e6);
+	else
+		printf("%d still open after %d ms\n", left, LOAD_CLEANUP_TIMEOUT_MS);
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	pbus_load_client_s *clients = NULL;
+	pbus_bench_phase_s phases[2];
+	char latency[16];
+	const char *daemon_args[] = {"--simulate", "--sim-latency", latency, NULL};
+	gchar *ini = NULL;
+	uint64_t start;
+	uint64_t elapsed;
+	unsigned int requests = 0;
+	unsigned int i;
+	int c;
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, __entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+
+	if (__clients <= 0 || __ops <= 0 || __devices <= 0 || __parse_mix(__mix) < 0) {
+		g_printerr("Invalid load\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < LOAD_ACTION_MAX; i++)
+		__weight_total += __weights[i];
+	if (__weight_total == 0) {
+		g_printerr("The mix has no weight\n");
+		return EXIT_FAILURE;
+	}
+
+	snprintf(latency, sizeof(latency), "%d", __latency);
+	ini = __pool_create();
+
+	__env.daemon = __daemon ? __daemon : PBUS_BENCH_DAEMON;
+	__env.board_ini = ini;
+	__env.daemon_args = daemon_args;
+	__env.keep_root = __keep_root;
+
+	if (pbus_bench_env_start(&__env) < 0)
+		goto out;
+
+	clients = g_new0(pbus_load_client_s, __clients);
+	for (c = 0; c < __clients; c++) {
+		clients[c].id = c;
+		clients[c].rand = g_rand_new_with_seed(c + 1);
+		clients[c].held = g_array_new(FALSE, FALSE, sizeof(pbus_load_held_s));
+		pbus_bench_phase_init(&clients[c].open, "Open", __ops);
+		pbus_bench_phase_init(&clients[c].close, "Close", __ops);
+
+		clients[c].connection = pbus_bench_env_connect(&__env);
+		if (clients[c].connection == NULL)
+			goto out;
+
+		clients[c].thread = g_thread_new("pbus-load", __client_run, &clients[c]);
+	}
+
+	printf("%d clients, %d actions each, %d devices of each type, mix open:%u close:%u hold:%u crash:%u\n",
+			__clients, __ops, __devices, __weights[LOAD_OPEN], __weights[LOAD_CLOSE],
+			__weights[LOAD_HOLD], __weights[LOAD_CRASH]);
+
+	start = pbus_bench_now();
+
+	g_mutex_lock(&__start_lock);
+	__started = TRUE;
+	g_cond_broadcast(&__start_cond);
+	g_mutex_unlock(&__start_lock);
+
+	for (c = 0; c < __clients; c++) {
+		g_thread_join(clients[c].thread);
+		clients[c].thread = NULL;
+	}
+
+	elapsed = pbus_bench_now() - start;
+
+	/* Merge the clients, the report sorts the merged samples */
+	pbus_bench_phase_init(&phases[0], "Open", __clients * __ops);
+	pbus_bench_phase_init(&phases[1], "Close", __clients * __ops);
+	for (c = 0; c < __clients; c++) {
+		for (i = 0; i < clients[c].open.count; i++)
+			pbus_bench_phase_add(&phases[0], clients[c].open.samples[i]);
+		for (i = 0; i < clients[c].close.count; i++)
+			pbus_bench_phase_add(&phases[1], clients[c].close.samples[i]);
+		phases[0].failures += clients[c].open.failures;
+		phases[1].failures += clients[c].close.failures;
+	}
+
+	requests = phases[0].count + phases[0].failures + phases[1].count + phases[1].failures;
+	printf("%u requests in %.2f s, %.0f requests/s across clients\n\n",
+			requests, elapsed / 1e9, requests * 1e9 / elapsed);
+
+	pbus_bench_report(phases, 2);
+	__report_fails(clients);
+	__report_cleanup(clients);
+
+	pbus_bench_phase_free(&phases[0]);
+	pbus_bench_phase_free(&phases[1]);
+
+out:
+	if (clients) {
+		/* Clients still waiting to start leave right away */
+		g_mutex_lock(&__start_lock);
+		if (!__started)
+			__ops = 0;
+		__started = TRUE;
+		g_cond_broadcast(&__start_cond);
+		g_mutex_unlock(&__start_lock);
+
+		for (c = 0; c < __clients; c++) {
+			if (clients[c].thread)
+				g_thread_join(clients[c].thread);
+			__client_disconnect(&clients[c]);
+			if (clients[c].rand)
+				g_rand_free(clients[c].rand);
+			if (clients[c].held)
+				g_array_free(clients[c].held, TRUE);
+			pbus_bench_phase_free(&clients[c].open);
+			pbus_bench_phase_free(&clients[c].close);
+		}
+		g_free(clients);
+	}
+
+	pbus_bench_env_stop(&__env);
+
+	g_free(__pool);
+	g_free(ini);
+	g_free(__mix);
+	g_free(__daemon);
+
+	return EXIT_SUCCESS;
+}
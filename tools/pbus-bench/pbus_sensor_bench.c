@@ -0,0 +1,538 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * pbus-sensor-bench: I2C and ADC costs through the daemon on the kernel's
+ * i2c-stub and iio_dummy drivers, so that sensor polling rates can be
+ * sized without the sensors.
+ *
+ * Measures Open/Close and sustained reads through the fds the daemon
+ * hands out: SMBus byte, word and block reads on the i2c fd, and raw
+ * sysfs reads on the adc fd. The same devices opened directly and, when
+ * iio-trig-sysfs is there, the iio buffer give the baselines. Needs root,
+ * and configfs for iio_dummy.
+ *
+ *   modprobe i2c-stub chip_addr=0x20
+ *   modprobe iio_dummy; modprobe iio-trig-sysfs
+ *   pbus-sensor-bench [--iterations=N] [--reads=N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#include "pbus_bench_common.h"
+
+#ifndef PBUS_BENCH_DAEMON
+#define PBUS_BENCH_DAEMON "peripheral-bus"
+#endif
+
+#define I2C_STUB_NAME		"SMBus stub driver"
+#define I2C_DEVICES		"/sys/bus/i2c/devices"
+#define IIO_DEVICES		"/sys/bus/iio/devices"
+#define IIO_DUMMY_CONFIGFS	"/sys/kernel/config/iio/devices/dummy"
+#define IIO_SYSFS_TRIGGER	IIO_DEVICES "/iio_sysfs_trigger"
+#define IIO_CHANNEL		0
+#define IIO_BUFFER_TIMEOUT_MS	1000
+
+enum {
+	PHASE_I2C_OPEN,
+	PHASE_I2C_CLOSE,
+	PHASE_I2C_DIRECT_OPEN,
+	PHASE_I2C_BYTE,
+	PHASE_I2C_WORD,
+	PHASE_I2C_BLOCK,
+	PHASE_ADC_OPEN,
+	PHASE_ADC_CLOSE,
+	PHASE_ADC_DIRECT_OPEN,
+	PHASE_ADC_RAW,
+	PHASE_ADC_BUFFER,
+	PHASE_MAX,
+};
+
+static const struct {
+	const char *name;
+	gboolean reads;
+} __phases[PHASE_MAX] = {
+	{"i2c.Open", FALSE},
+	{"i2c.Close", FALSE},
+	{"i2c.direct_open", FALSE},
+	{"i2c.byte_data", TRUE},
+	{"i2c.word_data", TRUE},
+	{"i2c.block_32", TRUE},
+	{"adc.Open", FALSE},
+	{"adc.Close", FALSE},
+	{"adc.direct_open", FALSE},
+	{"adc.raw", TRUE},
+	{"iio.buffer", TRUE},
+};
+
+typedef struct {
+	char config[PBUS_BENCH_PATH_MAX];	/* configfs directory */
+	char name[64];
+	int device;				/* iio:deviceN */
+	int trigger;				/* iio-trig-sysfs id, -1 without */
+	char trigger_dir[PBUS_BENCH_PATH_MAX];
+} pbus_iio_dummy_s;
+
+static gint __i2c_bus = -1;
+static gint __i2c_address = 0x20;
+static gint __iterations = 1000;
+static gint __reads = 10000;
+static gchar *__daemon;
+static gboolean __keep_root;
+
+static GOptionEntry __entries[] = {
+	{"i2c-bus", 'b', 0, G_OPTION_ARG_INT, &__i2c_bus, "i2c-stub adapter, found when not given", "N"},
+	{"i2c-address", 'a', 0, G_OPTION_ARG_INT, &__i2c_address, "Chip address given to i2c-stub", "ADDR"},
+	{"iterations", 'n', 0, G_OPTION_ARG_INT, &__iterations, "Open/Close pairs per device", "N"},
+	{"reads", 'r', 0, G_OPTION_ARG_INT, &__reads, "Reads per read phase", "N"},
+	{"daemon", 'd', 0, G_OPTION_ARG_FILENAME, &__daemon, "peripheral-bus binary to run", "PATH"},
+	{"keep-root", 'k', 0, G_OPTION_ARG_NONE, &__keep_root, "Leave the root behind", NULL},
+	{NULL}
+};
+
+/* Finds a device of a bus by the contents of its name attribute */
+static int __find_by_name(const char *devices, const char *format, const char *name)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+	char buf[64];
+	const gchar *entry;
+	GDir *dir;
+	int found = -1;
+	int id;
+
+	dir = g_dir_open(devices, 0, NULL);
+	if (dir == NULL)
+		return -1;
+
+	while (found < 0 && (entry = g_dir_read_name(dir)) != NULL) {
+		if (sscanf(entry, format, &id) != 1)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s/name", devices, entry);
+		if (pbus_bench_read(path, buf, sizeof(buf)) == 0 && strcmp(buf, name) == 0)
+			found = id;
+	}
+	g_dir_close(dir);
+
+	return found;
+}
+
+static int __iio_attr(const pbus_iio_dummy_s *iio, const char *attr, const char *value)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+
+	snprintf(path, sizeof(path), IIO_DEVICES "/iio:device%d/%s", iio->device, attr);
+
+	return pbus_bench_write(path, value);
+}
+
+/* Sets up the sysfs trigger and the buffer, only the baseline needs them */
+static void __iio_buffer_init(pbus_iio_dummy_s *iio)
+{
+	char trigger[32];
+	char id[16];
+	int ret;
+
+	iio->trigger = getpid() & 0xffff;
+	snprintf(id, sizeof(id), "%d", iio->trigger);
+	if (pbus_bench_write(IIO_SYSFS_TRIGGER "/add_trigger", id) < 0) {
+		g_printerr("No iio-trig-sysfs, skipping the iio buffer\n");
+		iio->trigger = -1;
+		return;
+	}
+
+	snprintf(trigger, sizeof(trigger), "sysfstrig%d", iio->trigger);
+	ret = __find_by_name(IIO_DEVICES, "trigger%d", trigger);
+	if (ret < 0) {
+		g_printerr("%s did not show up, skipping the iio buffer\n", trigger);
+		return;
+	}
+	snprintf(iio->trigger_dir, sizeof(iio->trigger_dir), IIO_DEVICES "/trigger%d", ret);
+
+	ret = __iio_attr(iio, "trigger/current_trigger", trigger);
+	ret |= __iio_attr(iio, "scan_elements/in_voltage0_en", "1");
+	ret |= __iio_attr(iio, "buffer/enable", "1");
+	if (ret < 0) {
+		g_printerr("iio_dummy has no buffer support, skipping the iio buffer\n");
+		iio->trigger_dir[0] = '\0';
+	}
+}
+
+static void __iio_buffer_deinit(pbus_iio_dummy_s *iio)
+{
+	char id[16];
+
+	if (iio->trigger < 0)
+		return;
+
+	__iio_attr(iio, "buffer/enable", "0");
+	__iio_attr(iio, "trigger/current_trigger", "");
+
+	snprintf(id, sizeof(id), "%d", iio->trigger);
+	pbus_bench_write(IIO_SYSFS_TRIGGER "/remove_trigger", id);
+	iio->trigger = -1;
+}
+
+static int __iio_create(pbus_iio_dummy_s *iio)
+{
+	iio->trigger = -1;
+
+	if (access(IIO_DUMMY_CONFIGFS, F_OK) < 0) {
+		g_printerr("No %s, is iio_dummy loaded and configfs mounted?\n", IIO_DUMMY_CONFIGFS);
+		return -1;
+	}
+
+	snprintf(iio->name, sizeof(iio->name), "pbus-bench-%d", getpid());
+	snprintf(iio->config, sizeof(iio->config), IIO_DUMMY_CONFIGFS "/%s", iio->name);
+	if (mkdir(iio->config, 0755) < 0) {
+		g_printerr("Failed to create %s : %s\n", iio->config, g_strerror(errno));
+		iio->config[0] = '\0';
+		return -1;
+	}
+
+	iio->device = __find_by_name(IIO_DEVICES, "iio:device%d", iio->name);
+	if (iio->device < 0) {
+		g_printerr("%s did not show up in %s\n", iio->name, IIO_DEVICES);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void __iio_destroy(pbus_iio_dummy_s *iio)
+{
+	__iio_buffer_deinit(iio);
+
+	if (iio->config[0] != '\0')
+		rmdir(iio->config);
+}
+
+static gchar *__board_ini(const pbus_iio_dummy_s *iio)
+{
+	return g_strdup_printf(
+			"[i2c]\n"
+			"i2c-%d = 3, 5\n"
+			"\n"
+			"[adc]\n"
+			"iio:device%d/in_voltage%d_raw = 40\n",
+			__i2c_bus, iio->device, IIO_CHANNEL);
+}
+
+static void __bench_open(GDBusConnection *connection, const char *type, const char *path,
+		int arg0, int arg1, pbus_bench_phase_s *open, pbus_bench_phase_s *close)
+{
+	guint handle;
+	uint64_t start;
+	int result;
+	int i;
+
+	for (i = 0; i < __iterations; i++) {
+		start = pbus_bench_now();
+		result = pbus_bench_call(connection, type, path, "Open",
+				g_variant_new("(ii)", arg0, arg1), G_VARIANT_TYPE("(ui)"), &handle, NULL);
+		if (result != 0) {
+			open->failures++;
+			continue;
+		}
+		pbus_bench_phase_add(open, pbus_bench_now() - start);
+
+		start = pbus_bench_now();
+		result = pbus_bench_call(connection, type, path, "Close",
+				g_variant_new("(u)", handle), G_VARIANT_TYPE("(i)"), NULL, NULL);
+		if (result != 0)
+			close->failures++;
+		else
+			pbus_bench_phase_add(close, pbus_bench_now() - start);
+	}
+}
+
+/* Opens a device for its fd, which stays valid after Close returns it */
+static int __bench_open_fd(GDBusConnection *connection, const char *type, const char *path,
+		int arg0, int arg1, guint *handle)
+{
+	GUnixFDList *fds = NULL;
+	int result;
+	int fd;
+
+	result = pbus_bench_call(connection, type, path, "Open",
+			g_variant_new("(ii)", arg0, arg1), G_VARIANT_TYPE("(ui)"), handle, &fds);
+	if (result != 0 || fds == NULL) {
+		g_printerr("Failed to open %s %d, %d\n", type, arg0, arg1);
+		if (fds)
+			g_object_unref(fds);
+		return -1;
+	}
+
+	fd = g_unix_fd_list_get(fds, 0, NULL);
+	g_object_unref(fds);
+
+	return fd;
+}
+
+static void __bench_close(GDBusConnection *connection, const char *type, const char *path, guint handle)
+{
+	pbus_bench_call(connection, type, path, "Close",
+			g_variant_new("(u)", handle), G_VARIANT_TYPE("(i)"), NULL, NULL);
+}
+
+static int __smbus_read(int fd, int size, union i2c_smbus_data *data)
+{
+	struct i2c_smbus_ioctl_data args = {
+		.read_write = I2C_SMBUS_READ,
+		.command = 0,
+		.size = size,
+		.data = data,
+	};
+
+	return ioctl(fd, I2C_SMBUS, &args);
+}
+
+static void __bench_smbus(int fd, int size, pbus_bench_phase_s *phase)
+{
+	union i2c_smbus_data data;
+	uint64_t start;
+	int i;
+
+	for (i = 0; i < __reads; i++) {
+		data.block[0] = I2C_SMBUS_BLOCK_MAX;
+
+		start = pbus_bench_now();
+		if (__smbus_read(fd, size, &data) < 0) {
+			phase->failures++;
+			continue;
+		}
+		pbus_bench_phase_add(phase, pbus_bench_now() - start);
+	}
+}
+
+static void __bench_i2c(GDBusConnection *connection, pbus_bench_phase_s *phases)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+	guint handle;
+	uint64_t start;
+	int fd;
+	int i;
+
+	__bench_open(connection, "i2c", PBUS_BENCH_I2C_PATH, __i2c_bus, __i2c_address,
+			&phases[PHASE_I2C_OPEN], &phases[PHASE_I2C_CLOSE]);
+
+	snprintf(path, sizeof(path), "/dev/i2c-%d", __i2c_bus);
+	for (i = 0; i < __iterations; i++) {
+		start = pbus_bench_now();
+		fd = open(path, O_RDWR | O_CLOEXEC);
+		if (fd < 0 || ioctl(fd, I2C_SLAVE, __i2c_address) < 0) {
+			phases[PHASE_I2C_DIRECT_OPEN].failures++;
+			if (fd >= 0)
+				close(fd);
+			continue;
+		}
+		close(fd);
+		pbus_bench_phase_add(&phases[PHASE_I2C_DIRECT_OPEN], pbus_bench_now() - start);
+	}
+
+	fd = __bench_open_fd(connection, "i2c", PBUS_BENCH_I2C_PATH, __i2c_bus, __i2c_address, &handle);
+	if (fd < 0) {
+		phases[PHASE_I2C_BYTE].failures++;
+		return;
+	}
+
+	__bench_smbus(fd, I2C_SMBUS_BYTE_DATA, &phases[PHASE_I2C_BYTE]);
+	__bench_smbus(fd, I2C_SMBUS_WORD_DATA, &phases[PHASE_I2C_WORD]);
+	__bench_smbus(fd, I2C_SMBUS_I2C_BLOCK_DATA, &phases[PHASE_I2C_BLOCK]);
+
+	close(fd);
+	__bench_close(connection, "i2c", PBUS_BENCH_I2C_PATH, handle);
+}
+
+static void __bench_adc(GDBusConnection *connection, const pbus_iio_dummy_s *iio, pbus_bench_phase_s *phases)
+{
+	char path[PBUS_BENCH_PATH_MAX];
+	char buf[16];
+	guint handle;
+	uint64_t start;
+	int fd;
+	int i;
+
+	__bench_open(connection, "adc", PBUS_BENCH_ADC_PATH, iio->device, IIO_CHANNEL,
+			&phases[PHASE_ADC_OPEN], &phases[PHASE_ADC_CLOSE]);
+
+	snprintf(path, sizeof(path), IIO_DEVICES "/iio:device%d/in_voltage%d_raw", iio->device, IIO_CHANNEL);
+	for (i = 0; i < __iterations; i++) {
+		start = pbus_bench_now();
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			phases[PHASE_ADC_DIRECT_OPEN].failures++;
+			continue;
+		}
+		close(fd);
+		pbus_bench_phase_add(&phases[PHASE_ADC_DIRECT_OPEN], pbus_bench_now() - start);
+	}
+
+	fd = __bench_open_fd(connection, "adc", PBUS_BENCH_ADC_PATH, iio->device, IIO_CHANNEL, &handle);
+	if (fd < 0) {
+		phases[PHASE_ADC_RAW].failures++;
+		return;
+	}
+
+	/* The fd shares its offset with the daemon's copy, so always pread at 0 */
+	for (i = 0; i < __reads; i++) {
+		start = pbus_bench_now();
+		if (pread(fd, buf, sizeof(buf), 0) <= 0) {
+			phases[PHASE_ADC_RAW].failures++;
+			continue;
+		}
+		pbus_bench_phase_add(&phases[PHASE_ADC_RAW], pbus_bench_now() - start);
+	}
+
+	close(fd);
+	__bench_close(connection, "adc", PBUS_BENCH_ADC_PATH, handle);
+}
+
+/* A trigger and the read of the scan it pushes, per sample */
+static void __bench_iio_buffer(const pbus_iio_dummy_s *iio, pbus_bench_phase_s *phase)
+{
+	char trigger_now[PBUS_BENCH_PATH_MAX];
+	char path[PBUS_BENCH_PATH_MAX];
+	char buf[64];
+	struct pollfd pfd;
+	uint64_t start;
+	int i;
+
+	if (iio->trigger_dir[0] == '\0')
+		return;
+
+	snprintf(path, sizeof(path), "/dev/iio:device%d", iio->device);
+	pfd.fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	pfd.events = POLLIN;
+	if (pfd.fd < 0) {
+		g_printerr("Failed to open %s : %s\n", path, g_strerror(errno));
+		phase->failures++;
+		return;
+	}
+
+	snprintf(trigger_now, sizeof(trigger_now), "%s/trigger_now", iio->trigger_dir);
+
+	for (i = 0; i < __reads; i++) {
+		start = pbus_bench_now();
+		if (pbus_bench_write(trigger_now, "1") < 0 ||
+			poll(&pfd, 1, IIO_BUFFER_TIMEOUT_MS) <= 0 ||
+			read(pfd.fd, buf, sizeof(buf)) <= 0) {
+			phase->failures++;
+			continue;
+		}
+		pbus_bench_phase_add(phase, pbus_bench_now() - start);
+	}
+
+	close(pfd.fd);
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	pbus_bench_phase_s phases[PHASE_MAX];
+	pbus_iio_dummy_s iio;
+	pbus_bench_env_s env;
+	const char *host_dirs[] = {"/sys", "/dev", NULL};
+	gchar *ini = NULL;
+	int ret = EXIT_FAILURE;
+	int i;
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, __entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+
+	if (__iterations <= 0 || __reads <= 0) {
+		g_printerr("Invalid count\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < PHASE_MAX; i++)
+		pbus_bench_phase_init(&phases[i], __phases[i].name, __phases[i].reads ? __reads : __iterations);
+
+	memset(&iio, 0, sizeof(iio));
+	memset(&env, 0, sizeof(env));
+
+	if (__i2c_bus < 0)
+		__i2c_bus = __find_by_name(I2C_DEVICES, "i2c-%d", I2C_STUB_NAME);
+	if (__i2c_bus < 0) {
+		g_printerr("No i2c-stub adapter, load it with chip_addr=0x%x\n", __i2c_address);
+		goto out;
+	}
+
+	if (__iio_create(&iio) < 0)
+		goto out;
+
+	__iio_buffer_init(&iio);
+
+	ini = __board_ini(&iio);
+
+	env.daemon = __daemon ? __daemon : PBUS_BENCH_DAEMON;
+	env.board_ini = ini;
+	env.host_dirs = host_dirs;
+	env.keep_root = __keep_root;
+
+	if (pbus_bench_env_start(&env) < 0)
+		goto out;
+
+	printf("i2c-%d at 0x%02x, iio:device%d (%s), %d iterations, %d reads\n\n",
+			__i2c_bus, __i2c_address, iio.device, iio.name, __iterations, __reads);
+
+	__bench_i2c(env.connection, phases);
+	__bench_adc(env.connection, &iio, phases);
+	__bench_iio_buffer(&iio, &phases[PHASE_ADC_BUFFER]);
+
+	pbus_bench_env_stop(&env);
+
+	pbus_bench_report(phases, PHASE_MAX);
+
+	ret = EXIT_SUCCESS;
+	for (i = 0; i < PHASE_MAX; i++) {
+		if (phases[i].failures)
+			ret = EXIT_FAILURE;
+	}
+
+out:
+	pbus_bench_env_stop(&env);
+	__iio_destroy(&iio);
+
+	for (i = 0; i < PHASE_MAX; i++)
+		pbus_bench_phase_free(&phases[i]);
+
+	g_free(ini);
+	g_free(__daemon);
+
+	return ret;
+}